@@ -1,5 +1,17 @@
-C:\VulkanSDK\Bin\glslc.exe first_shader.vert -o first_shader.vert.spv
-C:\VulkanSDK\Bin\glslc.exe first_shader.frag -o first_shader.frag.spv
-C:\VulkanSDK\Bin\glslc.exe point_light.vert -o point_light.vert.spv
-C:\VulkanSDK\Bin\glslc.exe point_light.frag -o point_light.frag.spv
-pause
\ No newline at end of file
+@echo off
+rem Compiles every shader to a .spv file and to generated\<name>.spv.inc, the C initializer curen_shader_library.cpp
+rem embeds. Runs as the pre-build event of Curen.vcxproj, a failing shader fails the build. glslc comes from
+rem %VULKAN_SDK%\Bin when the SDK is installed, otherwise from PATH. compile.sh does the same on Linux and macOS.
+cd /d "%~dp0"
+set GLSLC=glslc
+if defined VULKAN_SDK if exist "%VULKAN_SDK%\Bin\glslc.exe" set GLSLC=%VULKAN_SDK%\Bin\glslc.exe
+if "%GLSLC%"=="glslc" (
+    where glslc >nul 2>nul || (echo glslc not found, install the Vulkan SDK or put glslc on PATH & exit /b 1)
+)
+if not exist generated mkdir generated
+
+rem Keep in sync with compile.sh
+for %%s in (first_shader.vert first_shader_compact.vert first_shader_bindless.vert first_shader_bindless_compact.vert first_shader.frag point_light.vert point_light.frag meshlet_cull.comp) do (
+    "%GLSLC%" %%s -o %%s.spv || exit /b 1
+    "%GLSLC%" %%s -mfmt=c -o generated\%%s.spv.inc || exit /b 1
+)
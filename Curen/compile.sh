@@ -0,0 +1,21 @@
+#!/bin/sh
+# compile.bat for Linux and macOS: compiles every shader to a .spv file and to generated/<name>.spv.inc, the C
+# initializer curen_shader_library.cpp embeds. glslc comes from $VULKAN_SDK/bin when the SDK is installed, otherwise
+# from PATH. Stops at the first shader that fails.
+set -e
+cd "$(dirname "$0")"
+if [ -n "$VULKAN_SDK" ] && [ -x "$VULKAN_SDK/bin/glslc" ]; then
+	GLSLC="$VULKAN_SDK/bin/glslc"
+elif command -v glslc >/dev/null 2>&1; then
+	GLSLC=glslc
+else
+	echo "glslc not found, install the Vulkan SDK or put glslc on PATH" >&2
+	exit 1
+fi
+mkdir -p generated
+
+# Keep in sync with compile.bat
+for shader in first_shader.vert first_shader_compact.vert first_shader_bindless.vert first_shader_bindless_compact.vert first_shader.frag point_light.vert point_light.frag meshlet_cull.comp; do
+	"$GLSLC" "$shader" -o "$shader.spv"
+	"$GLSLC" "$shader" -mfmt=c -o "generated/$shader.spv.inc"
+done
@@ -0,0 +1,822 @@
+#include "curen_bench.hpp"
+#include "curen_init.hpp"
+#include "curen_upload_manager.hpp"
+#include "curen_mesh_cache.hpp"
+#include "curen_obj_parser.hpp"
+#include "curen_vertex_welder.hpp"
+#include "curen_vertex_quantizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+using namespace Curen;
+
+namespace Curen {
+	// What the GPU cases run against. The window only provides the surface the device is picked for, no frame is drawn.
+	struct BenchGpuContext {
+		CurenWindow curenWindow{ CurenInit::WIDTH, CurenInit::HEIGHT, "Curen benchmark" };
+		CurenDevice curenDevice{ curenWindow };
+		// Declared before the registry so every model is gone before the arena
+		CurenGeometryArena geometryArena{ curenDevice, CurenInit::VERTEX_ARENA_SIZE, CurenInit::INDEX_ARENA_SIZE };
+		CurenModelRegistry modelRegistry{ curenDevice, geometryArena };
+	};
+
+	struct BenchCase {
+		const char* flag;
+		// Exactly one of the two is set
+		void (*runCpu)();
+		void (*runGpu)(BenchGpuContext& context);
+	};
+
+	// A wavy grid of gridSize * gridSize quads with positions, texture coordinates and normals, for the import benchmarks
+	static void writeGridObj(const std::string& filePath, uint32_t gridSize)
+	{
+		std::ofstream file(filePath);
+		for (uint32_t z = 0; z <= gridSize; z++) {
+			for (uint32_t x = 0; x <= gridSize; x++) {
+				float u = static_cast<float>(x) / gridSize;
+				float v = static_cast<float>(z) / gridSize;
+				file << "v " << u << " " << 0.05f * std::sin(u * 40.f) * std::cos(v * 40.f) << " " << v << "\n";
+				file << "vt " << u << " " << v << "\n";
+				file << "vn 0 -1 0\n";
+			}
+		}
+		for (uint32_t z = 0; z < gridSize; z++) {
+			for (uint32_t x = 0; x < gridSize; x++) {
+				// OBJ indices start at 1
+				uint32_t corners[4] = { z * (gridSize + 1) + x + 1, (z + 1) * (gridSize + 1) + x + 1, (z + 1) * (gridSize + 1) + x + 2, z * (gridSize + 1) + x + 2 };
+				file << "f";
+				for (uint32_t corner : corners) {
+					file << " " << corner << "/" << corner << "/" << corner;
+				}
+				file << "\n";
+			}
+		}
+	}
+}
+
+static void runMemoryBenchmark(CurenDevice& curenDevice)
+{
+	// Stays below the 4096 allocations most drivers allow, so the per buffer path can run at all
+	constexpr uint32_t BUFFER_COUNT = 2048;
+	constexpr uint32_t ROUND_COUNT = 8;
+
+	std::mt19937 random{ 1 };
+	std::uniform_int_distribution<uint32_t> sizeDistribution{ 1, 1024 };
+	std::vector<VkDeviceSize> bufferSizes(BUFFER_COUNT);
+	for (auto& bufferSize : bufferSizes) {
+		bufferSize = static_cast<VkDeviceSize>(sizeDistribution(random)) * 256;
+	}
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t round = 0; round < ROUND_COUNT; round++) {
+		std::vector<std::unique_ptr<CurenBuffer>> buffers{};
+		buffers.reserve(BUFFER_COUNT);
+		for (VkDeviceSize bufferSize : bufferSizes) {
+			buffers.push_back(std::make_unique<CurenBuffer>(curenDevice, bufferSize, 1, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		}
+		if (round == 0) {
+			auto heapStatistics = curenDevice.memoryAllocator().getHeapStatistics();
+			for (size_t i = 0; i < heapStatistics.size(); i++) {
+				std::cout << "heap " << i << ": " << heapStatistics[i].usedSize / 1024 << "/" << heapStatistics[i].reservedSize / 1024 << " KB used in "
+					<< heapStatistics[i].blockCount << " blocks, " << heapStatistics[i].allocationCount << " allocations ("
+					<< heapStatistics[i].dedicatedAllocationCount << " dedicated), fragmentation " << heapStatistics[i].fragmentation << std::endl;
+			}
+		}
+	}
+	float subAllocatedTime = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	startTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t round = 0; round < ROUND_COUNT; round++) {
+		std::vector<std::pair<VkBuffer, VkDeviceMemory>> buffers{};
+		buffers.reserve(BUFFER_COUNT);
+		for (VkDeviceSize bufferSize : bufferSizes) {
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = bufferSize;
+			bufferInfo.usage = usage;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VkBuffer buffer;
+			if (vkCreateBuffer(curenDevice.device(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create benchmark buffer!");
+			}
+
+			VkMemoryRequirements memRequirements;
+			vkGetBufferMemoryRequirements(curenDevice.device(), buffer, &memRequirements);
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = memRequirements.size;
+			allocInfo.memoryTypeIndex = curenDevice.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VkDeviceMemory memory;
+			if (vkAllocateMemory(curenDevice.device(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+				vkDestroyBuffer(curenDevice.device(), buffer, nullptr);
+				throw std::runtime_error("failed to allocate benchmark buffer memory!");
+			}
+			vkBindBufferMemory(curenDevice.device(), buffer, memory, 0);
+			buffers.push_back({ buffer, memory });
+		}
+		for (auto& buffer : buffers) {
+			vkDestroyBuffer(curenDevice.device(), buffer.first, nullptr);
+			vkFreeMemory(curenDevice.device(), buffer.second, nullptr);
+		}
+	}
+	float perBufferTime = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	float bufferCount = static_cast<float>(BUFFER_COUNT * ROUND_COUNT);
+	std::cout << "sub-allocated: " << bufferCount / subAllocatedTime << " buffers/s, one allocation per buffer: "
+		<< bufferCount / perBufferTime << " buffers/s" << std::endl;
+}
+
+static void runUploadBenchmark(CurenDevice& curenDevice, CurenGeometryArena& geometryArena)
+{
+	constexpr uint32_t MODEL_COUNT = 1000;
+	constexpr uint32_t GRID_SIZE = 32;
+
+	// A flat grid stands in for a small prop, large enough that the copies are not free
+	CurenModel::Builder builder{};
+	for (uint32_t z = 0; z <= GRID_SIZE; z++) {
+		for (uint32_t x = 0; x <= GRID_SIZE; x++) {
+			CurenModel::Vertex vertex{};
+			vertex.position = { static_cast<float>(x), 0.f, static_cast<float>(z) };
+			vertex.normal = { 0.f, -1.f, 0.f };
+			builder.vertices.push_back(vertex);
+		}
+	}
+	for (uint32_t z = 0; z < GRID_SIZE; z++) {
+		for (uint32_t x = 0; x < GRID_SIZE; x++) {
+			uint32_t corner = z * (GRID_SIZE + 1) + x;
+			builder.indices.insert(builder.indices.end(), { corner, corner + GRID_SIZE + 1, corner + 1, corner + 1, corner + GRID_SIZE + 1, corner + GRID_SIZE + 2 });
+		}
+	}
+	VkDeviceSize vertexSize = sizeof(CurenModel::Vertex) * builder.vertices.size();
+	VkDeviceSize indexSize = sizeof(uint32_t) * builder.indices.size();
+
+	// What model creation used to do: a fresh staging buffer and a copyBuffer, which waits for the queue, per buffer
+	auto startTime = std::chrono::high_resolution_clock::now();
+	{
+		std::vector<std::unique_ptr<CurenBuffer>> buffers{};
+		for (uint32_t i = 0; i < MODEL_COUNT; i++) {
+			for (auto upload : { std::make_pair(static_cast<void*>(builder.vertices.data()), vertexSize), std::make_pair(static_cast<void*>(builder.indices.data()), indexSize) }) {
+				CurenBuffer stagingBuffer{ curenDevice, upload.second, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+				stagingBuffer.map();
+				stagingBuffer.writeToBuffer(upload.first);
+				buffers.push_back(std::make_unique<CurenBuffer>(curenDevice, upload.second, 1,
+					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+				curenDevice.copyBuffer(stagingBuffer.getBuffer(), buffers.back()->getBuffer(), upload.second);
+			}
+		}
+	}
+	float perCopyTime = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	CurenUploadManager& uploadManager = curenDevice.uploadManager();
+	auto statisticsBefore = uploadManager.getStatistics();
+	startTime = std::chrono::high_resolution_clock::now();
+	{
+		std::vector<std::unique_ptr<CurenModel>> models{};
+		CurenUploadBatch uploadBatch{ curenDevice };
+		for (uint32_t i = 0; i < MODEL_COUNT; i++) {
+			models.push_back(std::make_unique<CurenModel>(curenDevice, geometryArena, builder, CurenModel::VertexLayout::Full, &uploadBatch));
+		}
+		uploadBatch.submit();
+		uploadBatch.wait();
+	}
+	float batchedTime = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	auto statisticsAfter = uploadManager.getStatistics();
+
+	std::cout << MODEL_COUNT << " models, " << (vertexSize + indexSize) * MODEL_COUNT / (1024 * 1024) << " MB: staging buffer per copy "
+		<< perCopyTime * 1000.f << " ms in " << MODEL_COUNT * 2 << " submits, upload manager " << batchedTime * 1000.f << " ms in "
+		<< statisticsAfter.submitCount - statisticsBefore.submitCount << " submits (" << statisticsAfter.stallCount - statisticsBefore.stallCount
+		<< " ring stalls)" << std::endl;
+}
+
+static void runBufferBenchmark(CurenDevice& curenDevice)
+{
+	// A per object uniform buffer of which a few objects and the global block change every frame
+	constexpr uint32_t FRAME_COUNT = 10000;
+	constexpr uint32_t SLOT_COUNT = 256;
+	constexpr uint32_t SLOT_SIZE = 256;
+	constexpr uint32_t CHANGED_SLOT_COUNT = 8;
+
+	CurenBuffer uniformBuffer{ curenDevice, SLOT_SIZE, SLOT_COUNT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		curenDevice.properties.limits.minUniformBufferOffsetAlignment };
+	uniformBuffer.map();
+	VkMemoryPropertyFlags memoryFlags = uniformBuffer.getAllocatedMemoryPropertyFlags();
+	std::cout << "uniform buffer memory: " << ((memoryFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? "device local, " : "")
+		<< ((memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) ? "coherent" : "non coherent")
+		<< ((memoryFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) ? ", cached" : ", uncached") << std::endl;
+
+	std::vector<char> shadow(uniformBuffer.getBufferSize(), 1);
+	std::mt19937 random{ 1 };
+	std::uniform_int_distribution<uint32_t> slotDistribution{ 1, SLOT_COUNT - 1 };
+	std::vector<uint32_t> changedSlots(FRAME_COUNT * CHANGED_SLOT_COUNT);
+	for (auto& slot : changedSlots) {
+		slot = slotDistribution(random);
+	}
+
+	auto timeFrames = [&](auto&& updateFrame) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+			updateFrame(&changedSlots[frame * CHANGED_SLOT_COUNT]);
+		}
+		return std::chrono::duration<float, std::chrono::microseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count() / FRAME_COUNT;
+	};
+
+	float wholeTime = timeFrames([&](const uint32_t*) {
+		uniformBuffer.writeToBuffer(shadow.data());
+		uniformBuffer.flush();
+	});
+	float dirtyTime = timeFrames([&](const uint32_t* slots) {
+		uniformBuffer.writeToIndex(shadow.data(), 0);
+		for (uint32_t i = 0; i < CHANGED_SLOT_COUNT; i++) {
+			uniformBuffer.writeToIndex(shadow.data() + slots[i] * SLOT_SIZE, slots[i]);
+		}
+		uniformBuffer.flushDirtyRanges();
+	});
+	float streamTime = timeFrames([&](const uint32_t* slots) {
+		VkDeviceSize alignmentSize = uniformBuffer.getBufferSize() / SLOT_COUNT;
+		uniformBuffer.streamToBuffer(shadow.data(), SLOT_SIZE, 0);
+		for (uint32_t i = 0; i < CHANGED_SLOT_COUNT; i++) {
+			uniformBuffer.streamToBuffer(shadow.data() + slots[i] * SLOT_SIZE, SLOT_SIZE, slots[i] * alignmentSize);
+		}
+		uniformBuffer.flushDirtyRanges();
+	});
+
+	std::cout << "per frame update of " << CHANGED_SLOT_COUNT + 1 << " of " << SLOT_COUNT << " slots: whole buffer " << wholeTime
+		<< " us, dirty ranges " << dirtyTime << " us, streaming " << streamTime << " us" << std::endl;
+}
+
+static void runDescriptorBenchmark(CurenDevice& curenDevice)
+{
+	// Every draw points a storage buffer binding at its own slot. Only the CPU side is timed, nothing is submitted.
+	constexpr uint32_t DRAW_COUNT = 10000;
+	constexpr uint32_t RUN_COUNT = 10;
+	constexpr VkDeviceSize SLOT_SIZE = 256;
+
+	CurenBuffer storageBuffer{ curenDevice, SLOT_SIZE, DRAW_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		curenDevice.properties.limits.minStorageBufferOffsetAlignment };
+
+	auto& pooledSetLayout = CurenDescriptorSetLayout::Builder(curenDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		.buildCached();
+	auto& pushSetLayout = CurenDescriptorSetLayout::Builder(curenDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		.setPushDescriptor()
+		.buildCached();
+	if (!pushSetLayout.isPushDescriptor()) {
+		std::cout << "push descriptors are not supported, both runs allocate sets" << std::endl;
+	}
+
+	auto createPipelineLayout = [&](const CurenDescriptorSetLayout& setLayout) {
+		VkDescriptorSetLayout descriptorSetLayout = setLayout.getDescriptorSetLayout();
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		if (vkCreatePipelineLayout(curenDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+		return pipelineLayout;
+	};
+	VkPipelineLayout pooledPipelineLayout = createPipelineLayout(pooledSetLayout);
+	VkPipelineLayout pushPipelineLayout = createPipelineLayout(pushSetLayout);
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = curenDevice.getCommandPool();
+	allocInfo.commandBufferCount = 1;
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(curenDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate command buffer!");
+	}
+
+	// Sets come from a per frame style allocator, reset before every run like CurenRenderer does
+	CurenDescriptorAllocator descriptorAllocator{ curenDevice };
+	auto timeDraws = [&](CurenDescriptorSetLayout& setLayout, VkPipelineLayout pipelineLayout) {
+		float totalTime = 0.f;
+		// The first run only grows the allocator's pools
+		for (uint32_t run = 0; run <= RUN_COUNT; run++) {
+			descriptorAllocator.resetPools();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+			auto startTime = std::chrono::high_resolution_clock::now();
+			for (uint32_t draw = 0; draw < DRAW_COUNT; draw++) {
+				auto bufferInfo = storageBuffer.descriptorInfoForIndex(draw);
+				CurenDescriptorWriter(setLayout, descriptorAllocator)
+					.writeBuffer(0, &bufferInfo)
+					.push(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0);
+			}
+			float runTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+			if (run > 0) {
+				totalTime += runTime;
+			}
+
+			vkEndCommandBuffer(commandBuffer);
+			vkResetCommandBuffer(commandBuffer, 0);
+		}
+		return totalTime / RUN_COUNT;
+	};
+	float pooledTime = timeDraws(pooledSetLayout, pooledPipelineLayout);
+	float pushTime = timeDraws(pushSetLayout, pushPipelineLayout);
+
+	std::cout << "descriptors for " << DRAW_COUNT << " draws: allocate, update and bind " << pooledTime
+		<< " ms, push descriptors " << pushTime << " ms" << std::endl;
+
+	vkFreeCommandBuffers(curenDevice.device(), curenDevice.getCommandPool(), 1, &commandBuffer);
+	vkDestroyPipelineLayout(curenDevice.device(), pushPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(curenDevice.device(), pooledPipelineLayout, nullptr);
+}
+
+static void runMeshCacheBenchmark()
+{
+	constexpr uint32_t WARM_RUN_COUNT = 10;
+	constexpr uint32_t GRID_SIZE = 512;
+
+	// Copies in a scratch directory, so the caches the loader uses next to the models are left alone
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "curen_mesh_cache_benchmark";
+	std::filesystem::create_directories(directory);
+	std::vector<std::string> sourcePaths{};
+	for (const char* modelPath : { "../Models/flat_vase.obj", "../Models/smooth_vase.obj" }) {
+		std::filesystem::path sourcePath = directory / std::filesystem::path(modelPath).filename();
+		std::filesystem::copy_file(modelPath, sourcePath, std::filesystem::copy_options::overwrite_existing);
+		sourcePaths.push_back(sourcePath.string());
+	}
+
+	// A grid of half a million triangles, large enough that parsing and optimizing dominate the cold import
+	std::string gridPath = (directory / "grid.obj").string();
+	writeGridObj(gridPath, GRID_SIZE);
+	sourcePaths.push_back(gridPath);
+
+	CurenModel::ImportSettings importSettings{};
+	auto timeImport = [&importSettings](const std::string& sourcePath) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		CurenModel::Builder builder{};
+		builder.import(sourcePath, importSettings);
+		return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	};
+
+	for (const std::string& sourcePath : sourcePaths) {
+		std::filesystem::remove(CurenMeshCache::cachePathFor(sourcePath));
+		float coldTime = timeImport(sourcePath);
+		float warmTime = 0.f;
+		for (uint32_t run = 0; run < WARM_RUN_COUNT; run++) {
+			warmTime += timeImport(sourcePath);
+		}
+		warmTime /= WARM_RUN_COUNT;
+
+		// The first import after a touch hashes the source and stores its new write time, the next one is warm again
+		std::filesystem::last_write_time(sourcePath, std::filesystem::file_time_type::clock::now());
+		float touchedTime = timeImport(sourcePath);
+		float retouchedTime = timeImport(sourcePath);
+
+		std::cout << "mesh cache " << std::filesystem::path(sourcePath).filename().string() << " (" << std::filesystem::file_size(sourcePath) / 1024
+			<< " KB): cold " << coldTime << " ms, warm " << warmTime << " ms, touched " << touchedTime << " ms, after the touch " << retouchedTime
+			<< " ms" << std::endl;
+	}
+	std::filesystem::remove_all(directory);
+}
+
+static void runObjParserBenchmark()
+{
+	constexpr uint32_t RUN_COUNT = 5;
+	constexpr uint32_t GRID_SIZE = 1024;
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "curen_obj_parser_benchmark";
+	std::filesystem::create_directories(directory);
+	std::string gridPath = (directory / "grid.obj").string();
+	writeGridObj(gridPath, GRID_SIZE);
+
+	for (const std::string& sourcePath : { std::string{ "../Models/flat_vase.obj" }, std::string{ "../Models/smooth_vase.obj" }, gridPath }) {
+		float fileSize = std::filesystem::file_size(sourcePath) / (1024.f * 1024.f);
+		auto timeParse = [&](auto&& load, CurenModel::Builder& builder) {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			for (uint32_t run = 0; run < RUN_COUNT; run++) {
+				builder = CurenModel::Builder{};
+				load(builder);
+			}
+			float parseTime = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+			return fileSize * RUN_COUNT / std::max(parseTime, 1e-6f);
+		};
+
+		CurenModel::Builder parsed{};
+		CurenModel::Builder reference{};
+		float parserSpeed = timeParse([&sourcePath](CurenModel::Builder& builder) { builder.loadModel(sourcePath); }, parsed);
+		float tinyObjSpeed = timeParse([&sourcePath](CurenModel::Builder& builder) { builder.loadModelTinyObj(sourcePath); }, reference);
+		bool isIdentical = parsed.vertices == reference.vertices && parsed.indices == reference.indices;
+
+		std::cout << "OBJ " << std::filesystem::path(sourcePath).filename().string() << " (" << fileSize << " MB): CurenObjParser "
+			<< parserSpeed << " MB/s, tinyobjloader " << tinyObjSpeed << " MB/s, output " << (isIdentical ? "identical" : "DIFFERS") << std::endl;
+	}
+	std::filesystem::remove_all(directory);
+}
+
+static void runObjParserTest()
+{
+	// Enough blocks for the file to be split into several chunks
+	constexpr uint32_t BLOCK_COUNT = 20000;
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "curen_obj_parser_test";
+	std::filesystem::create_directories(directory);
+
+	// Every block refers to its own records through negative indices and to the first block through absolute ones,
+	// so indices are resolved across chunk borders
+	std::string meshPath = (directory / "mesh.obj").string();
+	{
+		std::ofstream file(meshPath);
+		for (uint32_t block = 0; block < BLOCK_COUNT; block++) {
+			uint32_t offset = block % 100;
+			file << "v " << offset << " 0 0\n";
+			file << "v " << offset << " 0 -0\n";
+			// 0 * inf in tinyobjloader's number parser, a NaN
+			file << "v 0e999 " << offset << " 0\n";
+			file << "v " << offset + 1 << " 0 0\n";
+			file << "v " << offset + 1 << " 1 0\n";
+			file << "v " << offset << " 3 0\n";
+			file << "vt 0.5 -0\n";
+			file << "vn 0 0 1\n";
+			file << "vn -0 0 1\n";
+			file << "f -6/-1/-2 -3/-1/-2 -2/-1/-2\n";
+			// -0 in the position and the normal, welds with the first corner above
+			file << "f -5/-1/-1 -3/-1/-1 -2/-1/-1\n";
+			// The NaN corner never welds, not even with the same NaN
+			file << "f -4 -3 -2\n";
+			file << "f -4 -3 -2\n";
+			// One quad and the same quad rotated by a corner, split along either diagonal
+			file << "f -6 -3 -2 -1\n";
+			file << "f -1 -6 -3 -2\n";
+			file << "f 1/1/1 4/1/2 5/1/1\n";
+		}
+	}
+
+	// tinyobjloader ear clips polygons, the parser has to leave them to it
+	std::string polygonPath = (directory / "polygon.obj").string();
+	{
+		std::ofstream file(polygonPath);
+		file << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0.5 0.5 0\nv 0 1 0\n";
+		file << "f 1 2 3\nf 1 2 3 4 5\n";
+	}
+
+	// Bitwise, NaN included
+	auto isIdentical = [](const CurenModel::Builder& a, const CurenModel::Builder& b) {
+		return a.indices == b.indices && a.vertices.size() == b.vertices.size() &&
+			std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(CurenModel::Vertex)) == 0;
+	};
+
+	CurenModel::Builder parsed{};
+	std::size_t parsedSize = CurenObjParser::parse(meshPath, parsed.vertices, parsed.indices);
+	CurenModel::Builder reference{};
+	reference.loadModelTinyObj(meshPath);
+	uint32_t nanCount = static_cast<uint32_t>(std::count_if(parsed.vertices.begin(), parsed.vertices.end(),
+		[](const CurenModel::Vertex& vertex) { return std::isnan(vertex.position.x); }));
+	bool isMeshPassed = parsedSize > 0 && isIdentical(parsed, reference) && nanCount == 2 * BLOCK_COUNT &&
+		parsed.indices.size() > 3 && parsed.indices[3] == parsed.indices[0];
+	std::cout << "mesh.obj: " << parsed.vertices.size() << " vertices, " << parsed.indices.size() / 3 << " triangles, " << nanCount
+		<< " NaN vertices, output " << (isIdentical(parsed, reference) ? "identical" : "DIFFERS") << (isMeshPassed ? " ok" : " FAILED") << std::endl;
+
+	CurenModel::Builder polygonParsed{};
+	std::size_t polygonSize = CurenObjParser::parse(polygonPath, polygonParsed.vertices, polygonParsed.indices);
+	polygonParsed.loadModel(polygonPath);
+	CurenModel::Builder polygonReference{};
+	polygonReference.loadModelTinyObj(polygonPath);
+	bool isPolygonPassed = polygonSize == 0 && isIdentical(polygonParsed, polygonReference);
+	std::cout << "polygon.obj: left to tinyobjloader " << (polygonSize == 0 ? "yes" : "NO") << ", output "
+		<< (isIdentical(polygonParsed, polygonReference) ? "identical" : "DIFFERS") << (isPolygonPassed ? " ok" : " FAILED") << std::endl;
+
+	std::filesystem::remove_all(directory);
+	if (!isMeshPassed || !isPolygonPassed) {
+		throw std::runtime_error("CurenObjParser output differs from tinyobjloader");
+	}
+}
+
+static void runWeldBenchmark()
+{
+	// About six corners per unique vertex, like a closed triangle mesh, visited in random order
+	constexpr uint32_t CORNERS_PER_VERTEX = 6;
+
+	for (uint32_t cornerCount : { 1000000u, 10000000u }) {
+		uint32_t vertexCount = cornerCount / CORNERS_PER_VERTEX;
+		std::mt19937 random{ 1 };
+		std::uniform_int_distribution<uint32_t> vertexDistribution{ 0, vertexCount - 1 };
+		std::vector<uint32_t> cornerVertices(cornerCount);
+		for (auto& cornerVertex : cornerVertices) {
+			cornerVertex = vertexDistribution(random);
+		}
+		// Built on the fly, the same for both runs, so only the weld differs
+		auto makeVertex = [](uint32_t vertexIndex) {
+			CurenModel::Vertex vertex{};
+			vertex.position = { static_cast<float>(vertexIndex % 1024), static_cast<float>(vertexIndex / 1024), 0.f };
+			vertex.normal = { 0.f, 0.f, vertexIndex % 2 == 0 ? 1.f : -0.f };
+			vertex.uv = { vertexIndex * (1.f / 1024), 0.5f };
+			return vertex;
+		};
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::unordered_map<CurenModel::Vertex, uint32_t> uniqueVertices{};
+		uint64_t mapIdSum = 0;
+		for (uint32_t cornerVertex : cornerVertices) {
+			auto inserted = uniqueVertices.try_emplace(makeVertex(cornerVertex), static_cast<uint32_t>(uniqueVertices.size()));
+			mapIdSum += inserted.first->second;
+		}
+		float mapTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		startTime = std::chrono::high_resolution_clock::now();
+		CurenVertexWelder<CurenModel::Vertex> welder{ vertexCount };
+		uint64_t welderIdSum = 0;
+		for (uint32_t cornerVertex : cornerVertices) {
+			welderIdSum += welder.weld(makeVertex(cornerVertex));
+		}
+		float welderTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		// Both hand out ids in order of first appearance, so the same corners get the same ids
+		bool isIdentical = uniqueVertices.size() == welder.size() && mapIdSum == welderIdSum;
+		std::cout << "weld " << cornerCount / 1000000 << "M corners into " << welder.size() << " vertices: unordered_map " << mapTime
+			<< " ms, CurenVertexWelder " << welderTime << " ms, ids " << (isIdentical ? "identical" : "DIFFER") << std::endl;
+	}
+}
+
+static void runQuantizationTest()
+{
+	// Octahedral R16G16_SNORM keeps unit normals within about 0.005 degrees
+	constexpr float NORMAL_BOUND_DEGREES = 0.01f;
+
+	std::vector<std::pair<std::string, std::vector<CurenModel::Vertex>>> meshes{};
+	for (const char* modelPath : { "../Models/flat_vase.obj", "../Models/smooth_vase.obj" }) {
+		CurenModel::Builder builder{};
+		builder.import(modelPath, CurenModel::ImportSettings{});
+		meshes.emplace_back(modelPath, std::move(builder.vertices));
+	}
+
+	// Random vertices off the origin, with tiling texture coordinates, plus the normals on the octahedron's edges and corners
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> positionDistribution{ -50.f, 150.f };
+	std::uniform_real_distribution<float> uvDistribution{ -4.f, 4.f };
+	std::uniform_real_distribution<float> unitDistribution{ 0.f, 1.f };
+	std::normal_distribution<float> normalDistribution{};
+	std::vector<CurenModel::Vertex> randomVertices(100000);
+	for (auto& vertex : randomVertices) {
+		vertex.position = { positionDistribution(random), positionDistribution(random) * 0.1f, positionDistribution(random) };
+		vertex.normal = glm::normalize(glm::vec3{ normalDistribution(random), normalDistribution(random), normalDistribution(random) });
+		vertex.uv = { uvDistribution(random), uvDistribution(random) };
+		vertex.color = { unitDistribution(random), unitDistribution(random), unitDistribution(random) };
+	}
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			for (int z = -1; z <= 1; z++) {
+				if (x != 0 || y != 0 || z != 0) {
+					randomVertices[(x + 1) * 9 + (y + 1) * 3 + z + 1].normal = glm::normalize(glm::vec3(x, y, z));
+				}
+			}
+		}
+	}
+	meshes.emplace_back("random", std::move(randomVertices));
+
+	bool isPassed = true;
+	for (const auto& [name, vertices] : meshes) {
+		glm::vec3 boundsMin = vertices[0].position;
+		glm::vec3 boundsMax = vertices[0].position;
+		float uvMax = 0.f;
+		for (const auto& vertex : vertices) {
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+			uvMax = std::max({ uvMax, std::abs(vertex.uv.x), std::abs(vertex.uv.y) });
+		}
+
+		// Half a UNORM16 step on every axis, plus the float rounding of the dequantization
+		float positionBound = 0.5f * glm::length(boundsMax - boundsMin) / 65535.f
+			+ 4.f * FLT_EPSILON * glm::length(glm::max(glm::abs(boundsMin), glm::abs(boundsMax)));
+		// Half a half float ulp: 11 significant bits
+		float uvBound = std::max(uvMax * std::ldexp(1.f, -11), std::ldexp(1.f, -25));
+		float colorBound = 0.5f / 255.f + FLT_EPSILON;
+
+		std::vector<CurenModel::CompactVertex> compactVertices{};
+		glm::mat4 dequantization = CurenVertexQuantizer::quantize(vertices.data(), static_cast<uint32_t>(vertices.size()), compactVertices);
+		auto error = CurenVertexQuantizer::measureError(vertices.data(), compactVertices, dequantization);
+
+		bool isWithinBounds = error.position <= positionBound && error.normalDegrees <= NORMAL_BOUND_DEGREES && error.uv <= uvBound && error.color <= colorBound;
+		isPassed = isPassed && isWithinBounds;
+		std::cout << name << ": position " << error.position << " / " << positionBound << ", normal " << error.normalDegrees << " / " << NORMAL_BOUND_DEGREES
+			<< " deg, uv " << error.uv << " / " << uvBound << ", color " << error.color << " / " << colorBound << (isWithinBounds ? " ok" : " FAILED") << std::endl;
+	}
+
+	if (!isPassed) {
+		throw std::runtime_error("compact vertex error is out of bounds");
+	}
+}
+
+static void runRegistryTest(CurenGeometryArena& geometryArena, CurenModelRegistry& modelRegistry)
+{
+	constexpr uint32_t COPY_COUNT = 100;
+
+	// A file nothing else has loaded, so the first request is the only load
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "curen_registry_test";
+	std::filesystem::create_directories(directory);
+	std::string gridPath = (directory / "grid.obj").string();
+	writeGridObj(gridPath, 64);
+
+	auto registryBefore = modelRegistry.getStatistics();
+	auto vertexBefore = geometryArena.getVertexStatistics();
+	auto indexBefore = geometryArena.getIndexStatistics();
+
+	std::vector<std::shared_ptr<CurenModel>> copies{};
+	for (uint32_t i = 0; i < COPY_COUNT; i++) {
+		copies.push_back(modelRegistry.loadModel(gridPath));
+	}
+
+	auto registryLoaded = modelRegistry.getStatistics();
+	auto vertexLoaded = geometryArena.getVertexStatistics();
+	auto indexLoaded = geometryArena.getIndexStatistics();
+	bool isShared = std::all_of(copies.begin(), copies.end(), [&copies](const auto& copy) { return copy == copies.front(); });
+	uint64_t loadCount = registryLoaded.loadCount - registryBefore.loadCount;
+	uint64_t requestCount = registryLoaded.requestCount - registryBefore.requestCount;
+	uint32_t vertexAllocationCount = vertexLoaded.allocationCount - vertexBefore.allocationCount;
+	uint32_t indexAllocationCount = indexLoaded.allocationCount - indexBefore.allocationCount;
+	std::cout << COPY_COUNT << " copies: " << requestCount << " requests, " << loadCount << " loads, " << vertexAllocationCount << " vertex and "
+		<< indexAllocationCount << " index allocations, " << (vertexLoaded.usedSize - vertexBefore.usedSize) + (indexLoaded.usedSize - indexBefore.usedSize)
+		<< " bytes resident, " << registryLoaded.savedSize - registryBefore.savedSize << " bytes saved" << std::endl;
+
+	// The last handle retires the model, it is destroyed once MAX_FRAMES_IN_FLIGHT frames have passed
+	copies.clear();
+	for (int frame = 0; frame < CurenSwapChain::MAX_FRAMES_IN_FLIGHT; frame++) {
+		modelRegistry.collectGarbage();
+	}
+	bool isReleased = geometryArena.getVertexStatistics().allocationCount == vertexBefore.allocationCount
+		&& geometryArena.getIndexStatistics().allocationCount == indexBefore.allocationCount;
+	std::cout << "after the last handle: " << (isReleased ? "released" : "still allocated") << std::endl;
+
+	if (!isShared || loadCount != 1 || requestCount != COPY_COUNT || vertexAllocationCount != 1 || indexAllocationCount != 1 || !isReleased) {
+		throw std::runtime_error("model registry did not share one allocation between the copies");
+	}
+}
+
+static void runUploadTest(CurenDevice& curenDevice)
+{
+	constexpr VkDeviceSize BUFFER_SIZE = 48 * 1024 * 1024;
+	constexpr VkDeviceSize SLOT_SIZE = 64 * 1024;
+	constexpr uint32_t ROUND_COUNT = 8;
+	constexpr uint32_t COPIES_PER_ROUND = 500;
+
+	CurenBuffer deviceBuffer{ curenDevice, BUFFER_SIZE, 1, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
+	std::vector<uint8_t> expected(BUFFER_SIZE);
+	std::mt19937 random{ 1 };
+	auto fill = [&random](uint8_t* data, VkDeviceSize size) {
+		for (VkDeviceSize i = 0; i < size; i++) {
+			data[i] = static_cast<uint8_t>(random());
+		}
+	};
+
+	CurenUploadManager& uploadManager = curenDevice.uploadManager();
+	auto statisticsBefore = uploadManager.getStatistics();
+
+	// Larger than the staging ring, so it is split across submissions
+	fill(expected.data(), BUFFER_SIZE - SLOT_SIZE);
+	uploadManager.copyToBuffer(deviceBuffer.getBuffer(), 0, expected.data(), BUFFER_SIZE - SLOT_SIZE);
+	uploadManager.wait(uploadManager.submit());
+
+	// Copies within one submission do not overlap, they are not ordered against each other. Whole slots next to
+	// each other are merged into one ownership transfer.
+	std::uniform_int_distribution<uint32_t> slotDistribution{ 0, static_cast<uint32_t>(BUFFER_SIZE / SLOT_SIZE) - 1 };
+	std::uniform_int_distribution<VkDeviceSize> sizeDistribution{ 1, SLOT_SIZE };
+	for (uint32_t round = 0; round < ROUND_COUNT; round++) {
+		std::vector<bool> isSlotUsed(BUFFER_SIZE / SLOT_SIZE);
+		for (uint32_t copy = 0; copy < COPIES_PER_ROUND; copy++) {
+			uint32_t slot = slotDistribution(random);
+			if (isSlotUsed[slot]) {
+				continue;
+			}
+			isSlotUsed[slot] = true;
+			VkDeviceSize size = copy % 2 == 0 ? SLOT_SIZE : sizeDistribution(random);
+			VkDeviceSize offset = slot * SLOT_SIZE + random() % (SLOT_SIZE - size + 1);
+			fill(expected.data() + offset, size);
+			uploadManager.copyToBuffer(deviceBuffer.getBuffer(), offset, expected.data() + offset, size);
+		}
+		uploadManager.wait(uploadManager.submit());
+	}
+	auto statisticsAfter = uploadManager.getStatistics();
+
+	// Read back on the graphics queue, which only sees the data once the ownership transfer has completed
+	CurenBuffer readbackBuffer{ curenDevice, BUFFER_SIZE, 1, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+	curenDevice.copyBuffer(deviceBuffer.getBuffer(), readbackBuffer.getBuffer(), BUFFER_SIZE);
+	readbackBuffer.map();
+	readbackBuffer.invalidate();
+	const uint8_t* readback = static_cast<const uint8_t*>(readbackBuffer.getMappedMemory());
+	auto mismatch = std::mismatch(expected.begin(), expected.end(), readback);
+
+	std::cout << (curenDevice.findPhysicalQueueFamilies().hasDedicatedTransferFamily() ? "dedicated transfer family" : "graphics family") << ": "
+		<< statisticsAfter.copyCount - statisticsBefore.copyCount << " copies in " << statisticsAfter.submitCount - statisticsBefore.submitCount
+		<< " submits, " << statisticsAfter.ownershipTransferCount - statisticsBefore.ownershipTransferCount << " ownership transfers, "
+		<< statisticsAfter.stallCount - statisticsBefore.stallCount << " ring stalls" << std::endl;
+	if (mismatch.first != expected.end()) {
+		throw std::runtime_error("uploaded data differs from the source at byte " + std::to_string(mismatch.first - expected.begin()));
+	}
+	std::cout << "readback matches all " << BUFFER_SIZE / (1024 * 1024) << " MB" << std::endl;
+}
+static const BenchCase BENCH_CASES[]{
+	// Times buffer creation through the device memory sub-allocator against one vkAllocateMemory per buffer
+	{ "--memory-benchmark", nullptr, [](BenchGpuContext& context) { runMemoryBenchmark(context.curenDevice); } },
+	// Uploads a thousand small meshes with a staging buffer and queue idle per copy, then through the upload manager
+	{ "--upload-benchmark", nullptr, [](BenchGpuContext& context) { runUploadBenchmark(context.curenDevice, context.geometryArena); } },
+	// Times per frame uniform updates: whole buffer writes, dirty range writes and streaming writes
+	{ "--buffer-benchmark", nullptr, [](BenchGpuContext& context) { runBufferBenchmark(context.curenDevice); } },
+	// Records per draw descriptor updates, allocated and bound sets against push descriptors
+	{ "--descriptor-benchmark", nullptr, [](BenchGpuContext& context) { runDescriptorBenchmark(context.curenDevice); } },
+	// Imports flat_vase, smooth_vase and a large generated grid cold, warm from the mesh cache and after touching the source
+	{ "--mesh-cache-benchmark", runMeshCacheBenchmark, nullptr },
+	// Parses flat_vase, smooth_vase and a large generated grid with CurenObjParser and tinyobjloader, in MB/s, and
+	// checks that both produce the same vertices and indices
+	{ "--obj-parser-benchmark", runObjParserBenchmark, nullptr },
+	// Compares CurenObjParser with tinyobjloader, bitwise, on a generated mesh of triangles, quads split along either
+	// diagonal, negative indices, -0 and NaN spread over several chunks, and on a polygon the parser has to decline
+	{ "--obj-parser-test", runObjParserTest, nullptr },
+	// Welds 1M and 10M corners through std::unordered_map, as the import used to, and through CurenVertexWelder
+	{ "--weld-benchmark", runWeldBenchmark, nullptr },
+	// Round-trips the vases and random vertices through CompactVertex and throws if the position, normal, uv or color
+	// error exceeds what the packed formats allow
+	{ "--quantization-test", runQuantizationTest, nullptr },
+	// Loads a hundred copies of one model through the registry and throws unless they share one import and one
+	// vertex and index allocation, which is given back after the last copy is released
+	{ "--registry-test", nullptr, [](BenchGpuContext& context) { runRegistryTest(context.geometryArena, context.modelRegistry); } },
+	// Uploads random data through the upload manager, including a copy larger than its staging ring, reads it
+	// back on the graphics queue and throws if any byte differs
+	{ "--upload-test", nullptr, [](BenchGpuContext& context) { runUploadTest(context.curenDevice); } },
+};
+
+// --tests runs every case whose flag ends in -test, --cpu-tests the ones among them that need no device
+static const char* const ALL_TESTS_FLAG = "--tests";
+static const char* const CPU_TESTS_FLAG = "--cpu-tests";
+
+static bool isTestCase(const BenchCase& benchCase)
+{
+	std::size_t length = std::strlen(benchCase.flag);
+	return length > 5 && std::strcmp(benchCase.flag + length - 5, "-test") == 0;
+}
+
+// The cases one argument selects, in table order for the test groups
+static std::vector<const BenchCase*> findBenchCases(const char* flag)
+{
+	std::vector<const BenchCase*> benchCases{};
+	bool isAllTests = std::strcmp(flag, ALL_TESTS_FLAG) == 0;
+	bool isCpuTests = std::strcmp(flag, CPU_TESTS_FLAG) == 0;
+	for (const BenchCase& benchCase : BENCH_CASES) {
+		if (std::strcmp(flag, benchCase.flag) == 0 || ((isAllTests || (isCpuTests && benchCase.runCpu != nullptr)) && isTestCase(benchCase))) {
+			benchCases.push_back(&benchCase);
+		}
+	}
+	return benchCases;
+}
+
+bool CurenBench::isRequested(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++) {
+		if (!findBenchCases(argv[i]).empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int CurenBench::run(int argc, char** argv)
+{
+	try
+	{
+		std::unique_ptr<BenchGpuContext> gpuContext{};
+		for (int i = 1; i < argc; i++) {
+			for (const BenchCase* benchCase : findBenchCases(argv[i])) {
+				std::cout << benchCase->flag + 2 << std::endl;
+				if (benchCase->runCpu != nullptr) {
+					benchCase->runCpu();
+					continue;
+				}
+				if (!gpuContext) {
+					gpuContext = std::make_unique<BenchGpuContext>();
+				}
+				benchCase->runGpu(*gpuContext);
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace Curen {
+
+	// The benchmarks and tests, each selected by its own command line flag and run instead of the demo. The CPU cases
+	// build no window or device, the GPU cases share one device created for the first of them. --tests runs every
+	// test, --cpu-tests the ones that need no GPU.
+	class CurenBench {
+	public:
+		// True when any argument selects a benchmark or test
+		static bool isRequested(int argc, char** argv);
+		// Runs every selected case in command line order and returns the process exit code, EXIT_FAILURE once a case throws
+		static int run(int argc, char** argv);
+	};
+}
@@ -0,0 +1,191 @@
+#include "curen_bindless_table.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+using namespace Curen;
+
+static const VkDescriptorType BINDING_TYPES[] = {
+	VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+	VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+CurenBindlessTable::CurenBindlessTable(CurenDevice& curenDevice) :
+	m_curenDevice{ curenDevice }
+{
+	if (!m_curenDevice.isBindlessSupported()) {
+		throw std::runtime_error("bindless table needs descriptor indexing with update after bind!");
+	}
+
+	const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits = m_curenDevice.descriptorIndexingProperties();
+	uint32_t perStageShare = limits.maxPerStageUpdateAfterBindResources / 3;
+	m_slots[STORAGE_BUFFER_BINDING].capacity = std::min({ MAX_STORAGE_BUFFERS, perStageShare,
+		limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+	m_slots[SAMPLED_IMAGE_BINDING].capacity = std::min({ MAX_SAMPLED_IMAGES, perStageShare,
+		limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+	m_slots[SAMPLER_BINDING].capacity = std::min({ MAX_SAMPLERS, perStageShare,
+		limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+	// Unwritten indices are never read, and written ones may change while other frames are in flight
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	std::array<VkDescriptorBindingFlagsEXT, 3> bindingFlags{};
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
+	for (uint32_t binding = 0; binding < 3; binding++) {
+		bindings[binding].binding = binding;
+		bindings[binding].descriptorType = BINDING_TYPES[binding];
+		bindings[binding].descriptorCount = m_slots[binding].capacity;
+		bindings[binding].stageFlags = VK_SHADER_STAGE_ALL;
+		bindingFlags[binding] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+		poolSizes[binding] = { BINDING_TYPES[binding], m_slots[binding].capacity };
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+	if (vkCreateDescriptorSetLayout(m_curenDevice.device(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor set layout!");
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	if (vkCreateDescriptorPool(m_curenDevice.device(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_descriptorSetLayout;
+	if (vkAllocateDescriptorSets(m_curenDevice.device(), &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate bindless descriptor set!");
+	}
+}
+
+CurenBindlessTable::~CurenBindlessTable()
+{
+	vkDestroyDescriptorPool(m_curenDevice.device(), m_descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_curenDevice.device(), m_descriptorSetLayout, nullptr);
+}
+
+uint32_t CurenBindlessTable::addStorageBuffer(const VkDescriptorBufferInfo& bufferInfo)
+{
+	uint32_t index = allocateSlot(STORAGE_BUFFER_BINDING);
+	writeDescriptor(STORAGE_BUFFER_BINDING, index, &bufferInfo, nullptr);
+	return index;
+}
+
+uint32_t CurenBindlessTable::addSampledImage(VkImageView imageView, VkImageLayout imageLayout)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = imageView;
+	imageInfo.imageLayout = imageLayout;
+	uint32_t index = allocateSlot(SAMPLED_IMAGE_BINDING);
+	writeDescriptor(SAMPLED_IMAGE_BINDING, index, nullptr, &imageInfo);
+	return index;
+}
+
+uint32_t CurenBindlessTable::addSampler(VkSampler sampler)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+	uint32_t index = allocateSlot(SAMPLER_BINDING);
+	writeDescriptor(SAMPLER_BINDING, index, nullptr, &imageInfo);
+	return index;
+}
+
+void CurenBindlessTable::releaseStorageBuffer(uint32_t index)
+{
+	releaseSlot(STORAGE_BUFFER_BINDING, index);
+}
+
+void CurenBindlessTable::releaseSampledImage(uint32_t index)
+{
+	releaseSlot(SAMPLED_IMAGE_BINDING, index);
+}
+
+void CurenBindlessTable::releaseSampler(uint32_t index)
+{
+	releaseSlot(SAMPLER_BINDING, index);
+}
+
+void CurenBindlessTable::beginFrame()
+{
+	m_frameCount++;
+	for (auto& slots : m_slots) {
+		auto recycled = std::partition(slots.retiredSlots.begin(), slots.retiredSlots.end(), [this](const std::pair<uint32_t, uint64_t>& retiredSlot) {
+			return retiredSlot.second + CurenSwapChain::MAX_FRAMES_IN_FLIGHT > m_frameCount;
+		});
+		for (auto retiredSlot = recycled; retiredSlot != slots.retiredSlots.end(); ++retiredSlot) {
+			slots.freeSlots.push_back(retiredSlot->first);
+		}
+		slots.retiredSlots.erase(recycled, slots.retiredSlots.end());
+	}
+}
+
+CurenBindlessTable::Statistics CurenBindlessTable::getStatistics() const
+{
+	Statistics statistics{};
+	statistics.storageBufferCount = m_slots[STORAGE_BUFFER_BINDING].liveCount;
+	statistics.sampledImageCount = m_slots[SAMPLED_IMAGE_BINDING].liveCount;
+	statistics.samplerCount = m_slots[SAMPLER_BINDING].liveCount;
+	return statistics;
+}
+
+uint32_t CurenBindlessTable::allocateSlot(uint32_t binding)
+{
+	SlotAllocator& slots = m_slots[binding];
+	uint32_t index;
+	if (!slots.freeSlots.empty()) {
+		index = slots.freeSlots.back();
+		slots.freeSlots.pop_back();
+	}
+	else if (slots.nextSlot < slots.capacity) {
+		index = slots.nextSlot++;
+	}
+	else {
+		throw std::runtime_error("bindless table binding " + std::to_string(binding) + " is full: " + std::to_string(slots.capacity) + " descriptors");
+	}
+	slots.liveCount++;
+	return index;
+}
+
+void CurenBindlessTable::releaseSlot(uint32_t binding, uint32_t index)
+{
+	SlotAllocator& slots = m_slots[binding];
+	assert(index < slots.nextSlot && "Index was not handed out by this table");
+	// The descriptor stays written, nothing reads it until the index is handed out again
+	slots.retiredSlots.push_back({ index, m_frameCount });
+	slots.liveCount--;
+}
+
+void CurenBindlessTable::writeDescriptor(uint32_t binding, uint32_t index, const VkDescriptorBufferInfo* bufferInfo,
+	const VkDescriptorImageInfo* imageInfo)
+{
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = m_descriptorSet;
+	write.dstBinding = binding;
+	write.dstArrayElement = index;
+	write.descriptorType = BINDING_TYPES[binding];
+	write.descriptorCount = 1;
+	write.pBufferInfo = bufferInfo;
+	write.pImageInfo = imageInfo;
+	vkUpdateDescriptorSets(m_curenDevice.device(), 1, &write, 0, nullptr);
+}
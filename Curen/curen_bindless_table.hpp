@@ -0,0 +1,84 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_swap_chain.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Curen {
+
+	// One large update-after-bind descriptor set holding arrays of storage buffers, sampled images and samplers.
+	// Resources get a stable index when they are added and shaders reach them through that index, passed in push
+	// constants or per draw data, so the set is bound once per pass instead of a set per draw. Released indices are
+	// reused only after MAX_FRAMES_IN_FLIGHT frames, so a frame in flight never sees its descriptor replaced.
+	// Needs CurenDevice::isBindlessSupported. Render thread only.
+	//
+	// GLSL declares the set with runtime sized arrays, for example
+	//   layout(set = 1, binding = 0) readonly buffer Buffers { ... } buffers[];
+	//   layout(set = 1, binding = 1) uniform texture2D images[];
+	//   layout(set = 1, binding = 2) uniform sampler samplers[];
+	class CurenBindlessTable {
+	public:
+		static constexpr uint32_t STORAGE_BUFFER_BINDING = 0;
+		static constexpr uint32_t SAMPLED_IMAGE_BINDING = 1;
+		static constexpr uint32_t SAMPLER_BINDING = 2;
+		// Upper bounds, lowered to the device's update-after-bind limits
+		static constexpr uint32_t MAX_STORAGE_BUFFERS = 16 * 1024;
+		static constexpr uint32_t MAX_SAMPLED_IMAGES = 16 * 1024;
+		static constexpr uint32_t MAX_SAMPLERS = 256;
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		struct Statistics {
+			uint32_t storageBufferCount;
+			uint32_t sampledImageCount;
+			uint32_t samplerCount;
+		};
+
+		CurenBindlessTable(CurenDevice& curenDevice);
+		~CurenBindlessTable();
+
+		CurenBindlessTable(const CurenBindlessTable&) = delete;
+		CurenBindlessTable& operator = (const CurenBindlessTable&) = delete;
+
+		// Throw once the array is full
+		uint32_t addStorageBuffer(const VkDescriptorBufferInfo& bufferInfo);
+		uint32_t addSampledImage(VkImageView imageView, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		uint32_t addSampler(VkSampler sampler);
+		// The resource has to stay alive until the frames recorded so far have finished
+		void releaseStorageBuffer(uint32_t index);
+		void releaseSampledImage(uint32_t index);
+		void releaseSampler(uint32_t index);
+
+		// Once per frame after its fence has been waited on, recycles indices released long enough ago
+		void beginFrame();
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return m_descriptorSetLayout; }
+		VkDescriptorSet getDescriptorSet() const { return m_descriptorSet; }
+		Statistics getStatistics() const;
+
+	private:
+		// Stable indices into one array binding
+		struct SlotAllocator {
+			uint32_t capacity = 0;
+			uint32_t nextSlot = 0;
+			uint32_t liveCount = 0;
+			std::vector<uint32_t> freeSlots;
+			// Released slots and the frame they were released in
+			std::vector<std::pair<uint32_t, uint64_t>> retiredSlots;
+		};
+
+		uint32_t allocateSlot(uint32_t binding);
+		void releaseSlot(uint32_t binding, uint32_t index);
+		void writeDescriptor(uint32_t binding, uint32_t index, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo);
+
+		CurenDevice& m_curenDevice;
+		VkDescriptorSetLayout m_descriptorSetLayout;
+		VkDescriptorPool m_descriptorPool;
+		VkDescriptorSet m_descriptorSet;
+
+		std::array<SlotAllocator, 3> m_slots;
+		uint64_t m_frameCount = 0;
+	};
+}
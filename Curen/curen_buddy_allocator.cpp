@@ -0,0 +1,101 @@
+#include "curen_buddy_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace Curen;
+
+CurenBuddyAllocator::CurenBuddyAllocator(VkDeviceSize capacity, VkDeviceSize minBlockSize) :
+	m_capacity{ capacity }, m_minBlockSize{ minBlockSize }
+{
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Buddy capacity has to be a power of two.");
+	assert(minBlockSize > 0 && (minBlockSize & (minBlockSize - 1)) == 0 && minBlockSize <= capacity &&
+		"Buddy minimum block size has to be a power of two no larger than the capacity.");
+
+	m_levelCount = 1;
+	while (levelSize(m_levelCount - 1) < m_capacity) {
+		m_levelCount++;
+	}
+	m_freeNodes.resize(m_levelCount);
+	m_freeNodes[m_levelCount - 1].insert(0);
+}
+
+VkDeviceSize CurenBuddyAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	if (size == 0 || size > m_capacity || alignment > m_capacity) {
+		return INVALID_OFFSET;
+	}
+
+	// Nodes are aligned to their size, so a node at least as large as the alignment satisfies it
+	uint32_t level = levelFor(std::max(size, alignment));
+	uint32_t freeLevel = level;
+	while (freeLevel < m_levelCount && m_freeNodes[freeLevel].empty()) {
+		freeLevel++;
+	}
+	if (freeLevel == m_levelCount) {
+		return INVALID_OFFSET;
+	}
+
+	auto node = m_freeNodes[freeLevel].begin();
+	VkDeviceSize offset = *node;
+	m_freeNodes[freeLevel].erase(node);
+	// Split down to the requested level, the upper halves stay free
+	while (freeLevel > level) {
+		freeLevel--;
+		m_freeNodes[freeLevel].insert(offset + levelSize(freeLevel));
+	}
+
+	m_allocatedNodes.emplace(offset, level);
+	m_usedSize += levelSize(level);
+	m_allocationCount++;
+	return offset;
+}
+
+void CurenBuddyAllocator::free(VkDeviceSize offset)
+{
+	auto node = m_allocatedNodes.find(offset);
+	assert(node != m_allocatedNodes.end() && "Freed offset was not allocated.");
+	uint32_t level = node->second;
+	m_allocatedNodes.erase(node);
+	m_usedSize -= levelSize(level);
+	m_allocationCount--;
+
+	while (level + 1 < m_levelCount) {
+		VkDeviceSize buddy = offset ^ levelSize(level);
+		auto buddyNode = m_freeNodes[level].find(buddy);
+		if (buddyNode == m_freeNodes[level].end()) {
+			break;
+		}
+		m_freeNodes[level].erase(buddyNode);
+		offset = std::min(offset, buddy);
+		level++;
+	}
+	m_freeNodes[level].insert(offset);
+}
+
+CurenBuddyAllocator::Statistics CurenBuddyAllocator::getStatistics() const
+{
+	Statistics statistics{};
+	statistics.capacity = m_capacity;
+	statistics.usedSize = m_usedSize;
+	statistics.allocationCount = m_allocationCount;
+	for (uint32_t level = 0; level < m_levelCount; level++) {
+		if (!m_freeNodes[level].empty()) {
+			statistics.largestFreeBlock = levelSize(level);
+			statistics.freeBlockCount += static_cast<uint32_t>(m_freeNodes[level].size());
+		}
+	}
+
+	VkDeviceSize freeSize = m_capacity - m_usedSize;
+	statistics.fragmentation = freeSize > 0 ? 1.f - static_cast<float>(statistics.largestFreeBlock) / static_cast<float>(freeSize) : 0.f;
+	return statistics;
+}
+
+uint32_t CurenBuddyAllocator::levelFor(VkDeviceSize size) const
+{
+	uint32_t level = 0;
+	while (levelSize(level) < size) {
+		level++;
+	}
+	return level;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Curen {
+
+	// Binary buddy sub-allocator over a power of two range. Every allocation is rounded up to a power of two node,
+	// which is aligned to its own size, and a freed node merges with its buddy in constant time per level.
+	// Only does the bookkeeping, the memory itself belongs to the owner.
+	class CurenBuddyAllocator {
+	public:
+		static constexpr VkDeviceSize INVALID_OFFSET = ~static_cast<VkDeviceSize>(0);
+
+		struct Statistics {
+			VkDeviceSize capacity;
+			// Node sizes, including the rounding up to powers of two
+			VkDeviceSize usedSize;
+			VkDeviceSize largestFreeBlock;
+			uint32_t allocationCount;
+			uint32_t freeBlockCount;
+			// 0 when all free space is one node, close to 1 when it is scattered into small ones
+			float fragmentation;
+		};
+
+		// capacity and minBlockSize have to be powers of two
+		CurenBuddyAllocator(VkDeviceSize capacity, VkDeviceSize minBlockSize);
+
+		CurenBuddyAllocator(const CurenBuddyAllocator&) = delete;
+		CurenBuddyAllocator& operator = (const CurenBuddyAllocator&) = delete;
+
+		// alignment has to be a power of two. Returns INVALID_OFFSET when no free node is large enough.
+		VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment = 1);
+		void free(VkDeviceSize offset);
+
+		bool isEmpty() const { return m_allocationCount == 0; }
+		Statistics getStatistics() const;
+
+	private:
+		uint32_t levelFor(VkDeviceSize size) const;
+		VkDeviceSize levelSize(uint32_t level) const { return m_minBlockSize << level; }
+
+		VkDeviceSize m_capacity;
+		VkDeviceSize m_minBlockSize;
+		uint32_t m_levelCount;
+		VkDeviceSize m_usedSize = 0;
+		uint32_t m_allocationCount = 0;
+
+		// Free node offsets per level, level 0 holds nodes of minBlockSize
+		std::vector<std::unordered_set<VkDeviceSize>> m_freeNodes;
+		// offset -> level of every allocated node
+		std::unordered_map<VkDeviceSize, uint32_t> m_allocatedNodes;
+	};
+}
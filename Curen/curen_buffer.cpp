@@ -1,4 +1,5 @@
 #include "curen_buffer.hpp"
+#include "curen_descriptor.hpp"
 
 /*
  * Encapsulates a vulkan buffer
@@ -8,9 +9,16 @@
  */
 
  // std
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CUREN_HAS_STREAMING_STORES
+#endif
+
 namespace Curen {
 
     /**
@@ -29,6 +37,29 @@ namespace Curen {
         return instanceSize;
     }
 
+    /**
+     * Returns the memory properties to prefer on top of the required ones
+     *
+     * Host visible buffers prefer coherent memory, which needs no flushes. Buffers the device reads, such as
+     * per frame uniforms or indirect commands, also prefer device local memory, the resizable BAR heap on
+     * discrete GPUs and all memory on integrated ones. Staging sources stay in system memory.
+     *
+     * @param usageFlags Usage of the buffer
+     * @param memoryPropertyFlags Required memory properties
+     *
+     * @return Preferred memory properties, 0 for buffers that are not host visible
+     */
+    VkMemoryPropertyFlags CurenBuffer::getPreferredMemoryPropertyFlags(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags) {
+        if (!(memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+            return 0;
+        }
+        VkMemoryPropertyFlags preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (!(usageFlags & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) {
+            preferred |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        }
+        return preferred;
+    }
+
     CurenBuffer::CurenBuffer(
         CurenDevice& device,
         VkDeviceSize instanceSize,
@@ -43,17 +74,21 @@ namespace Curen {
         memoryPropertyFlags{ memoryPropertyFlags } {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(
+            bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation, getPreferredMemoryPropertyFlags(usageFlags, memoryPropertyFlags));
+        coherent = device.memoryAllocator().isCoherent(allocation);
     }
 
     CurenBuffer::~CurenBuffer() {
+        m_curenDevice.descriptorCache().invalidateBuffer(buffer);
         unmap();
         vkDestroyBuffer(m_curenDevice.device(), buffer, nullptr);
-        vkFreeMemory(m_curenDevice.device(), memory, nullptr);
+        m_curenDevice.memoryAllocator().free(allocation);
     }
 
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+     * Host visible memory blocks stay mapped, so this only points into the persistent mapping.
      *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
@@ -62,27 +97,29 @@ namespace Curen {
      * @return VkResult of the buffer mapping call
      */
     VkResult CurenBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(m_curenDevice.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation.memory && "Called map on buffer before create");
+        if (allocation.mappedData == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        mapped = static_cast<char*>(allocation.mappedData) + offset;
+        return VK_SUCCESS;
     }
 
     /**
      * Unmap a mapped memory range
      *
-     * @note Does not return a result as vkUnmapMemory can't fail
+     * @note The block mapping is shared with other buffers and stays in place
      */
     void CurenBuffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(m_curenDevice.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     /**
-     * Copies the specified data to the mapped buffer. Default value writes whole buffer range
+     * Copies the specified data to the mapped buffer and marks the range dirty. Default value writes whole
+     * buffer range, pass the size of the data when only part of the buffer changed.
      *
      * @param data Pointer to the data to copy
-     * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to flush the complete buffer
+     * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to write the complete buffer
      * range.
      * @param offset (Optional) Byte offset from beginning of mapped region
      *
@@ -92,18 +129,105 @@ namespace Curen {
 
         if (size == VK_WHOLE_SIZE) {
             memcpy(mapped, data, bufferSize);
+            markDirty(bufferSize, 0);
         }
         else {
             char* memOffset = (char*)mapped;
             memOffset += offset;
             memcpy(memOffset, data, size);
+            markDirty(size, offset);
         }
     }
 
+    /**
+     * Copies the specified data to the mapped buffer with non-temporal stores and marks the range dirty
+     *
+     * @note Meant for write-combined memory, device local host visible memory in particular: the stores
+     * bypass the cache and fill whole write-combining lines. Never read the mapping back, uncached reads
+     * are very slow. Falls back to memcpy without SSE2.
+     *
+     * @param data Pointer to the data to copy
+     * @param size Size of the data to copy
+     * @param offset (Optional) Byte offset from beginning of mapped region
+     *
+     */
+    void CurenBuffer::streamToBuffer(const void* data, VkDeviceSize size, VkDeviceSize offset) {
+        assert(mapped && "Cannot copy to unmapped buffer");
+        assert(offset + size <= bufferSize && "Stream write past the end of the buffer");
+
+        char* dst = static_cast<char*>(mapped) + offset;
+        const char* src = static_cast<const char*>(data);
+        VkDeviceSize remaining = size;
+#ifdef CUREN_HAS_STREAMING_STORES
+        VkDeviceSize head = std::min<VkDeviceSize>((16 - reinterpret_cast<uintptr_t>(dst) % 16) % 16, remaining);
+        memcpy(dst, src, head);
+        dst += head;
+        src += head;
+        remaining -= head;
+        for (; remaining >= 64; remaining -= 64, dst += 64, src += 64) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+        }
+        for (; remaining >= 16; remaining -= 16, dst += 16, src += 16) {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+        }
+#endif
+        memcpy(dst, src, remaining);
+#ifdef CUREN_HAS_STREAMING_STORES
+        // Non-temporal stores are weakly ordered, they have to land before the submit that reads them
+        _mm_sfence();
+#endif
+        markDirty(size, offset);
+    }
+
+    /**
+     * Records a range written through getMappedMemory for the next flushDirtyRanges
+     *
+     * @note Does nothing on coherent memory
+     *
+     * @param size Size of the written range
+     * @param offset (Optional) Byte offset from beginning
+     *
+     */
+    void CurenBuffer::markDirty(VkDeviceSize size, VkDeviceSize offset) {
+        if (coherent || size == 0) {
+            return;
+        }
+
+        VkDeviceSize atomSize = m_curenDevice.memoryAllocator().getNonCoherentAtomSize();
+        VkDeviceSize begin = offset / atomSize * atomSize;
+        VkDeviceSize end = std::min((offset + size + atomSize - 1) / atomSize * atomSize, bufferSize);
+
+        // Writes tend to be in order, so only the last range is a merge candidate
+        if (!dirtyRanges.empty()) {
+            CurenMemoryAllocator::Range& last = dirtyRanges.back();
+            if (begin <= last.offset + last.size && end >= last.offset) {
+                VkDeviceSize mergedBegin = std::min(begin, last.offset);
+                last.size = std::max(end, last.offset + last.size) - mergedBegin;
+                last.offset = mergedBegin;
+                return;
+            }
+        }
+        if (dirtyRanges.size() == MAX_DIRTY_RANGES) {
+            for (auto& range : dirtyRanges) {
+                begin = std::min(begin, range.offset);
+                end = std::max(end, range.offset + range.size);
+            }
+            dirtyRanges.clear();
+        }
+        dirtyRanges.push_back({ begin, end - begin });
+    }
+
     /**
      * Flush a memory range of the buffer to make it visible to the device
      *
-     * @note Only required for non-coherent memory
+     * @note Only required for non-coherent memory, returns right away on coherent memory
      *
      * @param size (Optional) Size of the memory range to flush. Pass VK_WHOLE_SIZE to flush the
      * complete buffer range.
@@ -112,12 +236,24 @@ namespace Curen {
      * @return VkResult of the flush call
      */
     VkResult CurenBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(m_curenDevice.device(), 1, &mappedRange);
+        return m_curenDevice.memoryAllocator().flush(allocation, size, offset);
+    }
+
+    /**
+     * Flush every range written through writeToBuffer, writeToIndex, streamToBuffer or markDirty since the
+     * last call, in one vkFlushMappedMemoryRanges
+     *
+     * @note Returns right away on coherent memory
+     *
+     * @return VkResult of the flush call
+     */
+    VkResult CurenBuffer::flushDirtyRanges() {
+        if (dirtyRanges.empty()) {
+            return VK_SUCCESS;
+        }
+        VkResult result = m_curenDevice.memoryAllocator().flush(allocation, dirtyRanges.data(), static_cast<uint32_t>(dirtyRanges.size()));
+        dirtyRanges.clear();
+        return result;
     }
 
     /**
@@ -132,12 +268,7 @@ namespace Curen {
      * @return VkResult of the invalidate call
      */
     VkResult CurenBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(m_curenDevice.device(), 1, &mappedRange);
+        return m_curenDevice.memoryAllocator().invalidate(allocation, size, offset);
     }
 
     /**
@@ -1,5 +1,8 @@
 #pragma once
 #include "curen_device.hpp"
+
+#include <vector>
+
 namespace Curen {
 
     class CurenBuffer {
@@ -20,7 +23,10 @@ namespace Curen {
         void unmap();
 
         void writeToBuffer(void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        void streamToBuffer(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+        void markDirty(VkDeviceSize size, VkDeviceSize offset = 0);
         VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        VkResult flushDirtyRanges();
         VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
         VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
@@ -36,15 +42,22 @@ namespace Curen {
         VkDeviceSize getAlignmentSize() const { return instanceSize; }
         VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
         VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
+        // Flags of the memory type actually picked, a superset of getMemoryPropertyFlags
+        VkMemoryPropertyFlags getAllocatedMemoryPropertyFlags() const { return m_curenDevice.memoryAllocator().getMemoryPropertyFlags(allocation); }
+        bool isCoherent() const { return coherent; }
         VkDeviceSize getBufferSize() const { return bufferSize; }
 
     private:
         static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
+        static VkMemoryPropertyFlags getPreferredMemoryPropertyFlags(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags);
+
+        // Past this many separate ranges the next write collapses them into one covering range
+        static constexpr size_t MAX_DIRTY_RANGES = 16;
 
         CurenDevice& m_curenDevice;
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        CurenMemoryAllocator::Allocation allocation{};
 
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
@@ -52,6 +65,9 @@ namespace Curen {
         VkDeviceSize alignmentSize;
         VkBufferUsageFlags usageFlags;
         VkMemoryPropertyFlags memoryPropertyFlags;
+        bool coherent;
+        // Written since the last flushDirtyRanges, rounded to nonCoherentAtomSize. Stays empty on coherent memory.
+        std::vector<CurenMemoryAllocator::Range> dirtyRanges;
     };
 
 }  // namespace Curen
\ No newline at end of file
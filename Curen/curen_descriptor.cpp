@@ -1,5 +1,7 @@
 #include "curen_descriptor.hpp"
+#include "curen_utils.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
@@ -22,22 +24,40 @@ namespace Curen {
         return *this;
     }
 
+    CurenDescriptorSetLayout::Builder& CurenDescriptorSetLayout::Builder::setPushDescriptor() {
+        if (CurenDevice.isPushDescriptorSupported()) {
+            flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+        }
+        return *this;
+    }
+
     std::unique_ptr<CurenDescriptorSetLayout> CurenDescriptorSetLayout::Builder::build() const {
-        return std::make_unique<CurenDescriptorSetLayout>(CurenDevice, bindings);
+        return std::make_unique<CurenDescriptorSetLayout>(CurenDevice, bindings, flags);
+    }
+
+    CurenDescriptorSetLayout& CurenDescriptorSetLayout::Builder::buildCached() const {
+        return CurenDevice.descriptorCache().getLayout(bindings, flags);
     }
 
     // *************** Descriptor Set Layout *********************
 
     CurenDescriptorSetLayout::CurenDescriptorSetLayout(
-        CurenDevice& curenDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> p_bindings)
-        : m_curenDevice{ curenDevice }, bindings{ p_bindings } {
+        CurenDevice& curenDevice,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> p_bindings,
+        VkDescriptorSetLayoutCreateFlags p_flags)
+        : m_curenDevice{ curenDevice }, bindings{ p_bindings }, flags{ p_flags } {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        uint32_t descriptorCount = 0;
         for (auto kv : bindings) {
             setLayoutBindings.push_back(kv.second);
+            descriptorCount += kv.second.descriptorCount;
         }
+        // maxPushDescriptors is at least 32 on every device with the extension
+        assert((!isPushDescriptor() || descriptorCount <= 32) && "Too many descriptors for a push descriptor layout");
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
         descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutInfo.flags = flags;
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
@@ -109,8 +129,7 @@ namespace Curen {
         allocInfo.pSetLayouts = &descriptorSetLayout;
         allocInfo.descriptorSetCount = 1;
 
-        // Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-        // a new pool whenever an old pool fills up. But this is beyond our current scope
+        // A full pool fails here, CurenDescriptorAllocator chains a new pool in that case
         if (vkAllocateDescriptorSets(m_curenDevice.device(), &allocInfo, &descriptor) != VK_SUCCESS) {
             return false;
         }
@@ -129,10 +148,339 @@ namespace Curen {
         vkResetDescriptorPool(m_curenDevice.device(), descriptorPool, 0);
     }
 
+    // *************** Descriptor Allocator *********************
+
+    CurenDescriptorAllocator::CurenDescriptorAllocator(CurenDevice& curenDevice, VkDescriptorPoolCreateFlags poolFlags)
+        : m_curenDevice{ curenDevice }, m_poolFlags{ poolFlags } {}
+
+    void CurenDescriptorAllocator::allocateDescriptor(const CurenDescriptorSetLayout& setLayout, VkDescriptorSet& descriptor) {
+        for (auto& kv : setLayout.bindings) {
+            m_observedDescriptorCounts[kv.second.descriptorType] += kv.second.descriptorCount;
+        }
+        m_observedSetCount++;
+
+        // Pools before the current one are full, unless sets were freed from them
+        bool isFreeing = m_poolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        size_t firstPool = isFreeing ? 0 : m_currentPool;
+        for (size_t i = firstPool; i < m_pools.size(); i++) {
+            size_t poolIndex = isFreeing ? (m_currentPool + i) % m_pools.size() : i;
+            if (m_pools[poolIndex]->allocateDescriptor(setLayout.getDescriptorSetLayout(), descriptor)) {
+                m_currentPool = poolIndex;
+                m_setCount++;
+                if (isFreeing) {
+                    m_setPools[descriptor] = poolIndex;
+                }
+                return;
+            }
+        }
+
+        // Out of pool memory or fragmented everywhere
+        createPool(setLayout);
+        m_currentPool = m_pools.size() - 1;
+        if (!m_pools.back()->allocateDescriptor(setLayout.getDescriptorSetLayout(), descriptor)) {
+            throw std::runtime_error("failed to allocate descriptor set from a new pool!");
+        }
+        m_setCount++;
+        if (isFreeing) {
+            m_setPools[descriptor] = m_currentPool;
+        }
+    }
+
+    void CurenDescriptorAllocator::freeDescriptors(std::vector<VkDescriptorSet>& descriptors) {
+        assert((m_poolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) && "Allocator does not free individual sets");
+
+        std::vector<std::vector<VkDescriptorSet>> poolDescriptors(m_pools.size());
+        for (VkDescriptorSet descriptor : descriptors) {
+            auto setPool = m_setPools.find(descriptor);
+            assert(setPool != m_setPools.end() && "Descriptor set was not allocated here");
+            poolDescriptors[setPool->second].push_back(descriptor);
+            m_setPools.erase(setPool);
+        }
+        for (size_t i = 0; i < m_pools.size(); i++) {
+            if (!poolDescriptors[i].empty()) {
+                m_pools[i]->freeDescriptors(poolDescriptors[i]);
+            }
+        }
+        m_setCount -= static_cast<uint32_t>(descriptors.size());
+    }
+
+    void CurenDescriptorAllocator::resetPools() {
+        for (auto& pool : m_pools) {
+            pool->resetPool();
+        }
+        m_currentPool = 0;
+        m_setPools.clear();
+        m_setCount = 0;
+    }
+
+    CurenDescriptorAllocator::Statistics CurenDescriptorAllocator::getStatistics() const {
+        Statistics statistics{};
+        statistics.poolCount = static_cast<uint32_t>(m_pools.size());
+        statistics.setCount = m_setCount;
+        for (uint32_t maxSets : m_poolMaxSets) {
+            statistics.maxSetCount += maxSets;
+        }
+        return statistics;
+    }
+
+    void CurenDescriptorAllocator::createPool(const CurenDescriptorSetLayout& setLayout) {
+        uint32_t maxSets = INITIAL_SETS_PER_POOL;
+        for (size_t i = 0; i < m_pools.size() && maxSets < MAX_SETS_PER_POOL; i++) {
+            maxSets *= 2;
+        }
+        maxSets = std::min(maxSets, MAX_SETS_PER_POOL);
+
+        // Scale the observed mix to the new pool, but never below what the set that did not fit needs
+        std::map<VkDescriptorType, uint32_t> descriptorCounts{};
+        for (auto& observed : m_observedDescriptorCounts) {
+            descriptorCounts[observed.first] = static_cast<uint32_t>((observed.second * maxSets + m_observedSetCount - 1) / m_observedSetCount);
+        }
+        for (auto& kv : setLayout.bindings) {
+            uint32_t& count = descriptorCounts[kv.second.descriptorType];
+            count = std::max(count, kv.second.descriptorCount);
+        }
+
+        CurenDescriptorPool::Builder builder{ m_curenDevice };
+        builder.setMaxSets(maxSets).setPoolFlags(m_poolFlags);
+        for (auto& descriptorCount : descriptorCounts) {
+            builder.addPoolSize(descriptorCount.first, descriptorCount.second);
+        }
+        m_pools.push_back(builder.build());
+        m_poolMaxSets.push_back(maxSets);
+    }
+
+    // *************** Descriptor Cache *********************
+
+    bool CurenDescriptorCache::LayoutKey::operator==(const LayoutKey& other) const {
+        if (flags != other.flags || bindings.size() != other.bindings.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < bindings.size(); i++) {
+            const VkDescriptorSetLayoutBinding& a = bindings[i];
+            const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+            if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+                a.stageFlags != b.stageFlags || a.pImmutableSamplers != b.pImmutableSamplers) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool CurenDescriptorCache::DescriptorKey::operator==(const DescriptorKey& other) const {
+        return binding == other.binding && arrayElement == other.arrayElement && descriptorType == other.descriptorType &&
+            buffer == other.buffer && offset == other.offset && range == other.range &&
+            sampler == other.sampler && imageView == other.imageView && imageLayout == other.imageLayout;
+    }
+
+    bool CurenDescriptorCache::SetKey::operator==(const SetKey& other) const {
+        return setLayout == other.setLayout && descriptors == other.descriptors;
+    }
+
+    bool CurenDescriptorCache::PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const {
+        if (setLayouts != other.setLayouts || pushConstantRanges.size() != other.pushConstantRanges.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < pushConstantRanges.size(); i++) {
+            const VkPushConstantRange& a = pushConstantRanges[i];
+            const VkPushConstantRange& b = other.pushConstantRanges[i];
+            if (a.stageFlags != b.stageFlags || a.offset != b.offset || a.size != b.size) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t CurenDescriptorCache::KeyHash::operator()(const LayoutKey& key) const {
+        size_t seed = key.bindings.size();
+        Utils::hashCombine(seed, key.flags);
+        for (auto& binding : key.bindings) {
+            Utils::hashCombine(seed, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags);
+        }
+        return seed;
+    }
+
+    size_t CurenDescriptorCache::KeyHash::operator()(const SetKey& key) const {
+        size_t seed = key.descriptors.size();
+        Utils::hashCombine(seed, key.setLayout);
+        for (auto& descriptor : key.descriptors) {
+            Utils::hashCombine(seed, descriptor.binding, descriptor.arrayElement, descriptor.buffer, descriptor.offset, descriptor.range,
+                descriptor.imageView, descriptor.sampler);
+        }
+        return seed;
+    }
+
+    size_t CurenDescriptorCache::KeyHash::operator()(const PipelineLayoutKey& key) const {
+        size_t seed = key.setLayouts.size();
+        for (VkDescriptorSetLayout setLayout : key.setLayouts) {
+            Utils::hashCombine(seed, setLayout);
+        }
+        for (auto& range : key.pushConstantRanges) {
+            Utils::hashCombine(seed, range.stageFlags, range.offset, range.size);
+        }
+        return seed;
+    }
+
+    CurenDescriptorCache::CurenDescriptorCache(CurenDevice& curenDevice)
+        : m_curenDevice{ curenDevice }, m_setAllocator{ curenDevice, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT } {}
+
+    CurenDescriptorCache::~CurenDescriptorCache() {
+        for (auto& kv : m_pipelineLayouts) {
+            vkDestroyPipelineLayout(m_curenDevice.device(), kv.second, nullptr);
+        }
+    }
+
+    CurenDescriptorSetLayout& CurenDescriptorCache::getLayout(
+        const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags) {
+        LayoutKey key{};
+        key.flags = flags;
+        for (auto& kv : bindings) {
+            key.bindings.push_back(kv.second);
+        }
+        std::sort(key.bindings.begin(), key.bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        auto layout = m_layouts.find(key);
+        if (layout != m_layouts.end()) {
+            m_statistics.layoutHits++;
+            return *layout->second;
+        }
+        m_statistics.layoutMisses++;
+        auto setLayout = std::make_unique<CurenDescriptorSetLayout>(m_curenDevice, bindings, flags);
+        return *m_layouts.emplace(std::move(key), std::move(setLayout)).first->second;
+    }
+
+    VkDescriptorSet CurenDescriptorCache::getSet(
+        const CurenDescriptorSetLayout& setLayout, const std::vector<VkWriteDescriptorSet>& writes) {
+        SetKey key{};
+        key.setLayout = setLayout.getDescriptorSetLayout();
+        for (auto& write : writes) {
+            assert((write.pBufferInfo != nullptr || write.pImageInfo != nullptr) && "Only buffer and image descriptors are cached");
+            for (uint32_t i = 0; i < write.descriptorCount; i++) {
+                DescriptorKey descriptor{};
+                descriptor.binding = write.dstBinding;
+                descriptor.arrayElement = write.dstArrayElement + i;
+                descriptor.descriptorType = write.descriptorType;
+                if (write.pBufferInfo != nullptr) {
+                    descriptor.buffer = write.pBufferInfo[i].buffer;
+                    descriptor.offset = write.pBufferInfo[i].offset;
+                    descriptor.range = write.pBufferInfo[i].range;
+                }
+                else {
+                    descriptor.sampler = write.pImageInfo[i].sampler;
+                    descriptor.imageView = write.pImageInfo[i].imageView;
+                    descriptor.imageLayout = write.pImageInfo[i].imageLayout;
+                }
+                key.descriptors.push_back(descriptor);
+            }
+        }
+        std::sort(key.descriptors.begin(), key.descriptors.end(), [](const DescriptorKey& a, const DescriptorKey& b) {
+            return a.binding != b.binding ? a.binding < b.binding : a.arrayElement < b.arrayElement;
+        });
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        auto cachedSet = m_sets.find(key);
+        if (cachedSet != m_sets.end()) {
+            m_statistics.setHits++;
+            return cachedSet->second;
+        }
+        m_statistics.setMisses++;
+
+        VkDescriptorSet set{};
+        m_setAllocator.allocateDescriptor(setLayout, set);
+        std::vector<VkWriteDescriptorSet> setWrites{ writes };
+        for (auto& write : setWrites) {
+            write.dstSet = set;
+        }
+        vkUpdateDescriptorSets(m_curenDevice.device(), static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+
+        auto entry = m_sets.emplace(std::move(key), set).first;
+        m_setKeys[set] = &entry->first;
+        for (auto& descriptor : entry->first.descriptors) {
+            if (descriptor.buffer != VK_NULL_HANDLE) {
+                m_bufferSets[descriptor.buffer].insert(set);
+            }
+        }
+        return set;
+    }
+
+    VkPipelineLayout CurenDescriptorCache::getPipelineLayout(
+        const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+        PipelineLayoutKey key{ setLayouts, pushConstantRanges };
+        std::sort(key.pushConstantRanges.begin(), key.pushConstantRanges.end(), [](const VkPushConstantRange& a, const VkPushConstantRange& b) {
+            return a.offset != b.offset ? a.offset < b.offset : a.stageFlags < b.stageFlags;
+        });
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        auto cachedLayout = m_pipelineLayouts.find(key);
+        if (cachedLayout != m_pipelineLayouts.end()) {
+            m_statistics.pipelineLayoutHits++;
+            return cachedLayout->second;
+        }
+        m_statistics.pipelineLayoutMisses++;
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = key.setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(key.pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = key.pushConstantRanges.data();
+        VkPipelineLayout pipelineLayout;
+        if (vkCreatePipelineLayout(m_curenDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        m_pipelineLayouts.emplace(std::move(key), pipelineLayout);
+        return pipelineLayout;
+    }
+
+    void CurenDescriptorCache::invalidateBuffer(VkBuffer buffer) {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        auto bufferSets = m_bufferSets.find(buffer);
+        if (bufferSets == m_bufferSets.end()) {
+            return;
+        }
+        std::vector<VkDescriptorSet> invalidatedSets{ bufferSets->second.begin(), bufferSets->second.end() };
+        m_bufferSets.erase(bufferSets);
+
+        for (VkDescriptorSet set : invalidatedSets) {
+            auto setKey = m_setKeys.find(set);
+            // The other buffers of the set stay alive and must not keep pointing at it
+            for (auto& descriptor : setKey->second->descriptors) {
+                auto otherSets = m_bufferSets.find(descriptor.buffer);
+                if (otherSets != m_bufferSets.end()) {
+                    otherSets->second.erase(set);
+                    if (otherSets->second.empty()) {
+                        m_bufferSets.erase(otherSets);
+                    }
+                }
+            }
+            // By iterator, the key lives inside the node being erased
+            m_sets.erase(m_sets.find(*setKey->second));
+            m_setKeys.erase(setKey);
+        }
+        m_setAllocator.freeDescriptors(invalidatedSets);
+        m_statistics.invalidatedSetCount += invalidatedSets.size();
+    }
+
+    CurenDescriptorCache::Statistics CurenDescriptorCache::getStatistics() const {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        Statistics statistics = m_statistics;
+        statistics.layoutCount = static_cast<uint32_t>(m_layouts.size());
+        statistics.setCount = static_cast<uint32_t>(m_sets.size());
+        statistics.pipelineLayoutCount = static_cast<uint32_t>(m_pipelineLayouts.size());
+        return statistics;
+    }
+
     // *************** Descriptor Writer *********************
 
     CurenDescriptorWriter::CurenDescriptorWriter(CurenDescriptorSetLayout& setLayout, CurenDescriptorPool& pool)
-        : setLayout{ setLayout }, pool{ pool } {}
+        : setLayout{ setLayout }, pool{ &pool } {}
+
+    CurenDescriptorWriter::CurenDescriptorWriter(CurenDescriptorSetLayout& setLayout, CurenDescriptorAllocator& allocator)
+        : setLayout{ setLayout }, allocator{ &allocator } {}
+
+    CurenDescriptorWriter::CurenDescriptorWriter(CurenDescriptorSetLayout& setLayout, CurenDescriptorCache& cache)
+        : setLayout{ setLayout }, cache{ &cache } {}
 
     CurenDescriptorWriter& CurenDescriptorWriter::writeBuffer(
         uint32_t binding, VkDescriptorBufferInfo* bufferInfo) {
@@ -177,8 +525,15 @@ namespace Curen {
     }
 
     bool CurenDescriptorWriter::build(VkDescriptorSet& set) {
-        bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
-        if (!success) {
+        assert(!setLayout.isPushDescriptor() && "Push descriptor layouts have no sets, use push");
+        if (cache != nullptr) {
+            set = cache->getSet(setLayout, writes);
+            return true;
+        }
+        if (allocator != nullptr) {
+            allocator->allocateDescriptor(setLayout, set);
+        }
+        else if (!pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set)) {
             return false;
         }
         overwrite(set);
@@ -189,7 +544,28 @@ namespace Curen {
         for (auto& write : writes) {
             write.dstSet = set;
         }
-        vkUpdateDescriptorSets(pool.m_curenDevice.device(), writes.size(), writes.data(), 0, nullptr);
+        vkUpdateDescriptorSets(setLayout.m_curenDevice.device(), writes.size(), writes.data(), 0, nullptr);
+    }
+
+    void CurenDescriptorWriter::push(
+        VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout pipelineLayout, uint32_t set) {
+        if (setLayout.isPushDescriptor()) {
+            // dstSet is ignored, the descriptors are copied into the command buffer
+            setLayout.m_curenDevice.cmdPushDescriptorSet(
+                commandBuffer,
+                pipelineBindPoint,
+                pipelineLayout,
+                set,
+                static_cast<uint32_t>(writes.size()),
+                writes.data());
+            return;
+        }
+
+        VkDescriptorSet descriptorSet{};
+        if (!build(descriptorSet)) {
+            throw std::runtime_error("failed to allocate descriptor set to push!");
+        }
+        vkCmdBindDescriptorSets(commandBuffer, pipelineBindPoint, pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
     }
 
 }  // namespace Curen
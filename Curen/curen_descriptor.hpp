@@ -2,8 +2,11 @@
 #include "curen_device.hpp"
 
 // std
+#include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace Curen {
@@ -19,27 +22,39 @@ namespace Curen {
                 VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags,
                 uint32_t count = 1);
+            // Sets of the layout are pushed with CurenDescriptorWriter::push instead of allocated. A no-op without
+            // VK_KHR_push_descriptor, push then allocates and binds a regular set.
+            Builder& setPushDescriptor();
             std::unique_ptr<CurenDescriptorSetLayout> build() const;
+            // The device's cached layout with the same bindings, owned by the cache and shared with every other caller
+            CurenDescriptorSetLayout& buildCached() const;
 
         private:
             CurenDevice& CurenDevice;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            VkDescriptorSetLayoutCreateFlags flags = 0;
         };
 
         CurenDescriptorSetLayout(
-            CurenDevice& curenDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+            CurenDevice& curenDevice,
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            VkDescriptorSetLayoutCreateFlags flags = 0);
         ~CurenDescriptorSetLayout();
         CurenDescriptorSetLayout(const CurenDescriptorSetLayout&) = delete;
         CurenDescriptorSetLayout& operator=(const CurenDescriptorSetLayout&) = delete;
 
         VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+        bool isPushDescriptor() const { return flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR; }
 
     private:
         CurenDevice& m_curenDevice;
         VkDescriptorSetLayout descriptorSetLayout;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+        VkDescriptorSetLayoutCreateFlags flags;
 
         friend class CurenDescriptorWriter;
+        friend class CurenDescriptorAllocator;
+        friend class CurenDescriptorCache;
     };
 
     class CurenDescriptorPool {
@@ -81,21 +96,174 @@ namespace Curen {
         VkDescriptorPool descriptorPool;
 
         friend class CurenDescriptorWriter;
+        friend class CurenDescriptorAllocator;
+    };
+
+    // Hands out descriptor sets from a chain of pools that grows on demand, so callers never size pools by hand.
+    // A full pool is followed by a new one with twice the sets, up to MAX_SETS_PER_POOL, and descriptors of
+    // each type in the ratio observed over every set allocated so far. Per frame allocators drop all their sets
+    // at once with resetPools; long lived ones pass VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT and free
+    // sets one by one.
+    class CurenDescriptorAllocator {
+    public:
+        static constexpr uint32_t INITIAL_SETS_PER_POOL = 32;
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        struct Statistics {
+            uint32_t poolCount;
+            // Sets handed out and not yet freed or reset
+            uint32_t setCount;
+            uint32_t maxSetCount;
+        };
+
+        CurenDescriptorAllocator(CurenDevice& curenDevice, VkDescriptorPoolCreateFlags poolFlags = 0);
+        CurenDescriptorAllocator(const CurenDescriptorAllocator&) = delete;
+        CurenDescriptorAllocator& operator=(const CurenDescriptorAllocator&) = delete;
+
+        // Throws only when a new pool sized for the set cannot hold it either
+        void allocateDescriptor(const CurenDescriptorSetLayout& setLayout, VkDescriptorSet& descriptor);
+        // Only with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+        void freeDescriptors(std::vector<VkDescriptorSet>& descriptors);
+        // Every set handed out becomes invalid, the pools are kept and filled again from the first one
+        void resetPools();
+
+        Statistics getStatistics() const;
+
+    private:
+        void createPool(const CurenDescriptorSetLayout& setLayout);
+
+        CurenDevice& m_curenDevice;
+        VkDescriptorPoolCreateFlags m_poolFlags;
+        std::vector<std::unique_ptr<CurenDescriptorPool>> m_pools;
+        std::vector<uint32_t> m_poolMaxSets;
+        size_t m_currentPool = 0;
+
+        // Descriptors of each type over every set allocated so far, the ratios size new pools
+        std::map<VkDescriptorType, uint64_t> m_observedDescriptorCounts;
+        uint64_t m_observedSetCount = 0;
+
+        // Owning pool of every live set, only kept when sets are freed individually
+        std::unordered_map<VkDescriptorSet, size_t> m_setPools;
+        uint32_t m_setCount = 0;
+    };
+
+    // Shares layouts with identical bindings and immutable descriptor sets with identical contents, so repeated
+    // material setup is a hash lookup. Cached sets are written once and never updated; one is freed as soon as a
+    // buffer it points at is destroyed. Image views are part of the key but not tracked, they have to outlive the
+    // sets written with them. Owned by CurenDevice.
+    class CurenDescriptorCache {
+    public:
+        struct Statistics {
+            uint64_t layoutHits;
+            uint64_t layoutMisses;
+            uint64_t setHits;
+            uint64_t setMisses;
+            // Sets freed because a buffer they point at was destroyed
+            uint64_t invalidatedSetCount;
+            uint64_t pipelineLayoutHits;
+            uint64_t pipelineLayoutMisses;
+            uint32_t layoutCount;
+            uint32_t setCount;
+            uint32_t pipelineLayoutCount;
+        };
+
+        CurenDescriptorCache(CurenDevice& curenDevice);
+        ~CurenDescriptorCache();
+        CurenDescriptorCache(const CurenDescriptorCache&) = delete;
+        CurenDescriptorCache& operator=(const CurenDescriptorCache&) = delete;
+
+        CurenDescriptorSetLayout& getLayout(
+            const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0);
+        // Allocates and writes the set on a miss, dstSet of the writes is ignored
+        VkDescriptorSet getSet(const CurenDescriptorSetLayout& setLayout, const std::vector<VkWriteDescriptorSet>& writes);
+        // Owned by the cache, never destroy one. Set layouts from elsewhere have to outlive the cache
+        VkPipelineLayout getPipelineLayout(
+            const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+        // Called by CurenBuffer on destruction, by then no frame in flight may use the buffer or its sets
+        void invalidateBuffer(VkBuffer buffer);
+
+        Statistics getStatistics() const;
+
+    private:
+        struct LayoutKey {
+            // Sorted by binding
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            VkDescriptorSetLayoutCreateFlags flags;
+            bool operator==(const LayoutKey& other) const;
+        };
+
+        struct DescriptorKey {
+            uint32_t binding;
+            uint32_t arrayElement;
+            VkDescriptorType descriptorType;
+            VkBuffer buffer;
+            VkDeviceSize offset;
+            VkDeviceSize range;
+            VkSampler sampler;
+            VkImageView imageView;
+            VkImageLayout imageLayout;
+            bool operator==(const DescriptorKey& other) const;
+        };
+
+        struct SetKey {
+            VkDescriptorSetLayout setLayout;
+            // Sorted by binding and array element
+            std::vector<DescriptorKey> descriptors;
+            bool operator==(const SetKey& other) const;
+        };
+
+        struct PipelineLayoutKey {
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            // Sorted by offset
+            std::vector<VkPushConstantRange> pushConstantRanges;
+            bool operator==(const PipelineLayoutKey& other) const;
+        };
+
+        struct KeyHash {
+            size_t operator()(const LayoutKey& key) const;
+            size_t operator()(const SetKey& key) const;
+            size_t operator()(const PipelineLayoutKey& key) const;
+        };
+
+        CurenDevice& m_curenDevice;
+        mutable std::mutex m_mutex;
+
+        std::unordered_map<LayoutKey, std::unique_ptr<CurenDescriptorSetLayout>, KeyHash> m_layouts;
+
+        CurenDescriptorAllocator m_setAllocator;
+        std::unordered_map<SetKey, VkDescriptorSet, KeyHash> m_sets;
+        // Key of every cached set, pointing into m_sets
+        std::unordered_map<VkDescriptorSet, const SetKey*> m_setKeys;
+        // Cached sets pointing at each buffer
+        std::unordered_map<VkBuffer, std::unordered_set<VkDescriptorSet>> m_bufferSets;
+
+        std::unordered_map<PipelineLayoutKey, VkPipelineLayout, KeyHash> m_pipelineLayouts;
+
+        Statistics m_statistics{};
     };
 
     class CurenDescriptorWriter {
     public:
         CurenDescriptorWriter(CurenDescriptorSetLayout& setLayout, CurenDescriptorPool& pool);
+        CurenDescriptorWriter(CurenDescriptorSetLayout& setLayout, CurenDescriptorAllocator& allocator);
+        // build looks the contents up in the cache and only writes a new set on a miss, never overwrite such a set
+        CurenDescriptorWriter(CurenDescriptorSetLayout& setLayout, CurenDescriptorCache& cache);
 
         CurenDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         CurenDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
 
         bool build(VkDescriptorSet& set);
         void overwrite(VkDescriptorSet& set);
+        // Records the writes into the command buffer for a push descriptor layout. Any other layout gets a set
+        // built from the writer's pool, allocator or cache and bound instead, so callers need no second path.
+        void push(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout pipelineLayout, uint32_t set);
 
     private:
         CurenDescriptorSetLayout& setLayout;
-        CurenDescriptorPool& pool;
+        // Exactly one of them is set
+        CurenDescriptorPool* pool = nullptr;
+        CurenDescriptorAllocator* allocator = nullptr;
+        CurenDescriptorCache* cache = nullptr;
         std::vector<VkWriteDescriptorSet> writes;
     };
 
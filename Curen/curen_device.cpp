@@ -1,7 +1,12 @@
 #include "curen_device.hpp"
+#include "curen_upload_manager.hpp"
+#include "curen_descriptor.hpp"
+#include "curen_pipeline_compiler.hpp"
 
 // std headers
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -48,16 +53,31 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-CurenDevice::CurenDevice(CurenWindow& window) : window{ window } {
+CurenDevice::CurenDevice(CurenWindow& window, bool isVerbose) : window{ window }, isVerbose_{ isVerbose } {
     createInstance();
     setupDebugMessenger();
     createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    createPipelineCache();
+    memoryAllocator_ = std::make_unique<CurenMemoryAllocator>(physicalDevice, device_, properties);
+    // Before any CurenBuffer, every buffer reports its destruction to the cache
+    descriptorCache_ = std::make_unique<CurenDescriptorCache>(*this);
+    uploadManager_ = std::make_unique<CurenUploadManager>(*this);
+    pipelineCompiler_ = std::make_unique<CurenPipelineCompiler>(*this);
+    updateMemoryBudget();
 }
 
 CurenDevice::~CurenDevice() {
+    // Compiles still running write into the pipeline cache
+    pipelineCompiler_.reset();
+    uploadManager_.reset();
+    descriptorCache_.reset();
+    memoryAllocator_.reset();
+    savePipelineCache();
+    vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+    vkDestroyCommandPool(device_, transferCommandPool, nullptr);
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
 
@@ -87,6 +107,18 @@ void CurenDevice::createInstance() {
     createInfo.pApplicationInfo = &appInfo;
 
     auto extensions = getRequiredExtensions();
+    // Optional, VK_EXT_memory_budget and VK_EXT_descriptor_indexing are queried through it
+    uint32_t availableCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(availableCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, availableExtensions.data());
+    bool hasProperties2 = false;
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+            extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+            hasProperties2 = true;
+        }
+    }
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -108,6 +140,18 @@ void CurenDevice::createInstance() {
     }
 
     hasGflwRequiredInstanceExtensions();
+
+    if (hasProperties2) {
+        getMemoryProperties2_ = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+            instance,
+            "vkGetPhysicalDeviceMemoryProperties2KHR");
+        getFeatures2_ = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+            instance,
+            "vkGetPhysicalDeviceFeatures2KHR");
+        getProperties2_ = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+            instance,
+            "vkGetPhysicalDeviceProperties2KHR");
+    }
 }
 
 void CurenDevice::pickPhysicalDevice() {
@@ -140,7 +184,7 @@ void CurenDevice::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.transferFamily };
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -161,9 +205,61 @@ void CurenDevice::createLogicalDevice() {
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+    std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    isMemoryBudgetSupported_ = getMemoryProperties2_ != nullptr &&
+        isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (isMemoryBudgetSupported_) {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // Bindless needs runtime sized arrays that are partially bound and written while other frames are in flight
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    if (getFeatures2_ != nullptr && getProperties2_ != nullptr &&
+        isDeviceExtensionSupported(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+        isDeviceExtensionSupported(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &descriptorIndexingFeatures;
+        getFeatures2_(physicalDevice, &features2);
+        isBindlessSupported_ = descriptorIndexingFeatures.runtimeDescriptorArray &&
+            descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+            descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+            descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+            descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+    }
+    // Depends on the properties2 instance extension, which getFeatures2_ was loaded from
+    bool hasPushDescriptor = getFeatures2_ != nullptr &&
+        isDeviceExtensionSupported(physicalDevice, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+    if (hasPushDescriptor) {
+        enabledExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures{};
+    if (isBindlessSupported_) {
+        enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        enabledIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabledIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+        enabledIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing = descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+        createInfo.pNext = &enabledIndexingFeatures;
+
+        descriptorIndexingProperties_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &descriptorIndexingProperties_;
+        getProperties2_(physicalDevice, &properties2);
+        descriptorIndexingProperties_.pNext = nullptr;
+    }
+
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // might not really be necessary anymore because device specific validation layers
     // have been deprecated
@@ -181,6 +277,16 @@ void CurenDevice::createLogicalDevice() {
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+    if (hasPushDescriptor) {
+        cmdPushDescriptorSet_ = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device_, "vkCmdPushDescriptorSetKHR");
+    }
+    if (isVerbose_) {
+        std::cout << "transfer queue family: " << indices.transferFamily
+                  << (indices.hasDedicatedTransferFamily() ? " (dedicated)" : " (shared with graphics)") << std::endl;
+        std::cout << "bindless descriptors: " << (isBindlessSupported_ ? "supported" : "unsupported") << std::endl;
+        std::cout << "push descriptors: " << (isPushDescriptorSupported() ? "supported" : "unsupported") << std::endl;
+    }
 }
 
 void CurenDevice::createCommandPool() {
@@ -195,6 +301,88 @@ void CurenDevice::createCommandPool() {
     if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
+
+    poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+}
+
+void CurenDevice::createPipelineCache() {
+    std::vector<char> data{};
+    std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        if (!file.good() || !isPipelineCacheCompatible(data)) {
+            std::cout << "pipeline cache: " << PIPELINE_CACHE_PATH << " is stale, starting cold" << std::endl;
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+        // A driver may still reject data that passed the header check, starting empty is always allowed
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        data.clear();
+        if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+    isPipelineCacheWarm_ = !data.empty();
+    if (isVerbose_) {
+        std::cout << "pipeline cache: " << (isPipelineCacheWarm_ ? "warm, " : "cold, ") << data.size() / 1024 << " KB loaded" << std::endl;
+    }
+}
+
+bool CurenDevice::isPipelineCacheCompatible(const std::vector<char> &data) {
+    // VkPipelineCacheHeaderVersionOne: header size, header version, vendor id, device id, pipeline cache UUID.
+    // Drivers are meant to reject foreign data themselves, not all of them do it gracefully.
+    constexpr size_t HEADER_SIZE = 16 + VK_UUID_SIZE;
+    if (data.size() < HEADER_SIZE) {
+        return false;
+    }
+    uint32_t header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+    return header[0] >= HEADER_SIZE &&
+        header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header[2] == properties.vendorID &&
+        header[3] == properties.deviceID &&
+        std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void CurenDevice::savePipelineCache() {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Through a temporary file, so a crash while saving never leaves a truncated cache behind
+    std::string tempPath = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(data.data(), dataSize);
+        if (!file.good()) {
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, PIPELINE_CACHE_PATH, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+    }
 }
 
 void CurenDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -332,6 +520,21 @@ bool CurenDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+bool CurenDevice::isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 QueueFamilyIndices CurenDevice::findQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices indices;
 
@@ -360,6 +563,23 @@ QueueFamilyIndices CurenDevice::findQueueFamilies(VkPhysicalDevice device) {
         i++;
     }
 
+    // Prefer a family without graphics or compute, that is usually the copy engine and runs beside rendering.
+    // Any transfer capable family other than graphics is still better than sharing the graphics queue.
+    indices.transferFamily = indices.graphicsFamily;
+    int transferScore = 0;
+    for (uint32_t family = 0; indices.graphicsFamilyHasValue && family < queueFamilyCount; family++) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (family == indices.graphicsFamily || queueFamilies[family].queueCount == 0 ||
+            (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+        if (score > transferScore) {
+            indices.transferFamily = family;
+            transferScore = score;
+        }
+    }
+
     return indices;
 }
 
@@ -424,7 +644,8 @@ void CurenDevice::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer& buffer,
-    VkDeviceMemory& bufferMemory) {
+    CurenMemoryAllocator::Allocation& bufferAllocation,
+    VkMemoryPropertyFlags preferredProperties) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -438,16 +659,16 @@ void CurenDevice::createBuffer(
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+    try {
+        bufferAllocation = memoryAllocator_->allocate(memRequirements, properties, CurenMemoryAllocator::ResourceKind::Linear,
+            CurenMemoryAllocator::getBufferCategory(usage), preferredProperties);
+    }
+    catch (...) {
+        vkDestroyBuffer(device_, buffer, nullptr);
+        throw;
     }
 
-    vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    vkBindBufferMemory(device_, buffer, bufferAllocation.memory, bufferAllocation.offset);
 }
 
 VkCommandBuffer CurenDevice::beginSingleTimeCommands() {
@@ -482,12 +703,12 @@ void CurenDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void CurenDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+void CurenDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
     VkBufferCopy copyRegion{};
     copyRegion.srcOffset = 0;  // Optional
-    copyRegion.dstOffset = 0;  // Optional
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -525,7 +746,7 @@ void CurenDevice::createImageWithInfo(
     const VkImageCreateInfo& imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage& image,
-    VkDeviceMemory& imageMemory) {
+    CurenMemoryAllocator::Allocation& imageAllocation) {
     if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
     }
@@ -533,16 +754,78 @@ void CurenDevice::createImageWithInfo(
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
+    CurenMemoryAllocator::ResourceKind resourceKind = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ?
+        CurenMemoryAllocator::ResourceKind::Optimal : CurenMemoryAllocator::ResourceKind::Linear;
+    try {
+        imageAllocation = memoryAllocator_->allocate(
+            memRequirements, properties, resourceKind, CurenMemoryAllocator::getImageCategory(imageInfo.usage));
+    }
+    catch (...) {
+        vkDestroyImage(device_, image, nullptr);
+        throw;
     }
 
-    if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+    if (vkBindImageMemory(device_, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
         throw std::runtime_error("failed to bind image memory!");
     }
 }
+
+void CurenDevice::updateMemoryBudget() {
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = memoryAllocator_->getMemoryProperties();
+    auto heapStatistics = memoryAllocator_->getHeapStatistics();
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    if (isMemoryBudgetSupported_) {
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties2.pNext = &budgetProperties;
+        getMemoryProperties2_(physicalDevice, &memoryProperties2);
+    }
+
+    memoryBudget_.heaps.resize(memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        MemoryBudget::Heap& heap = memoryBudget_.heaps[i];
+        heap.size = memoryProperties.memoryHeaps[i].size;
+        heap.reservedSize = heapStatistics[i].reservedSize;
+        heap.isDeviceLocal = memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        if (isMemoryBudgetSupported_) {
+            heap.budget = budgetProperties.heapBudget[i];
+            heap.usage = budgetProperties.heapUsage[i];
+        }
+        else {
+            // Without the driver's numbers only Curen's own use is known, keep headroom for everything else
+            heap.budget = heap.size / 10 * 8;
+            heap.usage = heap.reservedSize;
+        }
+    }
+    memoryBudget_.categorySizes = memoryAllocator_->getCategorySizes();
+    memoryBudget_.isDriverBudget = isMemoryBudgetSupported_;
+}
+
+void CurenDevice::printMemoryReport() const {
+    std::cout << "memory budget (" << (memoryBudget_.isDriverBudget ? "VK_EXT_memory_budget" : "estimated") << "):" << std::endl;
+    for (size_t i = 0; i < memoryBudget_.heaps.size(); i++) {
+        const MemoryBudget::Heap& heap = memoryBudget_.heaps[i];
+        std::cout << "\theap " << i << (heap.isDeviceLocal ? " (device local)" : "") << ": " << heap.usage / (1024 * 1024) << "/"
+                  << heap.budget / (1024 * 1024) << " MB of budget used, " << heap.reservedSize / (1024 * 1024) << " MB reserved by Curen, "
+                  << heap.size / (1024 * 1024) << " MB heap" << std::endl;
+    }
+    std::cout << "\t";
+    for (uint32_t i = 0; i < CurenMemoryAllocator::MEMORY_CATEGORY_COUNT; i++) {
+        std::cout << (i > 0 ? ", " : "") << CurenMemoryAllocator::getCategoryName(static_cast<CurenMemoryAllocator::MemoryCategory>(i)) << " "
+                  << memoryBudget_.categorySizes[i] / 1024 << " KB";
+    }
+    std::cout << std::endl;
+}
+
+bool MemoryBudget::hasRoomFor(VkDeviceSize size) const {
+    // The largest device local heap is where geometry and textures go, not the small BAR heap
+    const Heap* mainHeap = nullptr;
+    for (const auto& heap : heaps) {
+        if (heap.isDeviceLocal && (mainHeap == nullptr || heap.size > mainHeap->size)) {
+            mainHeap = &heap;
+        }
+    }
+    return mainHeap == nullptr || mainHeap->usage + size <= mainHeap->budget;
+}
@@ -1,14 +1,21 @@
 #pragma once
 
 #include "curen_window.hpp"
+#include "curen_memory_allocator.hpp"
 
 // std lib headers
+#include <array>
+#include <memory>
 #include <string>
 #include <vector>
 
 
 namespace Curen {
 
+    class CurenUploadManager;
+    class CurenDescriptorCache;
+    class CurenPipelineCompiler;
+
     struct SwapChainSupportDetails {
       VkSurfaceCapabilitiesKHR capabilities;
       std::vector<VkSurfaceFormatKHR> formats;
@@ -18,11 +25,34 @@ namespace Curen {
     struct QueueFamilyIndices {
       uint32_t graphicsFamily;
       uint32_t presentFamily;
+      // A transfer-only family when the device has one, the graphics family otherwise
+      uint32_t transferFamily;
       bool graphicsFamilyHasValue = false;
       bool presentFamilyHasValue = false;
+      bool hasDedicatedTransferFamily() { return transferFamily != graphicsFamily; }
       bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    // Snapshot of device memory use, refreshed once per frame by CurenDevice::updateMemoryBudget
+    struct MemoryBudget {
+      struct Heap {
+        VkDeviceSize size;
+        // What the process may use before the driver starts paging, from VK_EXT_memory_budget when available
+        VkDeviceSize budget;
+        VkDeviceSize usage;
+        // Blocks and dedicated allocations of Curen's own allocator
+        VkDeviceSize reservedSize;
+        bool isDeviceLocal;
+      };
+      std::vector<Heap> heaps;
+      std::array<VkDeviceSize, CurenMemoryAllocator::MEMORY_CATEGORY_COUNT> categorySizes;
+      // False when the budget is estimated from the heap sizes
+      bool isDriverBudget;
+
+      // Whether size more bytes fit into the largest device local heap
+      bool hasRoomFor(VkDeviceSize size) const;
+    };
+
     class CurenDevice {
      public:
     #ifdef NDEBUG
@@ -30,8 +60,11 @@ namespace Curen {
     #else
       const bool enableValidationLayers = true;
     #endif
+      // Relative to the working directory, like the shaders
+      static constexpr const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
 
-      CurenDevice(CurenWindow &window);
+      // isVerbose prints the queue families, descriptor features and pipeline cache state picked at startup
+      CurenDevice(CurenWindow &window, bool isVerbose = false);
       ~CurenDevice();
 
       // Not copyable or movable
@@ -41,10 +74,46 @@ namespace Curen {
       CurenDevice &operator=(CurenDevice &&) = delete;
 
       VkCommandPool getCommandPool() { return commandPool; }
+      // Loaded from PIPELINE_CACHE_PATH when it was written by the same driver and device, saved on destruction
+      VkPipelineCache pipelineCache() { return pipelineCache_; }
+      bool isPipelineCacheWarm() const { return isPipelineCacheWarm_; }
+      // Command buffers from it may only be submitted to transferQueue()
+      VkCommandPool getTransferCommandPool() { return transferCommandPool; }
       VkDevice device() { return device_; }
       VkSurfaceKHR surface() { return surface_; }
       VkQueue graphicsQueue() { return graphicsQueue_; }
       VkQueue presentQueue() { return presentQueue_; }
+      // Same as graphicsQueue() when the device has no separate transfer family
+      VkQueue transferQueue() { return transferQueue_; }
+      CurenMemoryAllocator &memoryAllocator() { return *memoryAllocator_; }
+      // Staged, batched uploads; prefer it over copyBuffer, which waits for the queue to go idle per copy
+      CurenUploadManager &uploadManager() { return *uploadManager_; }
+      // Shared layouts and immutable descriptor sets
+      CurenDescriptorCache &descriptorCache() { return *descriptorCache_; }
+      // Background pipeline creation through pipelineCache()
+      CurenPipelineCompiler &pipelineCompiler() { return *pipelineCompiler_; }
+
+      // Queries the driver budget and the allocator's category sizes, call once per frame
+      void updateMemoryBudget();
+      const MemoryBudget &memoryBudget() const { return memoryBudget_; }
+      void printMemoryReport() const;
+
+      // Descriptor indexing with update after bind for storage buffers, sampled images and samplers, see CurenBindlessTable
+      bool isBindlessSupported() const { return isBindlessSupported_; }
+      // Only filled in when bindless is supported
+      const VkPhysicalDeviceDescriptorIndexingPropertiesEXT &descriptorIndexingProperties() const { return descriptorIndexingProperties_; }
+
+      // VK_KHR_push_descriptor, CurenDescriptorSetLayout::Builder::setPushDescriptor falls back to regular sets without it
+      bool isPushDescriptorSupported() const { return cmdPushDescriptorSet_ != nullptr; }
+      void cmdPushDescriptorSet(
+          VkCommandBuffer commandBuffer,
+          VkPipelineBindPoint pipelineBindPoint,
+          VkPipelineLayout layout,
+          uint32_t set,
+          uint32_t writeCount,
+          const VkWriteDescriptorSet *writes) {
+        cmdPushDescriptorSet_(commandBuffer, pipelineBindPoint, layout, set, writeCount, writes);
+      }
 
       SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
       uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -52,16 +121,17 @@ namespace Curen {
       VkFormat findSupportedFormat(
           const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-      // Buffer Helper Functions
+      // Buffer Helper Functions, the memory is sub-allocated and goes back through memoryAllocator().free
       void createBuffer(
           VkDeviceSize size,
           VkBufferUsageFlags usage,
           VkMemoryPropertyFlags properties,
           VkBuffer &buffer,
-          VkDeviceMemory &bufferMemory);
+          CurenMemoryAllocator::Allocation &bufferAllocation,
+          VkMemoryPropertyFlags preferredProperties = 0);
       VkCommandBuffer beginSingleTimeCommands();
       void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-      void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+      void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
       void copyBufferToImage(
           VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -69,7 +139,7 @@ namespace Curen {
           const VkImageCreateInfo &imageInfo,
           VkMemoryPropertyFlags properties,
           VkImage &image,
-          VkDeviceMemory &imageMemory);
+          CurenMemoryAllocator::Allocation &imageAllocation);
 
       VkPhysicalDeviceProperties properties;
 
@@ -80,6 +150,9 @@ namespace Curen {
       void pickPhysicalDevice();
       void createLogicalDevice();
       void createCommandPool();
+      void createPipelineCache();
+      void savePipelineCache();
+      bool isPipelineCacheCompatible(const std::vector<char> &data);
 
       // helper functions
       bool isDeviceSuitable(VkPhysicalDevice device);
@@ -87,6 +160,7 @@ namespace Curen {
       std::vector<const char *> getRequiredExtensions();
       bool checkValidationLayerSupport();
       QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+      bool isDeviceExtensionSupported(VkPhysicalDevice device, const char *extensionName);
       void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
       void hasGflwRequiredInstanceExtensions();
       bool checkDeviceExtensionSupport(VkPhysicalDevice device);
@@ -97,11 +171,28 @@ namespace Curen {
       VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
       CurenWindow &window;
       VkCommandPool commandPool;
+      VkCommandPool transferCommandPool;
 
       VkDevice device_;
       VkSurfaceKHR surface_;
       VkQueue graphicsQueue_;
       VkQueue presentQueue_;
+      VkQueue transferQueue_;
+      std::unique_ptr<CurenMemoryAllocator> memoryAllocator_;
+      std::unique_ptr<CurenDescriptorCache> descriptorCache_;
+      std::unique_ptr<CurenUploadManager> uploadManager_;
+      std::unique_ptr<CurenPipelineCompiler> pipelineCompiler_;
+      PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2_ = nullptr;
+      PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2_ = nullptr;
+      PFN_vkGetPhysicalDeviceProperties2KHR getProperties2_ = nullptr;
+      bool isMemoryBudgetSupported_ = false;
+      bool isBindlessSupported_ = false;
+      PFN_vkCmdPushDescriptorSetKHR cmdPushDescriptorSet_ = nullptr;
+      VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties_{};
+      MemoryBudget memoryBudget_{};
+      VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+      bool isPipelineCacheWarm_ = false;
+      bool isVerbose_;
 
       const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
       const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -0,0 +1,44 @@
+#include "curen_frame_allocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace Curen;
+
+CurenFrameAllocator::CurenFrameAllocator(CurenDevice& curenDevice, VkDeviceSize frameCapacity)
+{
+	const VkPhysicalDeviceLimits& limits = curenDevice.properties.limits;
+	m_alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+	m_frameCapacity = (frameCapacity + m_alignment - 1) / m_alignment * m_alignment;
+
+	// A dynamic offset near the end of the last region still has to leave room for the whole descriptor range
+	VkDeviceSize tailPadding = std::min<VkDeviceSize>(limits.maxUniformBufferRange, m_frameCapacity);
+	m_buffer = std::make_unique<CurenBuffer>(
+		curenDevice,
+		m_frameCapacity * CurenSwapChain::MAX_FRAMES_IN_FLIGHT + tailPadding,
+		1,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (m_buffer->map() != VK_SUCCESS) {
+		throw std::runtime_error("failed to map frame allocator buffer!");
+	}
+	m_mappedData = static_cast<char*>(m_buffer->getMappedMemory());
+}
+
+void CurenFrameAllocator::beginFrame(int frameIndex)
+{
+	m_frameStart = m_frameCapacity * frameIndex;
+	m_head = m_frameStart;
+}
+
+CurenFrameAllocator::Allocation CurenFrameAllocator::allocate(VkDeviceSize size)
+{
+	VkDeviceSize offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+	if (offset + size > m_frameStart + m_frameCapacity) {
+		throw std::runtime_error("frame allocator is out of memory: " + std::to_string(size) + " bytes requested, " +
+			std::to_string(m_frameStart + m_frameCapacity - m_head) + " left of " + std::to_string(m_frameCapacity));
+	}
+	m_head = offset + size;
+	return Allocation{ m_mappedData + offset, static_cast<uint32_t>(offset) };
+}
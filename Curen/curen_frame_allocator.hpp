@@ -0,0 +1,61 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_buffer.hpp"
+#include "curen_swap_chain.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace Curen {
+
+	// Persistently mapped ring of one region per frame in flight for data that only lives for a frame. Systems push
+	// their uniforms or storage data and bind the returned offset as the dynamic offset of a descriptor set written
+	// once with descriptorInfo. CurenRenderer resets a region after waiting on its frame's fence, so steady state
+	// frames allocate nothing.
+	class CurenFrameAllocator {
+	public:
+		static constexpr VkDeviceSize DEFAULT_FRAME_CAPACITY = 1024 * 1024;
+
+		struct Allocation {
+			void* data;
+			// Offset into the whole buffer, usable as a dynamic offset
+			uint32_t offset;
+		};
+
+		CurenFrameAllocator(CurenDevice& curenDevice, VkDeviceSize frameCapacity = DEFAULT_FRAME_CAPACITY);
+
+		CurenFrameAllocator(const CurenFrameAllocator&) = delete;
+		CurenFrameAllocator& operator = (const CurenFrameAllocator&) = delete;
+
+		// Only once the fence of frameIndex has been waited on
+		void beginFrame(int frameIndex);
+
+		// Aligned for dynamic uniform and storage buffer offsets, throws when the frame region is full
+		Allocation allocate(VkDeviceSize size);
+
+		template <typename T>
+		uint32_t push(const T& data) {
+			Allocation allocation = allocate(sizeof(T));
+			std::memcpy(allocation.data, &data, sizeof(T));
+			return allocation.offset;
+		}
+
+		// range is the size the shader sees behind every dynamic offset
+		VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) { return m_buffer->descriptorInfo(range, 0); }
+
+		VkDeviceSize getFrameCapacity() const { return m_frameCapacity; }
+		// Bytes handed out in the current frame, including alignment padding
+		VkDeviceSize getFrameUsage() const { return m_head - m_frameStart; }
+
+	private:
+		std::unique_ptr<CurenBuffer> m_buffer;
+		char* m_mappedData;
+		VkDeviceSize m_alignment;
+		VkDeviceSize m_frameCapacity;
+
+		VkDeviceSize m_frameStart = 0;
+		VkDeviceSize m_head = 0;
+	};
+}
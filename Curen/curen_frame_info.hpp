@@ -1,6 +1,8 @@
 #pragma once
 
 #include "curen_camera.hpp"
+#include "curen_descriptor.hpp"
+#include "curen_frame_allocator.hpp"
 
 #include <vulkan/vulkan.h>
 
@@ -12,5 +14,12 @@ namespace Curen {
 		CurenCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		CurenObject::Map& objects;
+		float viewportHeight;
+		// Dynamic offset of the global uniforms in the renderer's frame allocator
+		uint32_t globalUboOffset;
+		// Sets that only live for this frame, reset by the renderer once the frame's fence has signaled
+		CurenDescriptorAllocator& frameDescriptorAllocator;
+		// The renderer's transient per frame data, the same region globalUboOffset points into
+		CurenFrameAllocator& frameAllocator;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "curen_free_list_allocator.hpp"
+
+#include <cassert>
+#include <iterator>
+
+using namespace Curen;
+
+CurenFreeListAllocator::CurenFreeListAllocator(VkDeviceSize capacity) : m_capacity{ capacity }
+{
+	if (m_capacity > 0) {
+		insertFreeBlock(0, m_capacity);
+	}
+}
+
+VkDeviceSize CurenFreeListAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	VkDeviceSize offset = 0;
+	auto block = findBlock(size, alignment, offset);
+	if (block == m_freeBySize.end()) {
+		return INVALID_OFFSET;
+	}
+
+	VkDeviceSize blockOffset = block->second;
+	VkDeviceSize blockSize = block->first;
+	eraseFreeBlock(m_freeByOffset.find(blockOffset));
+	if (offset > blockOffset) {
+		insertFreeBlock(blockOffset, offset - blockOffset);
+	}
+	if (offset + size < blockOffset + blockSize) {
+		insertFreeBlock(offset + size, blockOffset + blockSize - offset - size);
+	}
+
+	m_usedSize += size;
+	m_allocationCount++;
+	return offset;
+}
+
+bool CurenFreeListAllocator::canAllocate(VkDeviceSize size, VkDeviceSize alignment) const
+{
+	VkDeviceSize offset = 0;
+	return findBlock(size, alignment, offset) != m_freeBySize.end();
+}
+
+std::set<std::pair<VkDeviceSize, VkDeviceSize>>::const_iterator CurenFreeListAllocator::findBlock(VkDeviceSize size, VkDeviceSize alignment,
+	VkDeviceSize& offset) const
+{
+	if (size == 0 || alignment == 0) {
+		return m_freeBySize.end();
+	}
+
+	// Smallest blocks first, a block may still be too small once its start is aligned
+	for (auto candidate = m_freeBySize.lower_bound({ size, 0 }); candidate != m_freeBySize.end(); ++candidate) {
+		VkDeviceSize blockOffset = candidate->second;
+		VkDeviceSize blockSize = candidate->first;
+		offset = (blockOffset + alignment - 1) / alignment * alignment;
+		if (offset + size <= blockOffset + blockSize) {
+			return candidate;
+		}
+	}
+	return m_freeBySize.end();
+}
+
+void CurenFreeListAllocator::free(VkDeviceSize offset, VkDeviceSize size)
+{
+	assert(offset + size <= m_capacity && "Freed range is outside of the allocator.");
+	assert(m_allocationCount > 0 && "Freed more ranges than were allocated.");
+	m_usedSize -= size;
+	m_allocationCount--;
+
+	auto next = m_freeByOffset.lower_bound(offset);
+	if (next != m_freeByOffset.end() && next->first == offset + size) {
+		size += next->second;
+		next = std::next(next);
+		eraseFreeBlock(std::prev(next));
+	}
+	if (next != m_freeByOffset.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			size += previous->second;
+			eraseFreeBlock(previous);
+		}
+	}
+	insertFreeBlock(offset, size);
+}
+
+CurenFreeListAllocator::Statistics CurenFreeListAllocator::getStatistics() const
+{
+	Statistics statistics{};
+	statistics.capacity = m_capacity;
+	statistics.usedSize = m_usedSize;
+	statistics.largestFreeBlock = m_freeBySize.empty() ? 0 : std::prev(m_freeBySize.end())->first;
+	statistics.allocationCount = m_allocationCount;
+	statistics.freeBlockCount = static_cast<uint32_t>(m_freeByOffset.size());
+
+	VkDeviceSize freeSize = m_capacity - m_usedSize;
+	statistics.fragmentation = freeSize > 0 ? 1.f - static_cast<float>(statistics.largestFreeBlock) / static_cast<float>(freeSize) : 0.f;
+	return statistics;
+}
+
+void CurenFreeListAllocator::insertFreeBlock(VkDeviceSize offset, VkDeviceSize size)
+{
+	m_freeByOffset.emplace(offset, size);
+	m_freeBySize.emplace(size, offset);
+}
+
+void CurenFreeListAllocator::eraseFreeBlock(std::map<VkDeviceSize, VkDeviceSize>::iterator block)
+{
+	m_freeBySize.erase({ block->second, block->first });
+	m_freeByOffset.erase(block);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace Curen {
+
+	// Best fit sub-allocator over a linear range, freed neighbours are merged back into one block.
+	// Only does the bookkeeping, the memory itself belongs to the owner.
+	class CurenFreeListAllocator {
+	public:
+		static constexpr VkDeviceSize INVALID_OFFSET = ~static_cast<VkDeviceSize>(0);
+
+		struct Statistics {
+			VkDeviceSize capacity;
+			VkDeviceSize usedSize;
+			VkDeviceSize largestFreeBlock;
+			uint32_t allocationCount;
+			uint32_t freeBlockCount;
+			// 0 when all free space is one block, close to 1 when it is scattered into small pieces
+			float fragmentation;
+		};
+
+		explicit CurenFreeListAllocator(VkDeviceSize capacity);
+
+		CurenFreeListAllocator(const CurenFreeListAllocator&) = delete;
+		CurenFreeListAllocator& operator = (const CurenFreeListAllocator&) = delete;
+
+		// The alignment does not need to be a power of two. Returns INVALID_OFFSET when no free block fits.
+		VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment = 1);
+		// Whether allocate would succeed, without taking the range
+		bool canAllocate(VkDeviceSize size, VkDeviceSize alignment = 1) const;
+		// Takes back exactly the range allocate returned
+		void free(VkDeviceSize offset, VkDeviceSize size);
+
+		Statistics getStatistics() const;
+
+	private:
+		// The best fitting free block and the aligned offset in it, m_freeBySize.end() when none fits
+		std::set<std::pair<VkDeviceSize, VkDeviceSize>>::const_iterator findBlock(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) const;
+		void insertFreeBlock(VkDeviceSize offset, VkDeviceSize size);
+		void eraseFreeBlock(std::map<VkDeviceSize, VkDeviceSize>::iterator block);
+
+		VkDeviceSize m_capacity;
+		VkDeviceSize m_usedSize = 0;
+		uint32_t m_allocationCount = 0;
+
+		// offset -> size, and (size, offset) pairs for the best fit search
+		std::map<VkDeviceSize, VkDeviceSize> m_freeByOffset;
+		std::set<std::pair<VkDeviceSize, VkDeviceSize>> m_freeBySize;
+	};
+}
@@ -0,0 +1,108 @@
+#include "curen_geometry_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace Curen;
+
+CurenGeometryArena::CurenGeometryArena(CurenDevice& curenDevice, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity) :
+	m_curenDevice{ curenDevice }, m_vertexAllocator{ vertexCapacity }, m_indexAllocator{ indexCapacity }
+{
+	m_indexAlignment = std::max<VkDeviceSize>(sizeof(uint32_t), m_curenDevice.properties.limits.minStorageBufferOffsetAlignment);
+
+	m_vertexBuffer = std::make_unique<CurenBuffer>(m_curenDevice, vertexCapacity, 1, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// Storage usage lets the meshlet culling pass read the indices in place
+	m_indexBuffer = std::make_unique<CurenBuffer>(m_curenDevice, indexCapacity, 1,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+CurenGeometryArena::~CurenGeometryArena()
+{
+}
+
+CurenGeometryArena::Range CurenGeometryArena::allocateVertices(uint32_t vertexSize, uint32_t vertexCount)
+{
+	Range range{};
+	range.size = static_cast<VkDeviceSize>(vertexSize) * vertexCount;
+	range.offset = m_vertexAllocator.allocate(range.size, vertexSize);
+	if (range.offset == CurenFreeListAllocator::INVALID_OFFSET) {
+		auto statistics = m_vertexAllocator.getStatistics();
+		throw std::runtime_error("geometry arena is out of vertex memory: " + std::to_string(range.size) + " bytes requested, " +
+			std::to_string(statistics.capacity - statistics.usedSize) + " free, largest block " + std::to_string(statistics.largestFreeBlock));
+	}
+	return range;
+}
+
+CurenGeometryArena::Range CurenGeometryArena::allocateIndices(uint32_t indexCount)
+{
+	Range range{};
+	range.size = static_cast<VkDeviceSize>(sizeof(uint32_t)) * indexCount;
+	range.offset = m_indexAllocator.allocate(range.size, m_indexAlignment);
+	if (range.offset == CurenFreeListAllocator::INVALID_OFFSET) {
+		auto statistics = m_indexAllocator.getStatistics();
+		throw std::runtime_error("geometry arena is out of index memory: " + std::to_string(range.size) + " bytes requested, " +
+			std::to_string(statistics.capacity - statistics.usedSize) + " free, largest block " + std::to_string(statistics.largestFreeBlock));
+	}
+	return range;
+}
+
+void CurenGeometryArena::freeVertices(const Range& range)
+{
+	if (range.size > 0) {
+		m_vertexAllocator.free(range.offset, range.size);
+	}
+}
+
+void CurenGeometryArena::freeIndices(const Range& range)
+{
+	if (range.size > 0) {
+		m_indexAllocator.free(range.offset, range.size);
+	}
+}
+
+bool CurenGeometryArena::hasRoomFor(uint32_t vertexSize, uint32_t vertexCount, uint32_t indexCount) const
+{
+	if (!m_vertexAllocator.canAllocate(static_cast<VkDeviceSize>(vertexSize) * vertexCount, vertexSize)) {
+		return false;
+	}
+	return indexCount == 0 || m_indexAllocator.canAllocate(static_cast<VkDeviceSize>(sizeof(uint32_t)) * indexCount, m_indexAlignment);
+}
+
+void CurenGeometryArena::uploadVertices(const Range& range, const void* data, CurenUploadBatch* uploadBatch)
+{
+	upload(*m_vertexBuffer, range, data, uploadBatch);
+}
+
+void CurenGeometryArena::uploadIndices(const Range& range, const uint32_t* indices, CurenUploadBatch* uploadBatch)
+{
+	upload(*m_indexBuffer, range, indices, uploadBatch);
+}
+
+void CurenGeometryArena::upload(CurenBuffer& buffer, const Range& range, const void* data, CurenUploadBatch* uploadBatch)
+{
+	if (uploadBatch != nullptr) {
+		uploadBatch->copyToBuffer(buffer.getBuffer(), range.offset, data, range.size);
+		return;
+	}
+
+	CurenUploadBatch localBatch{ m_curenDevice };
+	localBatch.copyToBuffer(buffer.getBuffer(), range.offset, data, range.size);
+	localBatch.submit();
+	localBatch.wait();
+}
+
+void CurenGeometryArena::bind(VkCommandBuffer commandBuffer)
+{
+	VkBuffer buffers[] = { m_vertexBuffer->getBuffer() };
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+VkDescriptorBufferInfo CurenGeometryArena::getIndexBufferInfo(const Range& range) const
+{
+	return m_indexBuffer->descriptorInfo(range.size, range.offset);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_buffer.hpp"
+#include "curen_free_list_allocator.hpp"
+#include "curen_upload_batch.hpp"
+
+#include <cstdint>
+#include <memory>
+
+namespace Curen {
+
+	// One device local vertex buffer and one index buffer shared by every model. Models own ranges of them, so the
+	// whole scene binds its geometry once and draws with vertexOffset and firstIndex.
+	class CurenGeometryArena {
+	public:
+		// Byte range of one of the pools
+		struct Range {
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+		};
+
+		CurenGeometryArena(CurenDevice& curenDevice, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity);
+		~CurenGeometryArena();
+
+		CurenGeometryArena(const CurenGeometryArena&) = delete;
+		CurenGeometryArena& operator = (const CurenGeometryArena&) = delete;
+
+		// Vertex ranges start on a multiple of vertexSize, so offset / vertexSize is the vertexOffset of the draw.
+		// Layouts of different sizes share the pool.
+		Range allocateVertices(uint32_t vertexSize, uint32_t vertexCount);
+		// Index ranges are aligned for storage buffer views as well as index reads
+		Range allocateIndices(uint32_t indexCount);
+		void freeVertices(const Range& range);
+		void freeIndices(const Range& range);
+		// Whether a model of this size can be allocated right now, with the alignment and fragmentation of the pools.
+		// A model without indices only needs vertex memory.
+		bool hasRoomFor(uint32_t vertexSize, uint32_t vertexCount, uint32_t indexCount) const;
+
+		// Recorded into uploadBatch, or submitted and waited on right away without one
+		void uploadVertices(const Range& range, const void* data, CurenUploadBatch* uploadBatch = nullptr);
+		void uploadIndices(const Range& range, const uint32_t* indices, CurenUploadBatch* uploadBatch = nullptr);
+
+		void bind(VkCommandBuffer commandBuffer);
+		VkDescriptorBufferInfo getIndexBufferInfo(const Range& range) const;
+
+		CurenFreeListAllocator::Statistics getVertexStatistics() const { return m_vertexAllocator.getStatistics(); }
+		CurenFreeListAllocator::Statistics getIndexStatistics() const { return m_indexAllocator.getStatistics(); }
+
+	private:
+		void upload(CurenBuffer& buffer, const Range& range, const void* data, CurenUploadBatch* uploadBatch);
+
+		CurenDevice& m_curenDevice;
+
+		std::unique_ptr<CurenBuffer> m_vertexBuffer;
+		std::unique_ptr<CurenBuffer> m_indexBuffer;
+		CurenFreeListAllocator m_vertexAllocator;
+		CurenFreeListAllocator m_indexAllocator;
+		VkDeviceSize m_indexAlignment;
+	};
+}
@@ -0,0 +1,70 @@
+#include "curen_gpu_timer.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+using namespace Curen;
+
+CurenGpuTimer::CurenGpuTimer(CurenDevice& device) : m_curenDevice{ device }
+{
+	const VkPhysicalDeviceLimits& limits = m_curenDevice.properties.limits;
+	m_timestampPeriod = limits.timestampPeriod;
+	if (!limits.timestampComputeAndGraphics) {
+		return;
+	}
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * CurenSwapChain::MAX_FRAMES_IN_FLIGHT;
+	if (vkCreateQueryPool(m_curenDevice.device(), &queryPoolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+}
+
+CurenGpuTimer::~CurenGpuTimer()
+{
+	if (m_queryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(m_curenDevice.device(), m_queryPool, nullptr);
+	}
+}
+
+float CurenGpuTimer::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+{
+	m_frameIndex = frameIndex;
+	if (!isSupported()) {
+		return -1.f;
+	}
+
+	float time = -1.f;
+	if (m_isMeasured[frameIndex]) {
+		uint64_t timestamps[2];
+		// The fence was waited on, so the results are available without VK_QUERY_RESULT_WAIT_BIT
+		if (vkGetQueryPoolResults(m_curenDevice.device(), m_queryPool, 2 * frameIndex, 2, sizeof(timestamps), timestamps,
+			sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			time = static_cast<float>(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6f;
+		}
+	}
+	vkCmdResetQueryPool(commandBuffer, m_queryPool, 2 * frameIndex, 2);
+	m_isMeasured[frameIndex] = false;
+	m_hasBegun[frameIndex] = false;
+	return time;
+}
+
+void CurenGpuTimer::begin(VkCommandBuffer commandBuffer)
+{
+	if (!isSupported()) {
+		return;
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, 2 * m_frameIndex);
+	m_hasBegun[m_frameIndex] = true;
+}
+
+void CurenGpuTimer::end(VkCommandBuffer commandBuffer)
+{
+	if (!isSupported() || !m_hasBegun[m_frameIndex]) {
+		return;
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2 * m_frameIndex + 1);
+	m_isMeasured[m_frameIndex] = true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_swap_chain.hpp"
+
+#include <array>
+
+namespace Curen {
+
+	// GPU time between begin and end of one command buffer, from a pair of timestamp queries per frame in flight.
+	// A frame's result is read once its fence was waited on, so it arrives MAX_FRAMES_IN_FLIGHT frames late
+	class CurenGpuTimer {
+	public:
+		CurenGpuTimer(CurenDevice& device);
+		~CurenGpuTimer();
+
+		CurenGpuTimer(const CurenGpuTimer&) = delete;
+		CurenGpuTimer& operator = (const CurenGpuTimer&) = delete;
+
+		// False when the graphics queue cannot write timestamps, every call is then a no-op
+		bool isSupported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+		// Outside a render pass, after the fence of frameIndex was waited on. Returns the milliseconds measured the
+		// last time frameIndex was recorded, or a negative value when it did not measure anything
+		float beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+		void begin(VkCommandBuffer commandBuffer);
+		void end(VkCommandBuffer commandBuffer);
+
+	private:
+		CurenDevice& m_curenDevice;
+		VkQueryPool m_queryPool = VK_NULL_HANDLE;
+		float m_timestampPeriod;
+		int m_frameIndex = 0;
+		// Both queries of the frame were written since its reset
+		std::array<bool, CurenSwapChain::MAX_FRAMES_IN_FLIGHT> m_isMeasured{};
+		std::array<bool, CurenSwapChain::MAX_FRAMES_IN_FLIGHT> m_hasBegun{};
+	};
+}
@@ -1,4 +1,7 @@
 #include "curen_init.hpp"
+#include "curen_gpu_timer.hpp"
+
+#include <cstddef>
 
 using namespace Curen;
 
@@ -8,16 +11,29 @@ namespace Curen {
         glm::mat4 view{1.f};
         glm::vec4 ambientLightColor{1.f, 1.f, 1.f, .02f};
         glm::vec3 lightPosition{-1.f};
+        // CurenRenderSystem::FragmentFeature bits, read by the runtime branching pipelines
+        uint32_t featureMask = 0;
         alignas(16) glm::vec4 lightColor{1.f};
     };
+
+    // Every shader that reads the global set
+    static const std::vector<std::string> GLOBAL_SET_SHADER_FILES{
+        "first_shader.vert.spv", "first_shader_compact.vert.spv", "first_shader_bindless.vert.spv", "first_shader_bindless_compact.vert.spv",
+        "first_shader.frag.spv", "point_light.vert.spv", "point_light.frag.spv" };
 }
-CurenInit::CurenInit()
+
+CurenInit::CurenInit(bool isLodBenchmark, bool isLodEnabled, bool isMemoryReportEnabled, bool isBindlessEnabled,
+    bool isVariantBenchmark, uint32_t fragmentFeatures, bool isConeCullingEnabled, bool isVerbose) :
+    m_curenDevice{ m_curenWindow, isVerbose }, m_isLodBenchmark{ isLodBenchmark }, m_isLodEnabled{ isLodEnabled }, m_isMemoryReportEnabled{ isMemoryReportEnabled },
+    m_isBindlessEnabled{ isBindlessEnabled }, m_isVariantBenchmark{ isVariantBenchmark }, m_fragmentFeatures{ fragmentFeatures },
+    m_isConeCullingEnabled{ isConeCullingEnabled }, m_isVerbose{ isVerbose }
 {
-	m_globalDescriptorPool = CurenDescriptorPool::Builder(m_curenDevice)
-        .setMaxSets(CurenSwapChain::MAX_FRAMES_IN_FLIGHT)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, CurenSwapChain::MAX_FRAMES_IN_FLIGHT)
-        .build();
-    loadObjects();
+    if (m_isLodBenchmark) {
+        loadLodBenchmark();
+    }
+    else {
+        loadObjects();
+    }
 }
 
 Curen::CurenInit::~CurenInit()
@@ -27,33 +43,47 @@ Curen::CurenInit::~CurenInit()
 
 void CurenInit::run() {
 
-    std::vector<std::unique_ptr<CurenBuffer>> uboBuffers(CurenSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < uboBuffers.size(); i++)
-    {
-        uboBuffers.at(i) = std::make_unique<CurenBuffer>(
-            m_curenDevice,
-            sizeof(GlobalUbo),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        uboBuffers.at(i)->map();
-    }
-    
-    auto globalSetLayout = CurenDescriptorSetLayout::Builder(m_curenDevice)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-        .build();
-
-    std::vector<VkDescriptorSet> globalDescriptorSets(CurenSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < globalDescriptorSets.size(); i++)
-    {
-        auto bufferInfo = uboBuffers.at(i)->descriptorInfo();
-        CurenDescriptorWriter(*globalSetLayout, *m_globalDescriptorPool)
-            .writeBuffer(0, &bufferInfo)
-            .build(globalDescriptorSets.at(i));
+    // The global uniforms live in the renderer's frame allocator, one set serves every frame through its dynamic offset
+    CurenFrameAllocator& frameAllocator = m_curenRenderer.getFrameAllocator();
+    // Every shader declares its own copy of the block, one that was not rebuilt after a change is caught here
+    for (const std::string& shaderFile : GLOBAL_SET_SHADER_FILES) {
+        CurenPipeline::validateStruct(shaderFile, "GlobalUbo", sizeof(GlobalUbo), {
+            { "projection", offsetof(GlobalUbo, projection) },
+            { "view", offsetof(GlobalUbo, view) },
+            { "ambientLightColor", offsetof(GlobalUbo, ambientLightColor) },
+            { "lightPosition", offsetof(GlobalUbo, lightPosition) },
+            { "featureMask", offsetof(GlobalUbo, featureMask) },
+            { "lightColor", offsetof(GlobalUbo, lightColor) } });
     }
+    // Visible to the stages that read it, the systems get this layout for their set 0
+    PipelineLayoutInfo globalLayoutInfo = CurenPipeline::reflectLayout(GLOBAL_SET_SHADER_FILES);
+    auto& globalSetLayout = CurenDescriptorSetLayout::Builder(m_curenDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, globalLayoutInfo.setBindings.at(0).at(0).stageFlags)
+        .buildCached();
 
-	CurenRenderSystem renderSystem {m_curenDevice, m_curenRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
-	CurenPointLightSystem pointLightSystem {m_curenDevice, m_curenRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
+    VkDescriptorSet globalDescriptorSet{};
+    auto bufferInfo = frameAllocator.descriptorInfo(sizeof(GlobalUbo));
+    CurenDescriptorWriter(globalSetLayout, m_curenDevice.descriptorCache())
+        .writeBuffer(0, &bufferInfo)
+        .build(globalDescriptorSet);
+
+    CurenBindlessTable* bindlessTable = m_isBindlessEnabled ? m_curenRenderer.getBindlessTable() : nullptr;
+    if (m_isVerbose) {
+        std::cout << "object transforms: " << (bindlessTable != nullptr ? "bindless" : "push constants") << std::endl;
+    }
+    // Every pipeline is queued here and compiled in the background, a warm pipeline cache skips most of the shader compilation
+    auto pipelineStartTime = std::chrono::high_resolution_clock::now();
+	CurenRenderSystem renderSystem {m_curenDevice, m_curenRenderer.getSwapChainRenderPass(), globalSetLayout.getDescriptorSetLayout(), bindlessTable};
+	CurenPointLightSystem pointLightSystem {m_curenDevice, m_curenRenderer.getSwapChainRenderPass(), globalSetLayout.getDescriptorSetLayout()};
+    CurenMeshletCullSystem meshletCullSystem{ m_curenDevice };
+    float pipelineTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - pipelineStartTime).count();
+    if (m_isVerbose) {
+        std::cout << "systems created in " << pipelineTime << " ms" << std::endl;
+    }
+    renderSystem.setLodEnabled(m_isLodEnabled);
+    renderSystem.setFragmentFeatures(m_fragmentFeatures);
+    meshletCullSystem.setConeCullingEnabled(m_isConeCullingEnabled);
+    renderSystem.setMeshletCullSystem(&meshletCullSystem);
 
     CurenCamera camera{};
     camera.setViewTarget(glm::vec3(-1.f, -2.f, -2.5f), glm::vec3(0.f, 0.f, 2.5f));
@@ -64,6 +94,25 @@ void CurenInit::run() {
 
     auto currentTime = std::chrono::high_resolution_clock::now();
 
+    float statisticsTime = 0.f;
+    uint32_t statisticsFrames = 0;
+    uint64_t statisticsTriangles = 0;
+    float memoryReportTime = 0.f;
+    bool isStreaming = true;
+    bool isCompilingPipelines = true;
+
+    // The variant benchmark switches between the runtime branching pipelines and the variants every second and
+    // times the object pass on the GPU, stepping through every feature combination once both were measured
+    CurenGpuTimer gpuTimer{ m_curenDevice };
+    if (m_isVariantBenchmark && !gpuTimer.isSupported()) {
+        std::cout << "variant benchmark: the graphics queue has no timestamps, nothing will be measured" << std::endl;
+    }
+    std::array<bool, CurenSwapChain::MAX_FRAMES_IN_FLIGHT> isFrameDrawingVariant{};
+    // By runtime branching, then variant
+    float objectPassTimes[2]{};
+    uint32_t objectPassFrames[2]{};
+    float variantBenchmarkTime = 0.f;
+
 	while (!m_curenWindow.shouldClose()) {
 		glfwPollEvents();
 
@@ -76,23 +125,108 @@ void CurenInit::run() {
         
         float aspect = m_curenRenderer.getAspectRatio();
         camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+
+        // The loader admits imports against this snapshot
+        m_curenDevice.updateMemoryBudget();
+        m_modelLoader.update(m_curenObjects);
+        if (m_isMemoryReportEnabled) {
+            memoryReportTime += frameTime;
+            if (memoryReportTime >= 1.f) {
+                memoryReportTime = 0.f;
+                m_curenDevice.printMemoryReport();
+            }
+        }
+        if (isCompilingPipelines && m_curenDevice.pipelineCompiler().isIdle()) {
+            isCompilingPipelines = false;
+            pipelineTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - pipelineStartTime).count();
+            std::cout << "pipelines compiled in " << pipelineTime << " ms with a " << (m_curenDevice.isPipelineCacheWarm() ? "warm" : "cold")
+                << " pipeline cache" << std::endl;
+        }
+        if (isStreaming && m_modelLoader.getPendingCount() == 0) {
+            isStreaming = false;
+            auto vertexStatistics = m_geometryArena.getVertexStatistics();
+            auto indexStatistics = m_geometryArena.getIndexStatistics();
+            std::cout << "geometry arena: vertices " << vertexStatistics.usedSize / 1024 << "/" << vertexStatistics.capacity / 1024 << " KB in "
+                << vertexStatistics.allocationCount << " ranges, indices " << indexStatistics.usedSize / 1024 << "/" << indexStatistics.capacity / 1024
+                << " KB in " << indexStatistics.allocationCount << " ranges, fragmentation " << vertexStatistics.fragmentation << "/" << indexStatistics.fragmentation << std::endl;
+            auto registryStatistics = m_modelRegistry.getStatistics();
+            std::cout << "model registry: " << registryStatistics.loadCount << " loads for " << registryStatistics.requestCount << " requests, "
+                << registryStatistics.residentSize / 1024 << " KB resident, " << registryStatistics.savedSize / 1024 << " KB saved" << std::endl;
+            auto cacheStatistics = m_curenDevice.descriptorCache().getStatistics();
+            std::cout << "descriptor cache: " << cacheStatistics.layoutCount << " layouts (" << cacheStatistics.layoutHits << " hits, "
+                << cacheStatistics.layoutMisses << " misses), " << cacheStatistics.setCount << " sets (" << cacheStatistics.setHits << " hits, "
+                << cacheStatistics.setMisses << " misses, " << cacheStatistics.invalidatedSetCount << " invalidated), " << cacheStatistics.pipelineLayoutCount
+                << " pipeline layouts (" << cacheStatistics.pipelineLayoutHits << " hits, " << cacheStatistics.pipelineLayoutMisses << " misses)" << std::endl;
+        }
 		
         if (auto commandBuffer = m_curenRenderer.beginFrame()) {
+            // The fence of this frame was waited on, models retired long enough ago are out of flight
+            m_modelRegistry.collectGarbage();
 
             int frameIndex = m_curenRenderer.getFrameIndex();
-            FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, camera, globalDescriptorSets.at(frameIndex), m_curenObjects};
+            float viewportHeight = static_cast<float>(m_curenRenderer.getSwapChainExtent().height);
+
+            if (m_isVariantBenchmark) {
+                float objectPassTime = gpuTimer.beginFrame(commandBuffer, frameIndex);
+                if (objectPassTime >= 0.f) {
+                    int pipelineKind = isFrameDrawingVariant[frameIndex] ? 1 : 0;
+                    objectPassTimes[pipelineKind] += objectPassTime;
+                    objectPassFrames[pipelineKind]++;
+                }
+            }
 
             GlobalUbo globalUbo{};
             globalUbo.projection = camera.getProjection();
             globalUbo.view = camera.getView();
-            uboBuffers.at(frameIndex)->writeToBuffer(&globalUbo);
-            uboBuffers.at(frameIndex)->flush();
+            globalUbo.featureMask = renderSystem.getFragmentFeatures();
+            uint32_t globalUboOffset = frameAllocator.push(globalUbo);
+
+            FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, camera, globalDescriptorSet, m_curenObjects, viewportHeight, globalUboOffset,
+                m_curenRenderer.getFrameDescriptorAllocator(), frameAllocator };
+
+            meshletCullSystem.cull(frameInfo);
 
             m_curenRenderer.beginSwapChainRenderPass(commandBuffer);
+            if (m_isVariantBenchmark) {
+                gpuTimer.begin(commandBuffer);
+            }
 			renderSystem.renderObjects(frameInfo);
+            if (m_isVariantBenchmark) {
+                gpuTimer.end(commandBuffer);
+                isFrameDrawingVariant[frameIndex] = renderSystem.isDrawingVariant();
+            }
             pointLightSystem.render(frameInfo);
 			m_curenRenderer.endSwapChainRenderPass(commandBuffer);
 			m_curenRenderer.endFrame();
+
+            if (m_isLodBenchmark) {
+                statisticsTime += frameTime;
+                statisticsFrames++;
+                statisticsTriangles += renderSystem.getDrawnTriangleCount();
+                if (statisticsTime >= 1.f) {
+                    std::cout << "LOD " << (m_isLodEnabled ? "on" : "off") << ": " << statisticsTime * 1000.f / statisticsFrames << " ms/frame, "
+                        << statisticsTriangles / statisticsFrames << " triangles/frame" << std::endl;
+                    statisticsTime = 0.f;
+                    statisticsFrames = 0;
+                    statisticsTriangles = 0;
+                }
+            }
+            if (m_isVariantBenchmark) {
+                variantBenchmarkTime += frameTime;
+                if (variantBenchmarkTime >= 1.f) {
+                    variantBenchmarkTime = 0.f;
+                    renderSystem.setVariantsEnabled(!renderSystem.isVariantsEnabled());
+                    if (objectPassFrames[0] > 0 && objectPassFrames[1] > 0) {
+                        std::cout << "fragment features " << renderSystem.getFragmentFeatures() << ": runtime branching "
+                            << objectPassTimes[0] / objectPassFrames[0] << " ms, variant " << objectPassTimes[1] / objectPassFrames[1]
+                            << " ms GPU per object pass, " << renderSystem.getVariantCount() - 1 << " variants cached" << std::endl;
+                        objectPassTimes[0] = objectPassTimes[1] = 0.f;
+                        objectPassFrames[0] = objectPassFrames[1] = 0;
+                        uint32_t allFeatures = CurenRenderSystem::FEATURE_DIFFUSE | CurenRenderSystem::FEATURE_SPECULAR | CurenRenderSystem::FEATURE_FOG;
+                        renderSystem.setFragmentFeatures(renderSystem.getFragmentFeatures() % allFeatures + 1);
+                    }
+                }
+            }
 		}
 
 	}
@@ -101,26 +235,39 @@ void CurenInit::run() {
 
 void Curen::CurenInit::loadObjects()
 {
-    std::shared_ptr<CurenModel> curenModel = CurenModel::createModelFromFile(m_curenDevice, "../Models/flat_vase.obj");
     auto cube = CurenObject::createObject();
-    cube.model = curenModel;
+    m_modelLoader.loadModel(cube.getId(), "../Models/flat_vase.obj");
     cube.transformComponent.translation = glm::vec3(1.f, 0.5f, .0f);
     cube.transformComponent.scale = { 3.f, 1.5f, 3.f };
     m_curenObjects.emplace(cube.getId(), std::move(cube));
 
-    curenModel = CurenModel::createModelFromFile(m_curenDevice, "../Models/smooth_vase.obj");
+    CurenModel::ImportSettings compactSettings{};
+    compactSettings.vertexLayout = CurenModel::VertexLayout::Compact;
     auto x = CurenObject::createObject();
-    x.model = curenModel;
+    m_modelLoader.loadModel(x.getId(), "../Models/smooth_vase.obj", compactSettings);
     x.transformComponent.translation = glm::vec3(-1.f, 0.5f, .0f);
     x.transformComponent.scale = { 3.f, 1.5f, 3.f };
     m_curenObjects.emplace(x.getId(),std::move(x));
     
-    curenModel = CurenModel::createModelFromFile(m_curenDevice, "../Models/quad.obj");
     auto y = CurenObject::createObject();
-    y.model = curenModel;
+    m_modelLoader.loadModel(y.getId(), "../Models/quad.obj");
     y.transformComponent.translation = glm::vec3(0.f, 0.5f, .0f);
     y.transformComponent.scale = { 3.f, 1.f, 3.f };
     m_curenObjects.emplace(y.getId(), std::move(y));
 
 }
- 
\ No newline at end of file
+ 
+
+void Curen::CurenInit::loadLodBenchmark()
+{
+    // One shared model, most instances far enough away to use the coarser levels. All requests join the same import.
+    for (int z = 0; z < 48; z++) {
+        for (int x = 0; x < 64; x++) {
+            auto vase = CurenObject::createObject();
+            m_modelLoader.loadModel(vase.getId(), "../Models/smooth_vase.obj");
+            vase.transformComponent.translation = glm::vec3((x - 31.5f) * 1.5f, 0.5f, z * 2.f);
+            vase.transformComponent.scale = { 3.f, 1.5f, 3.f };
+            m_curenObjects.emplace(vase.getId(), std::move(vase));
+        }
+    }
+}
@@ -10,6 +10,9 @@
 #include "keyboard_manager.hpp"
 #include "curen_descriptor.hpp"
 #include "curen_point_light_system.hpp"
+#include "curen_meshlet_cull_system.hpp"
+#include "curen_model_loader.hpp"
+#include "curen_model_registry.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -28,10 +31,20 @@ namespace Curen {
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		static constexpr VkDeviceSize VERTEX_ARENA_SIZE = 128 * 1024 * 1024;
+		static constexpr VkDeviceSize INDEX_ARENA_SIZE = 64 * 1024 * 1024;
 
 		void run();
 
-		CurenInit();
+		// The LOD benchmark replaces the demo scene with a field of vases and prints frame statistics every second.
+		// The memory report prints the device memory budget every second. Bindless drawing is only used when the
+		// device supports it. The variant benchmark prints the GPU time of the object pass with and without the
+		// specialized fragment shader. fragmentFeatures are CurenRenderSystem::FragmentFeature bits. Meshlet cone culling
+		// is off unless asked for, see CurenMeshletCullSystem::setConeCullingEnabled. Verbose prints what the device
+		// and the renderer picked at startup.
+		CurenInit(bool isLodBenchmark = false, bool isLodEnabled = true, bool isMemoryReportEnabled = false, bool isBindlessEnabled = true,
+			bool isVariantBenchmark = false, uint32_t fragmentFeatures = CurenRenderSystem::FEATURE_DIFFUSE, bool isConeCullingEnabled = false,
+			bool isVerbose = false);
 		~CurenInit();
 
 		CurenInit(const CurenInit&) = delete;
@@ -39,11 +52,25 @@ namespace Curen {
 
 	private:
 		void loadObjects();
+		void loadLodBenchmark();
 
 		CurenWindow m_curenWindow{WIDTH, HEIGHT, "Curen"};
 		CurenDevice m_curenDevice{ m_curenWindow };
 		CurenRenderer m_curenRenderer{ m_curenWindow, m_curenDevice };
-		std::unique_ptr <CurenDescriptorPool> m_globalDescriptorPool{};
+		// Declared before the objects so every model is gone before the arena
+		CurenGeometryArena m_geometryArena{ m_curenDevice, VERTEX_ARENA_SIZE, INDEX_ARENA_SIZE };
+		// Outlives every model handle, including the ones held by the loader and the objects
+		CurenModelRegistry m_modelRegistry{ m_curenDevice, m_geometryArena };
+		CurenModelLoader m_modelLoader{ m_curenDevice, m_geometryArena, m_modelRegistry };
 		CurenObject::Map m_curenObjects;
+
+		bool m_isLodBenchmark;
+		bool m_isLodEnabled;
+		bool m_isMemoryReportEnabled;
+		bool m_isBindlessEnabled;
+		bool m_isVariantBenchmark;
+		uint32_t m_fragmentFeatures;
+		bool m_isConeCullingEnabled;
+		bool m_isVerbose;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "curen_mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Curen;
+
+// A missing or empty file leaves the object closed instead of throwing, callers decide what that means.
+CurenMappedFile::CurenMappedFile(const std::string& filePath)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	m_fileHandle = file;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return;
+	}
+
+	m_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mappingHandle == nullptr) {
+		close();
+		return;
+	}
+
+	m_data = MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == nullptr) {
+		close();
+		return;
+	}
+	m_size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+	m_fileDescriptor = open(filePath.c_str(), O_RDONLY);
+	if (m_fileDescriptor < 0) {
+		return;
+	}
+
+	struct stat fileStat {};
+	if (fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+		close();
+		return;
+	}
+
+	void* mapping = mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return;
+	}
+	m_data = mapping;
+	m_size = static_cast<std::size_t>(fileStat.st_size);
+#endif
+}
+
+CurenMappedFile::~CurenMappedFile()
+{
+	close();
+}
+
+void CurenMappedFile::close()
+{
+#ifdef _WIN32
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mappingHandle) {
+		CloseHandle(m_mappingHandle);
+	}
+	if (m_fileHandle) {
+		CloseHandle(m_fileHandle);
+	}
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+#else
+	if (m_data) {
+		munmap(m_data, m_size);
+	}
+	if (m_fileDescriptor >= 0) {
+		::close(m_fileDescriptor);
+	}
+	m_fileDescriptor = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Curen {
+
+	// Read-only memory mapping of a whole file. The mapping is released when the object is destroyed.
+	class CurenMappedFile {
+	public:
+		CurenMappedFile(const std::string& filePath);
+		~CurenMappedFile();
+
+		CurenMappedFile(const CurenMappedFile&) = delete;
+		CurenMappedFile& operator = (const CurenMappedFile&) = delete;
+
+		bool isOpen() const { return m_data != nullptr; }
+		const char* data() const { return static_cast<const char*>(m_data); }
+		std::size_t size() const { return m_size; }
+
+	private:
+		void close();
+
+		void* m_data = nullptr;
+		std::size_t m_size = 0;
+
+#ifdef _WIN32
+		void* m_fileHandle = nullptr;
+		void* m_mappingHandle = nullptr;
+#else
+		int m_fileDescriptor = -1;
+#endif
+	};
+}
@@ -0,0 +1,342 @@
+#include "curen_memory_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+using namespace Curen;
+
+struct CurenMemoryAllocator::Block {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	void* mappedData;
+	CurenBuddyAllocator allocator;
+
+	Block(VkDeviceMemory memory, VkDeviceSize size, void* mappedData) :
+		memory{ memory }, size{ size }, mappedData{ mappedData }, allocator{ size, MIN_ALLOCATION_SIZE } {}
+};
+
+const char* CurenMemoryAllocator::getCategoryName(MemoryCategory category)
+{
+	switch (category) {
+	case MemoryCategory::Geometry: return "geometry";
+	case MemoryCategory::Uniform: return "uniform";
+	case MemoryCategory::Depth: return "depth";
+	case MemoryCategory::Staging: return "staging";
+	case MemoryCategory::Texture: return "texture";
+	default: return "other";
+	}
+}
+
+CurenMemoryAllocator::MemoryCategory CurenMemoryAllocator::getBufferCategory(VkBufferUsageFlags usage)
+{
+	if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+		return MemoryCategory::Staging;
+	}
+	if (usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT)) {
+		return MemoryCategory::Uniform;
+	}
+	// Meshlets and the culled draws are storage buffers read by the geometry passes
+	if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)) {
+		return MemoryCategory::Geometry;
+	}
+	return MemoryCategory::Other;
+}
+
+CurenMemoryAllocator::MemoryCategory CurenMemoryAllocator::getImageCategory(VkImageUsageFlags usage)
+{
+	if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+		return MemoryCategory::Depth;
+	}
+	if (usage & VK_IMAGE_USAGE_SAMPLED_BIT) {
+		return MemoryCategory::Texture;
+	}
+	return MemoryCategory::Other;
+}
+
+CurenMemoryAllocator::CurenMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, const VkPhysicalDeviceProperties& properties) :
+	m_device{ device }
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+	m_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+	// Buddy nodes start and end on multiples of MIN_ALLOCATION_SIZE, so only a coarser granularity needs separate blocks
+	m_isSplittingResourceKinds = properties.limits.bufferImageGranularity > MIN_ALLOCATION_SIZE;
+
+	m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+	m_dedicatedAllocationCounts.resize(m_memoryProperties.memoryTypeCount, 0);
+	m_dedicatedSizes.resize(m_memoryProperties.memoryTypeCount, 0);
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		// Small heaps, such as the 256 MB device local and host visible one, get smaller blocks
+		VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[i].heapIndex].size;
+		VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE;
+		while (blockSize > MIN_ALLOCATION_SIZE && blockSize > heapSize / 8) {
+			blockSize /= 2;
+		}
+		m_pools[i * 2].blockSize = blockSize;
+		m_pools[i * 2 + 1].blockSize = blockSize;
+	}
+}
+
+CurenMemoryAllocator::~CurenMemoryAllocator()
+{
+	for (auto& pool : m_pools) {
+		for (auto& block : pool.blocks) {
+			vkFreeMemory(m_device, block->memory, nullptr);
+		}
+	}
+}
+
+CurenMemoryAllocator::Allocation CurenMemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+	ResourceKind resourceKind, MemoryCategory category, VkMemoryPropertyFlags preferredProperties)
+{
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties, preferredProperties);
+	uint32_t fallbackTypeIndex = findMemoryType(requirements.memoryTypeBits, properties, 0);
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	Allocation allocation{};
+	if (memoryTypeIndex == fallbackTypeIndex) {
+		allocation = allocateFromType(requirements.size, requirements.alignment, memoryTypeIndex, resourceKind);
+	}
+	else {
+		try {
+			allocation = allocateFromType(requirements.size, requirements.alignment, memoryTypeIndex, resourceKind);
+		}
+		catch (const std::runtime_error&) {
+			allocation = allocateFromType(requirements.size, requirements.alignment, fallbackTypeIndex, resourceKind);
+		}
+	}
+	allocation.category = category;
+	m_categorySizes[static_cast<uint32_t>(category)] += allocation.size;
+	return allocation;
+}
+
+CurenMemoryAllocator::Allocation CurenMemoryAllocator::allocateFromType(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex,
+	ResourceKind resourceKind)
+{
+	Pool& pool = getPool(memoryTypeIndex, resourceKind);
+	// Anything larger than half a block would waste most of one
+	if (size > pool.blockSize / 2) {
+		return allocateDedicated(size, memoryTypeIndex);
+	}
+
+	Allocation allocation{};
+	allocation.size = size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	for (auto& block : pool.blocks) {
+		VkDeviceSize offset = block->allocator.allocate(size, alignment);
+		if (offset != CurenBuddyAllocator::INVALID_OFFSET) {
+			allocation.block = block.get();
+			allocation.offset = offset;
+			break;
+		}
+	}
+
+	if (allocation.block == nullptr) {
+		void* mappedData = nullptr;
+		VkDeviceMemory memory = allocateMemory(pool.blockSize, memoryTypeIndex, &mappedData);
+		pool.blocks.push_back(std::make_unique<Block>(memory, pool.blockSize, mappedData));
+		allocation.block = pool.blocks.back().get();
+		allocation.offset = allocation.block->allocator.allocate(size, alignment);
+		assert(allocation.offset != CurenBuddyAllocator::INVALID_OFFSET && "Allocation does not fit into an empty block.");
+	}
+
+	allocation.memory = allocation.block->memory;
+	if (allocation.block->mappedData != nullptr) {
+		allocation.mappedData = static_cast<char*>(allocation.block->mappedData) + allocation.offset;
+	}
+	return allocation;
+}
+
+void CurenMemoryAllocator::free(Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	m_categorySizes[static_cast<uint32_t>(allocation.category)] -= allocation.size;
+	if (allocation.block == nullptr) {
+		vkFreeMemory(m_device, allocation.memory, nullptr);
+		m_dedicatedAllocationCounts[allocation.memoryTypeIndex]--;
+		m_dedicatedSizes[allocation.memoryTypeIndex] -= allocation.size;
+		allocation = Allocation{};
+		return;
+	}
+
+	Block* block = allocation.block;
+	block->allocator.free(allocation.offset);
+	allocation = Allocation{};
+	if (!block->allocator.isEmpty()) {
+		return;
+	}
+
+	// Keep one empty block around so a pool emptying and refilling does not churn device allocations
+	for (auto& pool : m_pools) {
+		auto owner = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const std::unique_ptr<Block>& candidate) { return candidate.get() == block; });
+		if (owner == pool.blocks.end()) {
+			continue;
+		}
+		bool hasOtherEmptyBlock = std::any_of(pool.blocks.begin(), pool.blocks.end(),
+			[block](const std::unique_ptr<Block>& candidate) { return candidate.get() != block && candidate->allocator.isEmpty(); });
+		if (hasOtherEmptyBlock) {
+			vkFreeMemory(m_device, block->memory, nullptr);
+			pool.blocks.erase(owner);
+		}
+		return;
+	}
+}
+
+VkResult CurenMemoryAllocator::flush(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+{
+	if (isCoherent(allocation)) {
+		return VK_SUCCESS;
+	}
+	VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+	return vkFlushMappedMemoryRanges(m_device, 1, &mappedRange);
+}
+
+VkResult CurenMemoryAllocator::flush(const Allocation& allocation, const Range* ranges, uint32_t rangeCount)
+{
+	if (isCoherent(allocation) || rangeCount == 0) {
+		return VK_SUCCESS;
+	}
+	std::vector<VkMappedMemoryRange> mappedRanges(rangeCount);
+	for (uint32_t i = 0; i < rangeCount; i++) {
+		mappedRanges[i] = getMappedRange(allocation, ranges[i].size, ranges[i].offset);
+	}
+	return vkFlushMappedMemoryRanges(m_device, rangeCount, mappedRanges.data());
+}
+
+VkResult CurenMemoryAllocator::invalidate(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+{
+	if (isCoherent(allocation)) {
+		return VK_SUCCESS;
+	}
+	VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+	return vkInvalidateMappedMemoryRanges(m_device, 1, &mappedRange);
+}
+
+std::vector<CurenMemoryAllocator::HeapStatistics> CurenMemoryAllocator::getHeapStatistics() const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	std::vector<HeapStatistics> heapStatistics(m_memoryProperties.memoryHeapCount, HeapStatistics{});
+	for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++) {
+		heapStatistics[i].heapSize = m_memoryProperties.memoryHeaps[i].size;
+	}
+
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		HeapStatistics& statistics = heapStatistics[m_memoryProperties.memoryTypes[i].heapIndex];
+		statistics.reservedSize += m_dedicatedSizes[i];
+		statistics.usedSize += m_dedicatedSizes[i];
+		statistics.allocationCount += m_dedicatedAllocationCounts[i];
+		statistics.dedicatedAllocationCount += m_dedicatedAllocationCounts[i];
+
+		for (uint32_t kind = 0; kind < 2; kind++) {
+			for (auto& block : m_pools[i * 2 + kind].blocks) {
+				auto blockStatistics = block->allocator.getStatistics();
+				statistics.reservedSize += block->size;
+				statistics.usedSize += blockStatistics.usedSize;
+				statistics.allocationCount += blockStatistics.allocationCount;
+				statistics.fragmentation += blockStatistics.fragmentation;
+				statistics.blockCount++;
+			}
+		}
+	}
+
+	for (auto& statistics : heapStatistics) {
+		if (statistics.blockCount > 0) {
+			statistics.fragmentation /= statistics.blockCount;
+		}
+	}
+	return heapStatistics;
+}
+
+std::array<VkDeviceSize, CurenMemoryAllocator::MEMORY_CATEGORY_COUNT> CurenMemoryAllocator::getCategorySizes() const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_categorySizes;
+}
+
+uint32_t CurenMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties) const
+{
+	uint32_t bestIndex = UINT32_MAX;
+	int bestScore = -1;
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[i].propertyFlags;
+		if (!(typeFilter & (1 << i)) || (flags & properties) != properties) {
+			continue;
+		}
+		// Types are listed best first for equal flags, so the first one wins ties
+		int score = 0;
+		for (VkMemoryPropertyFlags preferred = flags & preferredProperties; preferred != 0; preferred &= preferred - 1) {
+			score++;
+		}
+		if (score > bestScore) {
+			bestIndex = i;
+			bestScore = score;
+		}
+	}
+	if (bestIndex == UINT32_MAX) {
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+	return bestIndex;
+}
+
+CurenMemoryAllocator::Pool& CurenMemoryAllocator::getPool(uint32_t memoryTypeIndex, ResourceKind resourceKind)
+{
+	uint32_t kind = m_isSplittingResourceKinds && resourceKind == ResourceKind::Optimal ? 1 : 0;
+	return m_pools[memoryTypeIndex * 2 + kind];
+}
+
+VkDeviceMemory CurenMemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate " + std::to_string(size) + " bytes of device memory!");
+	}
+
+	*mappedData = nullptr;
+	if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS) {
+			vkFreeMemory(m_device, memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+	return memory;
+}
+
+CurenMemoryAllocator::Allocation CurenMemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex)
+{
+	Allocation allocation{};
+	allocation.memory = allocateMemory(size, memoryTypeIndex, &allocation.mappedData);
+	allocation.size = size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	m_dedicatedAllocationCounts[memoryTypeIndex]++;
+	m_dedicatedSizes[memoryTypeIndex] += size;
+	return allocation;
+}
+
+VkMappedMemoryRange CurenMemoryAllocator::getMappedRange(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset) const
+{
+	// Non coherent ranges have to start and end on nonCoherentAtomSize. Buddy nodes are aligned to at least that,
+	// so the rounded range never leaves the node.
+	VkDeviceSize begin = allocation.offset + offset;
+	VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+	begin = begin / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+	end = (end + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+
+	VkMappedMemoryRange mappedRange{};
+	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	mappedRange.memory = allocation.memory;
+	mappedRange.offset = begin;
+	// The end of a dedicated allocation may not be a multiple of the atom size
+	mappedRange.size = allocation.block == nullptr && end >= allocation.size ? VK_WHOLE_SIZE : end - begin;
+	return mappedRange;
+}
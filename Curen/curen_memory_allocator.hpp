@@ -0,0 +1,132 @@
+#pragma once
+
+#include "curen_buddy_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Curen {
+
+	// Carves buffers and images out of large VkDeviceMemory blocks instead of allocating memory per resource,
+	// which keeps the allocation count far below maxMemoryAllocationCount. Every memory type has its own blocks,
+	// each managed by a CurenBuddyAllocator. Host visible blocks stay mapped for their whole lifetime.
+	class CurenMemoryAllocator {
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+		// Also covers nonCoherentAtomSize, which is at most 256 bytes
+		static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+
+		// Linear resources must not share a bufferImageGranularity page with optimal tiling images
+		enum class ResourceKind {
+			Linear,
+			Optimal
+		};
+
+		// What a resource is used for, only kept for reporting
+		enum class MemoryCategory {
+			Geometry,
+			Uniform,
+			Depth,
+			Staging,
+			Texture,
+			Other
+		};
+		static constexpr uint32_t MEMORY_CATEGORY_COUNT = 6;
+
+		static const char* getCategoryName(MemoryCategory category);
+		static MemoryCategory getBufferCategory(VkBufferUsageFlags usage);
+		static MemoryCategory getImageCategory(VkImageUsageFlags usage);
+
+		struct Block;
+
+		struct Allocation {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			// Start of the allocation in the persistent mapping, null unless the memory is host visible
+			void* mappedData = nullptr;
+			uint32_t memoryTypeIndex = 0;
+			MemoryCategory category = MemoryCategory::Other;
+			// Null for dedicated allocations, which own their memory
+			Block* block = nullptr;
+		};
+
+		// Relative to an allocation
+		struct Range {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		struct HeapStatistics {
+			VkDeviceSize heapSize;
+			// Memory taken from the device, blocks and dedicated allocations
+			VkDeviceSize reservedSize;
+			VkDeviceSize usedSize;
+			uint32_t blockCount;
+			uint32_t allocationCount;
+			uint32_t dedicatedAllocationCount;
+			// Averaged over the blocks, see CurenBuddyAllocator::Statistics
+			float fragmentation;
+		};
+
+		CurenMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, const VkPhysicalDeviceProperties& properties);
+		~CurenMemoryAllocator();
+
+		CurenMemoryAllocator(const CurenMemoryAllocator&) = delete;
+		CurenMemoryAllocator& operator = (const CurenMemoryAllocator&) = delete;
+
+		// Among the memory types with all of properties, picks the one with the most preferredProperties. Falls back
+		// to the first matching type when the preferred one is out of memory, such as a full 256 MB BAR heap.
+		// Throws when no memory type matches or the device is out of memory.
+		Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind resourceKind,
+			MemoryCategory category, VkMemoryPropertyFlags preferredProperties = 0);
+		void free(Allocation& allocation);
+
+		VkMemoryPropertyFlags getMemoryPropertyFlags(const Allocation& allocation) const {
+			return m_memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags;
+		}
+		bool isCoherent(const Allocation& allocation) const { return getMemoryPropertyFlags(allocation) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT; }
+		VkDeviceSize getNonCoherentAtomSize() const { return m_nonCoherentAtomSize; }
+
+		// Ranges are relative to the allocation, VK_WHOLE_SIZE covers the rest of it. Both return right away on
+		// coherent memory and round to nonCoherentAtomSize otherwise.
+		VkResult flush(const Allocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult flush(const Allocation& allocation, const Range* ranges, uint32_t rangeCount);
+		VkResult invalidate(const Allocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+		std::vector<HeapStatistics> getHeapStatistics() const;
+		// Bytes handed out per MemoryCategory, block overhead not included
+		std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> getCategorySizes() const;
+		const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return m_memoryProperties; }
+
+	private:
+		struct Pool {
+			VkDeviceSize blockSize;
+			std::vector<std::unique_ptr<Block>> blocks;
+		};
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties) const;
+		Allocation allocateFromType(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeIndex, ResourceKind resourceKind);
+		Pool& getPool(uint32_t memoryTypeIndex, ResourceKind resourceKind);
+		VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData);
+		Allocation allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex);
+		VkMappedMemoryRange getMappedRange(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+		VkDevice m_device;
+		VkPhysicalDeviceMemoryProperties m_memoryProperties;
+		VkDeviceSize m_nonCoherentAtomSize;
+		bool m_isSplittingResourceKinds;
+
+		mutable std::mutex m_mutex;
+		// Two pools per memory type, indexed by memoryTypeIndex * 2 + resource kind
+		std::vector<Pool> m_pools;
+		std::vector<uint32_t> m_dedicatedAllocationCounts;
+		std::vector<VkDeviceSize> m_dedicatedSizes;
+		std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> m_categorySizes{};
+	};
+}
@@ -0,0 +1,201 @@
+#include "curen_mesh_cache.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+using namespace Curen;
+
+CurenMeshCache::CurenMeshCache(const std::string& sourcePath, uint32_t importKey)
+{
+	int64_t sourceWriteTime = 0;
+	uint64_t sourceSize = 0;
+	if (!readSourceStamp(sourcePath, sourceWriteTime, sourceSize)) {
+		return;
+	}
+
+	m_file = std::make_unique<CurenMappedFile>(cachePathFor(sourcePath));
+	if (!m_file->isOpen() || m_file->size() < sizeof(Header)) {
+		return;
+	}
+
+	Header header{};
+	std::memcpy(&header, m_file->data(), sizeof(Header));
+	if (header.magic != MAGIC || header.version != VERSION || header.vertexSize != sizeof(CurenModel::Vertex) ||
+		header.importKey != importKey) {
+		return;
+	}
+
+	std::size_t offset = payloadOffset(header.pathLength);
+	std::size_t expectedSize = offset + header.vertexCount * sizeof(CurenModel::Vertex) + header.indexCount * sizeof(uint32_t) +
+		header.lodCount * sizeof(CurenModel::Lod) + header.meshletCount * sizeof(CurenModel::Meshlet);
+	if (m_file->size() != expectedSize) {
+		return;
+	}
+
+	if (sourcePath.size() != header.pathLength ||
+		std::memcmp(m_file->data() + sizeof(Header), sourcePath.data(), header.pathLength) != 0) {
+		return;
+	}
+
+	// A touched but unchanged source only costs a hash, not a re-import
+	if (header.sourceSize != sourceSize) {
+		return;
+	}
+	if (header.sourceWriteTime != sourceWriteTime) {
+		uint64_t sourceHash = 0;
+		if (!hashSource(sourcePath, sourceHash) || sourceHash != header.sourceHash) {
+			return;
+		}
+	}
+
+	m_vertices = reinterpret_cast<const CurenModel::Vertex*>(m_file->data() + offset);
+	m_vertexCount = static_cast<uint32_t>(header.vertexCount);
+	m_indices = reinterpret_cast<const uint32_t*>(m_file->data() + offset + header.vertexCount * sizeof(CurenModel::Vertex));
+	m_indexCount = static_cast<uint32_t>(header.indexCount);
+	m_lods = reinterpret_cast<const CurenModel::Lod*>(m_indices + header.indexCount);
+	m_lodCount = header.lodCount;
+	for (uint32_t i = 0; i < m_lodCount; i++) {
+		if (static_cast<uint64_t>(m_lods[i].firstIndex) + m_lods[i].indexCount > header.indexCount) {
+			return;
+		}
+	}
+	m_meshlets = reinterpret_cast<const CurenModel::Meshlet*>(m_lods + header.lodCount);
+	m_meshletCount = static_cast<uint32_t>(header.meshletCount);
+	for (uint32_t i = 0; i < m_meshletCount; i++) {
+		if (static_cast<uint64_t>(m_meshlets[i].firstIndex) + m_meshlets[i].indexCount > header.indexCount) {
+			return;
+		}
+	}
+	m_isValid = true;
+	m_sourcePath = sourcePath;
+	m_sourceWriteTime = sourceWriteTime;
+	m_isSourceWriteTimeStale = header.sourceWriteTime != sourceWriteTime;
+}
+
+CurenMeshCache::~CurenMeshCache()
+{
+	if (!m_isSourceWriteTimeStale) {
+		return;
+	}
+	// Rewritten through a temporary file like write(), so a reader mapping the cache at the same time never sees a torn
+	// header. The copy is taken while the old file is still mapped. A failure only costs another hash next time.
+	Header header{};
+	std::memcpy(&header, m_file->data(), sizeof(Header));
+	header.sourceWriteTime = m_sourceWriteTime;
+	std::string cachePath = cachePathFor(m_sourcePath);
+	std::string tempPath = cachePath + "." + std::to_string(header.importKey) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(reinterpret_cast<const char*>(m_file->data() + sizeof(Header)), m_file->size() - sizeof(Header));
+		if (!file.good()) {
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(tempPath, error);
+			return;
+		}
+	}
+	// Unmapped first, Windows refuses to replace a mapped file
+	m_file.reset();
+	replaceFile(tempPath, cachePath);
+}
+
+std::string CurenMeshCache::cachePathFor(const std::string& sourcePath)
+{
+	return sourcePath + ".cmesh";
+}
+
+bool CurenMeshCache::write(const std::string& sourcePath, uint32_t importKey, const CurenModel::Builder& builder)
+{
+	Header header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.vertexSize = sizeof(CurenModel::Vertex);
+	header.pathLength = static_cast<uint32_t>(sourcePath.size());
+	header.importKey = importKey;
+	header.vertexCount = builder.vertices.size();
+	header.indexCount = builder.indices.size();
+	header.lodCount = static_cast<uint32_t>(builder.lods.size());
+	header.meshletCount = builder.meshlets.size();
+
+	if (!readSourceStamp(sourcePath, header.sourceWriteTime, header.sourceSize) ||
+		!hashSource(sourcePath, header.sourceHash)) {
+		return false;
+	}
+
+	// Written to a temporary file first so a crash never leaves a truncated cache behind. The key is part of the
+	// name because background imports of one source with different settings may write at the same time.
+	std::string cachePath = cachePathFor(sourcePath);
+	std::string tempPath = cachePath + "." + std::to_string(importKey) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		const char padding[16]{};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(sourcePath.data(), sourcePath.size());
+		file.write(padding, payloadOffset(header.pathLength) - sizeof(Header) - sourcePath.size());
+		file.write(reinterpret_cast<const char*>(builder.vertices.data()), builder.vertices.size() * sizeof(CurenModel::Vertex));
+		file.write(reinterpret_cast<const char*>(builder.indices.data()), builder.indices.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(builder.lods.data()), builder.lods.size() * sizeof(CurenModel::Lod));
+		file.write(reinterpret_cast<const char*>(builder.meshlets.data()), builder.meshlets.size() * sizeof(CurenModel::Meshlet));
+		if (!file.good()) {
+			return false;
+		}
+	}
+
+	return replaceFile(tempPath, cachePath);
+}
+
+bool CurenMeshCache::replaceFile(const std::string& tempPath, const std::string& cachePath)
+{
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+bool CurenMeshCache::readSourceStamp(const std::string& sourcePath, int64_t& writeTime, uint64_t& size)
+{
+	std::error_code error;
+	auto lastWrite = std::filesystem::last_write_time(sourcePath, error);
+	if (error) {
+		return false;
+	}
+	auto fileSize = std::filesystem::file_size(sourcePath, error);
+	if (error) {
+		return false;
+	}
+
+	writeTime = static_cast<int64_t>(lastWrite.time_since_epoch().count());
+	size = static_cast<uint64_t>(fileSize);
+	return true;
+}
+
+bool CurenMeshCache::hashSource(const std::string& sourcePath, uint64_t& hash)
+{
+	CurenMappedFile source{ sourcePath };
+	if (!source.isOpen()) {
+		return false;
+	}
+	hash = Utils::hashBytes(source.data(), source.size());
+	return true;
+}
+
+std::size_t CurenMeshCache::payloadOffset(uint32_t pathLength)
+{
+	return (sizeof(Header) + pathLength + 15) & ~static_cast<std::size_t>(15);
+}
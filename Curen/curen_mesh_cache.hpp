@@ -0,0 +1,80 @@
+#pragma once
+
+#include "curen_model.hpp"
+#include "curen_mapped_file.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Curen {
+
+	// Binary cache of the final, deduplicated vertex and index arrays of an imported mesh, its level of detail table and meshlets.
+	// The cache lives next to the source file (<source>.cmesh) and is keyed by the source path,
+	// its modification time, a hash of its content and the import settings it was built with.
+	class CurenMeshCache {
+	public:
+		static constexpr uint32_t MAGIC = 0x48534d43; // "CMSH"
+		static constexpr uint32_t VERSION = 5;
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexSize;
+			uint32_t pathLength;
+			uint32_t importKey;
+			uint32_t lodCount;
+			int64_t sourceWriteTime;
+			uint64_t sourceSize;
+			uint64_t sourceHash;
+			uint64_t vertexCount;
+			uint64_t indexCount;
+			uint64_t meshletCount;
+		};
+
+		// Maps the cache of sourcePath, isValid() tells whether it can be used instead of the source.
+		CurenMeshCache(const std::string& sourcePath, uint32_t importKey);
+		// Stores the new source write time of a cache that was only accepted by its hash, through a new copy of the file
+		~CurenMeshCache();
+
+		CurenMeshCache(const CurenMeshCache&) = delete;
+		CurenMeshCache& operator = (const CurenMeshCache&) = delete;
+
+		bool isValid() const { return m_isValid; }
+
+		const CurenModel::Vertex* vertices() const { return m_vertices; }
+		uint32_t vertexCount() const { return m_vertexCount; }
+		const uint32_t* indices() const { return m_indices; }
+		uint32_t indexCount() const { return m_indexCount; }
+		const CurenModel::Lod* lods() const { return m_lods; }
+		uint32_t lodCount() const { return m_lodCount; }
+		const CurenModel::Meshlet* meshlets() const { return m_meshlets; }
+		uint32_t meshletCount() const { return m_meshletCount; }
+
+		static std::string cachePathFor(const std::string& sourcePath);
+		static bool write(const std::string& sourcePath, uint32_t importKey, const CurenModel::Builder& builder);
+
+	private:
+		static bool readSourceStamp(const std::string& sourcePath, int64_t& writeTime, uint64_t& size);
+		static bool hashSource(const std::string& sourcePath, uint64_t& hash);
+		// Renames a fully written temporary file over the cache, or removes it
+		static bool replaceFile(const std::string& tempPath, const std::string& cachePath);
+		static std::size_t payloadOffset(uint32_t pathLength);
+
+		std::unique_ptr<CurenMappedFile> m_file;
+		bool m_isValid = false;
+		std::string m_sourcePath;
+		// Touched but unchanged source, so later launches skip the hash again
+		bool m_isSourceWriteTimeStale = false;
+		int64_t m_sourceWriteTime = 0;
+
+		const CurenModel::Vertex* m_vertices = nullptr;
+		uint32_t m_vertexCount = 0;
+		const uint32_t* m_indices = nullptr;
+		uint32_t m_indexCount = 0;
+		const CurenModel::Lod* m_lods = nullptr;
+		uint32_t m_lodCount = 0;
+		const CurenModel::Meshlet* m_meshlets = nullptr;
+		uint32_t m_meshletCount = 0;
+	};
+}
@@ -0,0 +1,277 @@
+#include "curen_mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace Curen;
+
+namespace {
+	// Vertex to triangle adjacency in compressed rows
+	struct TriangleAdjacency {
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+
+		TriangleAdjacency(const std::vector<uint32_t>& indices, std::size_t vertexCount) : offsets(vertexCount + 1, 0), triangles(indices.size()) {
+			for (uint32_t index : indices) {
+				offsets[index + 1]++;
+			}
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (std::size_t i = 0; i < indices.size(); i++) {
+				triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		uint32_t count(uint32_t vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+	};
+
+	// FIFO cache using timestamps, a vertex is cached while it was pushed less than cacheSize pushes ago
+	struct FifoCache {
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t size;
+
+		FifoCache(std::size_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+		bool access(uint32_t vertex) {
+			if (time - timestamps[vertex] > size) {
+				timestamps[vertex] = time++;
+				return false;
+			}
+			return true;
+		}
+
+		void flush() { time += size + 1; }
+	};
+}
+
+CurenMeshOptimizer::VertexCacheStatistics CurenMeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, std::size_t vertexCount, uint32_t cacheSize)
+{
+	FifoCache cache{ vertexCount, cacheSize };
+	std::vector<bool> isUsed(vertexCount, false);
+	std::size_t misses = 0;
+	std::size_t usedVertices = 0;
+
+	for (uint32_t index : indices) {
+		misses += !cache.access(index);
+		if (!isUsed[index]) {
+			isUsed[index] = true;
+			usedVertices++;
+		}
+	}
+
+	VertexCacheStatistics statistics{};
+	statistics.acmr = indices.empty() ? 0.f : static_cast<float>(misses) / (indices.size() / 3);
+	statistics.atvr = usedVertices == 0 ? 0.f : static_cast<float>(misses) / usedVertices;
+	return statistics;
+}
+
+std::vector<uint32_t> CurenMeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, std::size_t vertexCount, uint32_t cacheSize)
+{
+	std::vector<uint32_t> clusters{};
+	std::size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return clusters;
+	}
+
+	TriangleAdjacency adjacency{ indices, vertexCount };
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		liveTriangles[vertex] = adjacency.count(vertex);
+	}
+
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds{};
+	std::vector<uint32_t> candidates{};
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	uint32_t cursor = 0;
+
+	std::vector<uint32_t> result{};
+	result.reserve(indices.size());
+
+	// Dead ends left on the stack are still close in the cache, otherwise continue with the next vertex in input order
+	auto skipDeadEnd = [&]() -> int64_t {
+		while (!deadEnds.empty()) {
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0) {
+				return vertex;
+			}
+		}
+		while (cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0) {
+				return cursor;
+			}
+			cursor++;
+		}
+		return -1;
+	};
+
+	int64_t fanningVertex = skipDeadEnd();
+	clusters.push_back(0);
+	while (fanningVertex >= 0) {
+		uint32_t vertex = static_cast<uint32_t>(fanningVertex);
+		candidates.clear();
+
+		for (uint32_t i = adjacency.offsets[vertex]; i < adjacency.offsets[vertex + 1]; i++) {
+			uint32_t triangle = adjacency.triangles[i];
+			if (isEmitted[triangle]) {
+				continue;
+			}
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				uint32_t index = indices[triangle * 3 + corner];
+				result.push_back(index);
+				deadEnds.push_back(index);
+				candidates.push_back(index);
+				liveTriangles[index]--;
+				if (time - timestamps[index] > cacheSize) {
+					timestamps[index] = time++;
+				}
+			}
+			isEmitted[triangle] = true;
+		}
+
+		// Prefer the candidate that stays in the cache longest while its remaining triangles are emitted.
+		// Starts below zero so a live candidate that would miss the cache still beats the dead-end search
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t candidate : candidates) {
+			if (liveTriangles[candidate] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			if (time - timestamps[candidate] + 2 * liveTriangles[candidate] <= cacheSize) {
+				priority = time - timestamps[candidate];
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = candidate;
+			}
+		}
+
+		if (next < 0) {
+			next = skipDeadEnd();
+			if (next >= 0 && result.size() < indices.size()) {
+				clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+			}
+		}
+		fanningVertex = next;
+	}
+
+	indices = std::move(result);
+	return clusters;
+}
+
+void CurenMeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<CurenModel::Vertex>& vertices,
+	const std::vector<uint32_t>& clusters, float threshold, uint32_t cacheSize)
+{
+	std::size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || clusters.empty()) {
+		return;
+	}
+
+	// Split the hard clusters where the cache miss ratio of the prefix is already good enough
+	std::vector<uint32_t> boundaries{};
+	FifoCache cache{ vertices.size(), cacheSize };
+	for (std::size_t c = 0; c < clusters.size(); c++) {
+		uint32_t begin = clusters[c];
+		uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(triangleCount);
+
+		cache.flush();
+		uint32_t clusterMisses = 0;
+		for (uint32_t i = begin * 3; i < end * 3; i++) {
+			clusterMisses += !cache.access(indices[i]);
+		}
+		float clusterThreshold = threshold * static_cast<float>(clusterMisses) / (end - begin);
+
+		boundaries.push_back(begin);
+		cache.flush();
+		uint32_t start = begin;
+		uint32_t misses = 0;
+		for (uint32_t triangle = begin; triangle < end; triangle++) {
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				misses += !cache.access(indices[triangle * 3 + corner]);
+			}
+			if (triangle + 1 < end && static_cast<float>(misses) / (triangle + 1 - start) <= clusterThreshold) {
+				boundaries.push_back(triangle + 1);
+				start = triangle + 1;
+				misses = 0;
+				cache.flush();
+			}
+		}
+	}
+
+	auto positionOf = [&](uint32_t triangle, uint32_t corner) -> const glm::vec3& {
+		return vertices[indices[triangle * 3 + corner]].position;
+	};
+
+	// Area weighted centroid and normal per cluster, the mesh centroid stands in for the view point
+	std::size_t clusterCount = boundaries.size();
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3{ 0.f });
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3{ 0.f });
+	glm::vec3 meshCentroid{ 0.f };
+	float meshArea = 0.f;
+
+	for (std::size_t c = 0; c < clusterCount; c++) {
+		uint32_t end = c + 1 < clusterCount ? boundaries[c + 1] : static_cast<uint32_t>(triangleCount);
+		float clusterArea = 0.f;
+		for (uint32_t triangle = boundaries[c]; triangle < end; triangle++) {
+			const glm::vec3& p0 = positionOf(triangle, 0);
+			const glm::vec3& p1 = positionOf(triangle, 1);
+			const glm::vec3& p2 = positionOf(triangle, 2);
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.f;
+
+			clusterCentroids[c] += centroid * area;
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterArea;
+
+		clusterCentroids[c] = clusterArea > 0.f ? clusterCentroids[c] / clusterArea : positionOf(boundaries[c], 0);
+		float normalLength = glm::length(clusterNormals[c]);
+		clusterNormals[c] = normalLength > 0.f ? clusterNormals[c] / normalLength : glm::vec3{ 0.f };
+	}
+	meshCentroid = meshArea > 0.f ? meshCentroid / meshArea : meshCentroid;
+
+	std::vector<float> sortKeys(clusterCount);
+	for (std::size_t c = 0; c < clusterCount; c++) {
+		sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result{};
+	result.reserve(indices.size());
+	for (uint32_t c : order) {
+		uint32_t end = c + 1 < clusterCount ? boundaries[c + 1] : static_cast<uint32_t>(triangleCount);
+		result.insert(result.end(), indices.begin() + boundaries[c] * 3, indices.begin() + end * 3);
+	}
+	indices = std::move(result);
+}
+
+void CurenMeshOptimizer::optimizeVertexFetch(std::vector<CurenModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	constexpr uint32_t UNUSED = ~0u;
+	std::vector<uint32_t> remap(vertices.size(), UNUSED);
+	std::vector<CurenModel::Vertex> result{};
+	result.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == UNUSED) {
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	// Vertices no triangle references are dropped
+	vertices = std::move(result);
+}
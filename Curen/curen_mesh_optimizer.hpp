@@ -0,0 +1,37 @@
+#pragma once
+
+#include "curen_model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Curen {
+
+	// Reorders indexed triangle lists for the GPU. All passes keep every triangle and its winding.
+	class CurenMeshOptimizer {
+	public:
+		static constexpr uint32_t CACHE_SIZE = 16;
+
+		struct VertexCacheStatistics {
+			// Average cache miss ratio, transformed vertices per triangle. 0.5 is the lower bound for a regular grid, 3 the worst case
+			float acmr;
+			// Average transform to vertex ratio, transformed vertices per unique vertex. 1 is optimal
+			float atvr;
+		};
+
+		// Simulates a FIFO post-transform cache of cacheSize entries
+		static VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, std::size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+		// Tipsify (Sander et al. 2007). Returns the first triangle of every cluster that starts at a dead end,
+		// these are the hard boundaries optimizeOverdraw is allowed to move.
+		static std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, std::size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+		// Sorts the clusters so outward facing ones on the hull are drawn first. Clusters are split further
+		// as long as their cache miss ratio stays below threshold times the ratio of the unsplit cluster.
+		static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<CurenModel::Vertex>& vertices,
+			const std::vector<uint32_t>& clusters, float threshold = 1.05f, uint32_t cacheSize = CACHE_SIZE);
+
+		// Renumbers the vertices in first use order so the vertex buffer is read close to linearly
+		static void optimizeVertexFetch(std::vector<CurenModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+	};
+}
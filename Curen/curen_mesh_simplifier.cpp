@@ -0,0 +1,278 @@
+#include "curen_mesh_simplifier.hpp"
+#include "curen_vertex_welder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+using namespace Curen;
+
+namespace {
+	// Symmetric 4x4 quadric of the squared distance to a set of weighted planes
+	struct Quadric {
+		double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		static Quadric fromPlane(const glm::vec3& normal, double distance, double weight) {
+			Quadric quadric{};
+			quadric.a00 = weight * normal.x * normal.x;
+			quadric.a11 = weight * normal.y * normal.y;
+			quadric.a22 = weight * normal.z * normal.z;
+			quadric.a01 = weight * normal.x * normal.y;
+			quadric.a02 = weight * normal.x * normal.z;
+			quadric.a12 = weight * normal.y * normal.z;
+			quadric.b0 = weight * normal.x * distance;
+			quadric.b1 = weight * normal.y * distance;
+			quadric.b2 = weight * normal.z * distance;
+			quadric.c = weight * distance * distance;
+			quadric.weight = weight;
+			return quadric;
+		}
+
+		Quadric& operator+=(const Quadric& other) {
+			a00 += other.a00; a11 += other.a11; a22 += other.a22;
+			a01 += other.a01; a02 += other.a02; a12 += other.a12;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+			return *this;
+		}
+
+		// Weighted mean of the squared plane distances
+		double error(const glm::vec3& point) const {
+			double x = point.x, y = point.y, z = point.z;
+			double result = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0 ? std::max(result, 0.0) / weight : 0.0;
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double error;
+	};
+
+	glm::vec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+		return glm::cross(p1 - p0, p2 - p0);
+	}
+}
+
+float CurenMeshSimplifier::getMeshExtent(const std::vector<CurenModel::Vertex>& vertices)
+{
+	if (vertices.empty()) {
+		return 0.f;
+	}
+	glm::vec3 boundsMin = vertices[0].position;
+	glm::vec3 boundsMax = vertices[0].position;
+	for (const auto& vertex : vertices) {
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	glm::vec3 extent = boundsMax - boundsMin;
+	return std::max(extent.x, std::max(extent.y, extent.z));
+}
+
+std::vector<uint32_t> CurenMeshSimplifier::simplify(const std::vector<CurenModel::Vertex>& vertices, const std::vector<uint32_t>& indices,
+	std::size_t targetIndexCount, float targetError, float* resultError)
+{
+	// Collapses work on unique positions, uv and normal seams are resolved again at the end
+	CurenVertexWelder<glm::vec3> positionWelder{ vertices.size() };
+	std::vector<uint32_t> positionOf(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); i++) {
+		positionOf[i] = positionWelder.weld(vertices[i].position);
+	}
+	const std::vector<glm::vec3>& positions = positionWelder.vertices();
+	std::size_t positionCount = positions.size();
+
+	std::vector<std::vector<uint32_t>> wedges(positionCount);
+	for (std::size_t i = 0; i < vertices.size(); i++) {
+		wedges[positionOf[i]].push_back(static_cast<uint32_t>(i));
+	}
+
+	std::vector<uint32_t> triangles{};
+	std::vector<uint32_t> corners{};
+	triangles.reserve(indices.size());
+	corners.reserve(indices.size());
+	for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+		uint32_t p0 = positionOf[indices[i]], p1 = positionOf[indices[i + 1]], p2 = positionOf[indices[i + 2]];
+		if (p0 == p1 || p1 == p2 || p0 == p2) {
+			continue;
+		}
+		triangles.insert(triangles.end(), { p0, p1, p2 });
+		corners.insert(corners.end(), { indices[i], indices[i + 1], indices[i + 2] });
+	}
+	std::size_t triangleCount = triangles.size() / 3;
+
+	// Border and non-manifold edges keep both of their vertices in place
+	std::vector<bool> isLocked(positionCount, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeUses{};
+		edgeUses.reserve(triangles.size());
+		for (std::size_t i = 0; i < triangles.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				uint64_t a = triangles[i + k], b = triangles[i + (k + 1) % 3];
+				edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+			}
+		}
+		for (const auto& edge : edgeUses) {
+			if (edge.second != 2) {
+				isLocked[edge.first >> 32] = true;
+				isLocked[edge.first & 0xffffffff] = true;
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(positionCount);
+	std::vector<std::vector<uint32_t>> adjacency(positionCount);
+	for (std::size_t t = 0; t < triangleCount; t++) {
+		const glm::vec3& p0 = positions[triangles[t * 3 + 0]];
+		glm::vec3 normal = triangleNormal(p0, positions[triangles[t * 3 + 1]], positions[triangles[t * 3 + 2]]);
+		float area = glm::length(normal);
+		if (area > 0.f) {
+			normal /= area;
+			Quadric quadric = Quadric::fromPlane(normal, -glm::dot(normal, p0), area);
+			for (int k = 0; k < 3; k++) {
+				quadrics[triangles[t * 3 + k]] += quadric;
+			}
+		}
+		for (int k = 0; k < 3; k++) {
+			adjacency[triangles[t * 3 + k]].push_back(static_cast<uint32_t>(t));
+		}
+	}
+
+	double extent = getMeshExtent(vertices);
+	double errorLimit = targetError * extent * targetError * extent;
+	double maxError = 0;
+
+	std::vector<bool> isTriangleAlive(triangleCount, true);
+	std::vector<bool> isTouched(positionCount, false);
+	std::vector<Collapse> collapses{};
+	std::size_t aliveCount = triangleCount;
+
+	// Would moving from onto to flip or squash any triangle that survives the collapse
+	auto isCollapseValid = [&](uint32_t from, uint32_t to) {
+		for (uint32_t t : adjacency[from]) {
+			if (!isTriangleAlive[t]) {
+				continue;
+			}
+			const uint32_t* triangle = &triangles[t * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+				continue;
+			}
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; k++) {
+				before[k] = positions[triangle[k]];
+				after[k] = triangle[k] == from ? positions[to] : before[k];
+			}
+			glm::vec3 normalBefore = triangleNormal(before[0], before[1], before[2]);
+			glm::vec3 normalAfter = triangleNormal(after[0], after[1], after[2]);
+			if (glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter)) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	while (aliveCount * 3 > targetIndexCount) {
+		collapses.clear();
+		for (std::size_t t = 0; t < triangleCount; t++) {
+			if (!isTriangleAlive[t]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				uint32_t a = triangles[t * 3 + k], b = triangles[t * 3 + (k + 1) % 3];
+				Quadric combined = quadrics[a];
+				combined += quadrics[b];
+				if (!isLocked[a]) {
+					collapses.push_back({ a, b, combined.error(positions[b]) });
+				}
+				if (!isLocked[b]) {
+					collapses.push_back({ b, a, combined.error(positions[a]) });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) {
+			return l.error < r.error || (l.error == r.error && (l.from < r.from || (l.from == r.from && l.to < r.to)));
+		});
+
+		// Every collapse removes about two triangles, stop the pass early enough to land near the target
+		std::size_t collapseBudget = std::max<std::size_t>((aliveCount - targetIndexCount / 3) / 2, 1);
+		std::size_t collapsed = 0;
+		std::fill(isTouched.begin(), isTouched.end(), false);
+
+		for (const Collapse& collapse : collapses) {
+			if (collapse.error > errorLimit || collapsed >= collapseBudget) {
+				break;
+			}
+			if (isTouched[collapse.from] || isTouched[collapse.to] || !isCollapseValid(collapse.from, collapse.to)) {
+				continue;
+			}
+
+			for (uint32_t t : adjacency[collapse.from]) {
+				if (!isTriangleAlive[t]) {
+					continue;
+				}
+				uint32_t* triangle = &triangles[t * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+					isTriangleAlive[t] = false;
+					aliveCount--;
+					continue;
+				}
+				for (int k = 0; k < 3; k++) {
+					if (triangle[k] == collapse.from) {
+						triangle[k] = collapse.to;
+					}
+				}
+				adjacency[collapse.to].push_back(t);
+			}
+			adjacency[collapse.from].clear();
+			quadrics[collapse.to] += quadrics[collapse.from];
+
+			isTouched[collapse.from] = true;
+			isTouched[collapse.to] = true;
+			maxError = std::max(maxError, collapse.error);
+			collapsed++;
+		}
+
+		if (collapsed == 0) {
+			break;
+		}
+	}
+
+	// Each corner keeps its own vertex if its position survived, otherwise it takes the closest wedge at the new position
+	std::vector<uint32_t> result{};
+	result.reserve(aliveCount * 3);
+	for (std::size_t t = 0; t < triangleCount; t++) {
+		if (!isTriangleAlive[t]) {
+			continue;
+		}
+		for (int k = 0; k < 3; k++) {
+			uint32_t position = triangles[t * 3 + k];
+			uint32_t corner = corners[t * 3 + k];
+			if (positionOf[corner] != position) {
+				const CurenModel::Vertex& original = vertices[corner];
+				float bestScore = -std::numeric_limits<float>::max();
+				for (uint32_t wedge : wedges[position]) {
+					const CurenModel::Vertex& candidate = vertices[wedge];
+					glm::vec2 uvDelta = candidate.uv - original.uv;
+					float score = glm::dot(candidate.normal, original.normal) - glm::dot(uvDelta, uvDelta);
+					if (score > bestScore) {
+						bestScore = score;
+						corner = wedge;
+					}
+				}
+			}
+			result.push_back(corner);
+		}
+	}
+
+	if (resultError) {
+		*resultError = extent > 0 ? static_cast<float>(std::sqrt(maxError) / extent) : 0.f;
+	}
+	return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "curen_model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Curen {
+
+	// Quadric error metric simplification with half-edge collapses (Garland and Heckbert 1997). Vertices
+	// only ever collapse onto other existing vertices, so every level can index the original vertex buffer.
+	class CurenMeshSimplifier {
+	public:
+		// Collapses edges until at most targetIndexCount indices are left or the next collapse would move the
+		// surface further than targetError, relative to the largest extent of the mesh. Open borders stay fixed.
+		// resultError receives the relative error of the returned mesh.
+		static std::vector<uint32_t> simplify(const std::vector<CurenModel::Vertex>& vertices, const std::vector<uint32_t>& indices,
+			std::size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+		static float getMeshExtent(const std::vector<CurenModel::Vertex>& vertices);
+	};
+}
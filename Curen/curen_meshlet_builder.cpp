@@ -0,0 +1,194 @@
+#include "curen_meshlet_builder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Curen;
+
+std::vector<CurenModel::Meshlet> CurenMeshletBuilder::build(const std::vector<CurenModel::Vertex>& vertices, std::vector<uint32_t>& indices,
+	uint32_t indexCount, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	std::vector<CurenModel::Meshlet> meshlets{};
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return meshlets;
+	}
+
+	// Triangles around every vertex, the first liveCounts[v] entries of a list are the ones not yet emitted
+	std::vector<uint32_t> offsets(vertices.size() + 1, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++) {
+		offsets[indices[i] + 1]++;
+	}
+	for (std::size_t v = 0; v < vertices.size(); v++) {
+		offsets[v + 1] += offsets[v];
+	}
+	std::vector<uint32_t> liveCounts(vertices.size(), 0);
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	for (uint32_t i = 0; i < triangleCount * 3; i++) {
+		uint32_t v = indices[i];
+		adjacency[offsets[v] + liveCounts[v]++] = i / 3;
+	}
+
+	auto centroid = [&](uint32_t t) {
+		return (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position + vertices[indices[t * 3 + 2]].position) / 3.f;
+	};
+
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> vertexMeshlet(vertices.size(), std::numeric_limits<uint32_t>::max());
+	std::vector<uint32_t> meshletVertices{};
+	std::vector<uint32_t> result{};
+	result.reserve(triangleCount * 3);
+
+	uint32_t meshletIndex = 0;
+	uint32_t meshletFirstIndex = 0;
+	glm::vec3 centroidSum{ 0.f };
+	uint32_t seedCursor = 0;
+
+	auto flush = [&]() {
+		uint32_t meshletIndexCount = static_cast<uint32_t>(result.size()) - meshletFirstIndex;
+		CurenModel::Meshlet meshlet = computeBounds(vertices, result.data() + meshletFirstIndex, meshletIndexCount);
+		meshlet.firstIndex = meshletFirstIndex;
+		meshlet.indexCount = meshletIndexCount;
+		meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+		meshlets.push_back(meshlet);
+
+		meshletIndex++;
+		meshletFirstIndex = static_cast<uint32_t>(result.size());
+		meshletVertices.clear();
+		centroidSum = glm::vec3{ 0.f };
+	};
+
+	for (uint32_t emitted = 0; emitted < triangleCount; emitted++) {
+		uint32_t meshletTriangles = (static_cast<uint32_t>(result.size()) - meshletFirstIndex) / 3;
+
+		// Neighbours sharing the most vertices keep the meshlet under the vertex limit the longest
+		uint32_t best = std::numeric_limits<uint32_t>::max();
+		uint32_t bestNewVertices = 4;
+		float bestDistance = std::numeric_limits<float>::max();
+		if (meshletTriangles > 0) {
+			glm::vec3 center = centroidSum / static_cast<float>(meshletTriangles);
+			for (uint32_t v : meshletVertices) {
+				for (uint32_t j = offsets[v]; j < offsets[v] + liveCounts[v]; j++) {
+					uint32_t t = adjacency[j];
+					uint32_t newVertices = 0;
+					for (int k = 0; k < 3; k++) {
+						newVertices += vertexMeshlet[indices[t * 3 + k]] != meshletIndex ? 1 : 0;
+					}
+					glm::vec3 delta = centroid(t) - center;
+					float distance = glm::dot(delta, delta);
+					if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance)) {
+						best = t;
+						bestNewVertices = newVertices;
+						bestDistance = distance;
+					}
+				}
+			}
+		}
+
+		// Disconnected pieces continue in input order, which is already spatially coherent after the cache optimization
+		if (best == std::numeric_limits<uint32_t>::max()) {
+			while (isEmitted[seedCursor]) {
+				seedCursor++;
+			}
+			best = seedCursor;
+			bestNewVertices = 0;
+			for (int k = 0; k < 3; k++) {
+				bestNewVertices += vertexMeshlet[indices[best * 3 + k]] != meshletIndex ? 1 : 0;
+			}
+		}
+
+		if (meshletTriangles == maxTriangles || meshletVertices.size() + bestNewVertices > maxVertices) {
+			flush();
+		}
+
+		isEmitted[best] = true;
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = indices[best * 3 + k];
+			if (vertexMeshlet[v] != meshletIndex) {
+				vertexMeshlet[v] = meshletIndex;
+				meshletVertices.push_back(v);
+			}
+
+			uint32_t first = offsets[v];
+			uint32_t last = first + --liveCounts[v];
+			for (uint32_t j = first; j <= last; j++) {
+				if (adjacency[j] == best) {
+					std::swap(adjacency[j], adjacency[last]);
+					break;
+				}
+			}
+			result.push_back(v);
+		}
+		centroidSum += centroid(best);
+	}
+	flush();
+
+	std::copy(result.begin(), result.end(), indices.begin());
+	return meshlets;
+}
+
+CurenModel::Meshlet CurenMeshletBuilder::computeBounds(const std::vector<CurenModel::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount)
+{
+	CurenModel::Meshlet meshlet{};
+	if (indexCount < 3) {
+		meshlet.coneAxisCutoff = glm::vec4{ 0.f, 0.f, 1.f, 1.f };
+		return meshlet;
+	}
+
+	glm::vec3 boundsMin = vertices[indices[0]].position;
+	glm::vec3 boundsMax = boundsMin;
+	for (uint32_t i = 1; i < indexCount; i++) {
+		boundsMin = glm::min(boundsMin, vertices[indices[i]].position);
+		boundsMax = glm::max(boundsMax, vertices[indices[i]].position);
+	}
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = 0.f;
+	for (uint32_t i = 0; i < indexCount; i++) {
+		radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+	}
+	meshlet.boundingSphere = glm::vec4{ center, radius };
+
+	// The cone holds every triangle normal, the whole meshlet faces away from any camera inside its back cone
+	std::vector<glm::vec3> normals{};
+	std::vector<uint32_t> normalTriangles{};
+	glm::vec3 normalSum{ 0.f };
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+		const glm::vec3& p0 = vertices[indices[i]].position;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+		float area = glm::length(normal);
+		if (area > 0.f) {
+			normals.push_back(normal / area);
+			normalTriangles.push_back(i);
+			normalSum += normal / area;
+		}
+	}
+
+	// A cutoff of 1 never culls, used when the normals spread too far for a useful cone
+	meshlet.coneApex = glm::vec4{ center, 0.f };
+	meshlet.coneAxisCutoff = glm::vec4{ 0.f, 0.f, 1.f, 1.f };
+	float axisLength = glm::length(normalSum);
+	if (axisLength <= 0.f) {
+		return meshlet;
+	}
+	glm::vec3 axis = normalSum / axisLength;
+
+	float minDot = 1.f;
+	for (const glm::vec3& normal : normals) {
+		minDot = std::min(minDot, glm::dot(axis, normal));
+	}
+	if (minDot <= 0.1f) {
+		return meshlet;
+	}
+
+	// Move the apex back until every triangle plane lies in front of it
+	float maxT = 0.f;
+	for (std::size_t i = 0; i < normals.size(); i++) {
+		const glm::vec3& p0 = vertices[indices[normalTriangles[i]]].position;
+		float t = glm::dot(center - p0, normals[i]) / glm::dot(axis, normals[i]);
+		maxT = std::max(maxT, t);
+	}
+	meshlet.coneApex = glm::vec4{ center - axis * maxT, 0.f };
+	meshlet.coneAxisCutoff = glm::vec4{ axis, std::sqrt(1.f - minDot * minDot) };
+	return meshlet;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "curen_model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Curen {
+
+	// Splits a triangle list into small clusters that can be culled on their own, see CurenMeshletCullSystem
+	class CurenMeshletBuilder {
+	public:
+		static constexpr uint32_t MAX_VERTICES = 64;
+		static constexpr uint32_t MAX_TRIANGLES = 124;
+
+		// Reorders the first indexCount indices so every meshlet is a contiguous index range. Meshlets are grown
+		// from a seed triangle by adding the neighbour that brings in the fewest new vertices, closest to the meshlet center.
+		static std::vector<CurenModel::Meshlet> build(const std::vector<CurenModel::Vertex>& vertices, std::vector<uint32_t>& indices,
+			uint32_t indexCount, uint32_t maxVertices = MAX_VERTICES, uint32_t maxTriangles = MAX_TRIANGLES);
+
+		// Bounding sphere and backface cone of a triangle list, the index range of the result is left empty
+		static CurenModel::Meshlet computeBounds(const std::vector<CurenModel::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount);
+	};
+}
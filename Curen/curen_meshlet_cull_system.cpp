@@ -0,0 +1,228 @@
+#include "curen_meshlet_cull_system.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+using namespace Curen;
+
+static const char* const SHADER_FILE = "meshlet_cull.comp.spv";
+
+struct MeshletCullPushConstant {
+	// Model space, inside when dot(xyz, p) + w >= 0
+	glm::vec4 frustumPlanes[6];
+	glm::vec3 cameraPosition;
+	uint32_t meshletCount;
+	uint32_t drawIndex;
+	uint32_t isConeCullingEnabled;
+};
+
+CurenMeshletCullSystem::CurenMeshletCullSystem(CurenDevice& device) :
+	m_curenDevice{ device }
+{
+	createDescriptors();
+	createPipelineLayout();
+	createPipeline();
+}
+
+CurenMeshletCullSystem::~CurenMeshletCullSystem()
+{
+}
+
+void CurenMeshletCullSystem::createDescriptors()
+{
+	// Set 0: meshlets and level 0 indices of a model, set 1: compacted indices and draw commands of a frame.
+	// The frame set changes every frame, so it is pushed instead of allocated where the device allows it.
+	m_modelSetLayout = &CurenDescriptorSetLayout::Builder(m_curenDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.buildCached();
+	m_frameSetLayout = &CurenDescriptorSetLayout::Builder(m_curenDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.setPushDescriptor()
+		.buildCached();
+}
+
+void CurenMeshletCullSystem::createPipelineLayout()
+{
+	CurenPipeline::validateStruct(SHADER_FILE, "Push", sizeof(MeshletCullPushConstant), {
+		{ "frustumPlanes", offsetof(MeshletCullPushConstant, frustumPlanes) },
+		{ "cameraPosition", offsetof(MeshletCullPushConstant, cameraPosition) },
+		{ "meshletCount", offsetof(MeshletCullPushConstant, meshletCount) },
+		{ "drawIndex", offsetof(MeshletCullPushConstant, drawIndex) },
+		{ "isConeCullingEnabled", offsetof(MeshletCullPushConstant, isConeCullingEnabled) } });
+
+	// The set layouts are built by hand, the frame set may be a push descriptor set
+	PipelineLayoutInfo layoutInfo = CurenPipeline::reflectLayout({ SHADER_FILE });
+	m_pipelineLayout = CurenPipeline::createPipelineLayout(m_curenDevice, layoutInfo,
+		{ m_modelSetLayout->getDescriptorSetLayout(), m_frameSetLayout->getDescriptorSetLayout() });
+}
+
+void CurenMeshletCullSystem::createPipeline()
+{
+	m_curenPipeline = std::make_unique<CurenPipeline>(
+		m_curenDevice,
+		SHADER_FILE,
+		m_pipelineLayout);
+}
+
+VkDescriptorSet CurenMeshletCullSystem::getModelDescriptorSet(const std::shared_ptr<CurenModel>& model)
+{
+	// A lookup after the first frame the model is culled in
+	VkDescriptorSet descriptorSet{};
+	auto meshletInfo = model->getMeshletBufferInfo();
+	auto indexInfo = model->getIndexBufferInfo();
+	CurenDescriptorWriter(*m_modelSetLayout, m_curenDevice.descriptorCache())
+		.writeBuffer(0, &meshletInfo)
+		.writeBuffer(1, &indexInfo)
+		.build(descriptorSet);
+	return descriptorSet;
+}
+
+void CurenMeshletCullSystem::reserveFrameTarget(FrameTarget& target, uint32_t drawCount, uint32_t indexCount)
+{
+	// The fence of this frame has been waited on, so its buffers are free to replace
+	if (!target.drawBuffer || target.drawBuffer->getInstanceCount() < drawCount) {
+		uint32_t capacity = std::max(drawCount, target.drawBuffer ? target.drawBuffer->getInstanceCount() * 2 : 16u);
+		target.drawBuffer = std::make_unique<CurenBuffer>(
+			m_curenDevice,
+			sizeof(VkDrawIndexedIndirectCommand),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		target.drawBuffer->map();
+	}
+	if (!target.indexBuffer || target.indexBuffer->getInstanceCount() < indexCount) {
+		uint32_t capacity = std::max(indexCount, target.indexBuffer ? target.indexBuffer->getInstanceCount() * 2 : 0u);
+		target.indexBuffer = std::make_unique<CurenBuffer>(
+			m_curenDevice,
+			sizeof(uint32_t),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+}
+
+void CurenMeshletCullSystem::cull(FrameInfo& frameInfo)
+{
+	FrameTarget& target = m_frameTargets[frameInfo.frameIndex];
+	target.drawIndices.clear();
+
+	std::vector<std::pair<CurenObject::id_t, CurenObject*>> culledObjects{};
+	uint32_t indexCount = 0;
+	for (auto& kv : frameInfo.objects) {
+		auto& obj = kv.second;
+		if (obj.model == nullptr || obj.model->getMeshletCount() == 0 || obj.lodLevel != 0) {
+			continue;
+		}
+		culledObjects.push_back({ kv.first, &obj });
+		indexCount += obj.model->getLod(0).indexCount;
+	}
+	if (culledObjects.empty()) {
+		return;
+	}
+
+	reserveFrameTarget(target, static_cast<uint32_t>(culledObjects.size()), indexCount);
+	auto* drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(target.drawBuffer->getMappedMemory());
+
+	m_curenPipeline->bind(frameInfo.commandBuffer);
+	// Without push descriptors the set comes from the frame descriptor allocator
+	auto indexInfo = target.indexBuffer->descriptorInfo();
+	auto drawInfo = target.drawBuffer->descriptorInfo();
+	CurenDescriptorWriter(*m_frameSetLayout, frameInfo.frameDescriptorAllocator)
+		.writeBuffer(0, &indexInfo)
+		.writeBuffer(1, &drawInfo)
+		.push(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 1);
+
+	glm::mat4 viewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+	glm::vec4 cameraPosition = glm::inverse(frameInfo.camera.getView())[3];
+	uint32_t firstIndex = 0;
+
+	for (uint32_t drawIndex = 0; drawIndex < culledObjects.size(); drawIndex++) {
+		CurenObject& obj = *culledObjects[drawIndex].second;
+		const CurenModel::Lod& lod = obj.model->getLod(0);
+
+		// The shader appends to indexCount, everything else stays as written here
+		drawCommands[drawIndex] = { 0, 1, firstIndex, obj.model->getVertexOffset(), 0 };
+		target.drawIndices[culledObjects[drawIndex].first] = drawIndex;
+
+		// Meshlet bounds are in model space, so the planes and the camera are brought there (Gribb and Hartmann)
+		glm::mat4 modelMatrix = obj.transformComponent.mat4();
+		glm::mat4 clip = viewProjection * modelMatrix;
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4{ clip[0][i], clip[1][i], clip[2][i], clip[3][i] };
+		}
+
+		MeshletCullPushConstant push{};
+		push.frustumPlanes[0] = rows[3] + rows[0];
+		push.frustumPlanes[1] = rows[3] - rows[0];
+		push.frustumPlanes[2] = rows[3] + rows[1];
+		push.frustumPlanes[3] = rows[3] - rows[1];
+		push.frustumPlanes[4] = rows[2];
+		push.frustumPlanes[5] = rows[3] - rows[2];
+		for (auto& plane : push.frustumPlanes) {
+			plane /= glm::length(glm::vec3{ plane });
+		}
+		push.cameraPosition = glm::vec3{ glm::inverse(modelMatrix) * cameraPosition };
+		push.meshletCount = obj.model->getMeshletCount();
+		push.drawIndex = drawIndex;
+		push.isConeCullingEnabled = m_isConeCullingEnabled ? 1 : 0;
+
+		VkDescriptorSet modelSet = getModelDescriptorSet(obj.model);
+		vkCmdBindDescriptorSets(
+			frameInfo.commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			m_pipelineLayout,
+			0,
+			1,
+			&modelSet,
+			0,
+			nullptr);
+		vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletCullPushConstant), &push);
+
+		// One workgroup per meshlet, split over y past the guaranteed 65535 groups per dimension
+		uint32_t groupCountX = std::min(push.meshletCount, 65535u);
+		uint32_t groupCountY = (push.meshletCount + groupCountX - 1) / groupCountX;
+		vkCmdDispatch(frameInfo.commandBuffer, groupCountX, groupCountY, 1);
+
+		firstIndex += lod.indexCount;
+	}
+	target.drawBuffer->markDirty(culledObjects.size() * sizeof(VkDrawIndexedIndirectCommand));
+	target.drawBuffer->flushDirtyRanges();
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	vkCmdPipelineBarrier(
+		frameInfo.commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		nullptr,
+		0,
+		nullptr);
+}
+
+bool CurenMeshletCullSystem::draw(FrameInfo& frameInfo, CurenObject::id_t objectId)
+{
+	FrameTarget& target = m_frameTargets[frameInfo.frameIndex];
+	auto drawIndex = target.drawIndices.find(objectId);
+	if (drawIndex == target.drawIndices.end()) {
+		return false;
+	}
+
+	vkCmdBindIndexBuffer(frameInfo.commandBuffer, target.indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdDrawIndexedIndirect(
+		frameInfo.commandBuffer,
+		target.drawBuffer->getBuffer(),
+		drawIndex->second * sizeof(VkDrawIndexedIndirectCommand),
+		1,
+		sizeof(VkDrawIndexedIndirectCommand));
+	return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "curen_pipeline.hpp"
+#include "curen_device.hpp"
+#include "curen_buffer.hpp"
+#include "curen_descriptor.hpp"
+#include "curen_object.hpp"
+#include "curen_frame_info.hpp"
+#include "curen_swap_chain.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Curen {
+
+	// Culls the meshlets of every object drawn at level of detail 0 against the view frustum and their backface cones
+	// in a compute pass, and compacts the surviving triangles into a per frame index buffer drawn with an indirect draw.
+	class CurenMeshletCullSystem {
+	public:
+		CurenMeshletCullSystem(CurenDevice& device);
+		~CurenMeshletCullSystem();
+
+		CurenMeshletCullSystem(const CurenMeshletCullSystem&) = delete;
+		CurenMeshletCullSystem& operator = (const CurenMeshletCullSystem&) = delete;
+
+		// Records the culling dispatches, has to be called before the render pass begins. Uses the level of detail
+		// every object was drawn with last frame.
+		void cull(FrameInfo& frameInfo);
+		// Binds the compacted index buffer and draws the object, false if it was not culled this frame
+		bool draw(FrameInfo& frameInfo, CurenObject::id_t objectId);
+
+		// Cone culling drops back facing triangles, only enable it when the pipeline culls back faces as well. Off by
+		// default, the object pipelines draw both sides and the open vases show their inside through the rim.
+		void setConeCullingEnabled(bool isConeCullingEnabled) { m_isConeCullingEnabled = isConeCullingEnabled; }
+
+	private:
+		struct FrameTarget {
+			std::unique_ptr<CurenBuffer> indexBuffer;
+			std::unique_ptr<CurenBuffer> drawBuffer;
+			std::unordered_map<CurenObject::id_t, uint32_t> drawIndices;
+		};
+
+		void createDescriptors();
+		void createPipelineLayout();
+		void createPipeline();
+		VkDescriptorSet getModelDescriptorSet(const std::shared_ptr<CurenModel>& model);
+		void reserveFrameTarget(FrameTarget& target, uint32_t drawCount, uint32_t indexCount);
+
+		CurenDevice& m_curenDevice;
+
+		std::unique_ptr<CurenPipeline> m_curenPipeline;
+		// Owned by the descriptor cache
+		VkPipelineLayout m_pipelineLayout;
+
+		// From the device's descriptor cache. Model sets are cached there too and freed with the model's meshlet
+		// buffer, which the registry only destroys once no frame in flight can read it. The frame set is pushed.
+		CurenDescriptorSetLayout* m_modelSetLayout;
+		CurenDescriptorSetLayout* m_frameSetLayout;
+
+		std::array<FrameTarget, CurenSwapChain::MAX_FRAMES_IN_FLIGHT> m_frameTargets;
+
+		bool m_isConeCullingEnabled = false;
+	};
+}
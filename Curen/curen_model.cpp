@@ -1,35 +1,82 @@
 #include "curen_model.hpp"
+#include "curen_mesh_cache.hpp"
+#include "curen_mesh_optimizer.hpp"
+#include "curen_mesh_simplifier.hpp"
+#include "curen_meshlet_builder.hpp"
+#include "curen_obj_parser.hpp"
+#include "curen_vertex_quantizer.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+Curen::CurenModel::CurenModel(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const CurenModel::Builder& builder, VertexLayout vertexLayout,
+	CurenUploadBatch* uploadBatch) :
+	CurenModel(curenDevice, geometryArena, builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()),
+		builder.indices.data(), static_cast<uint32_t>(builder.indices.size()), vertexLayout,
+		builder.lods.data(), static_cast<uint32_t>(builder.lods.size()), builder.meshlets.data(), static_cast<uint32_t>(builder.meshlets.size()),
+		uploadBatch)
+{
+}
 
-namespace std {
-	template <>
-	struct hash<Curen::CurenModel::Vertex> {
-		size_t operator()(Curen::CurenModel::Vertex const& vertex) const {
-			size_t seed = 0;
-			Utils::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
+Curen::CurenModel::CurenModel(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const Vertex* vertices, uint32_t vertexCount,
+	const uint32_t* indices, uint32_t indexCount, VertexLayout vertexLayout, const Lod* lods, uint32_t lodCount, const Meshlet* meshlets, uint32_t meshletCount,
+	CurenUploadBatch* uploadBatch) :
+	m_curenDevice{ curenDevice }, m_geometryArena{ geometryArena }, m_vertexLayout{ vertexLayout }
+{
+	// Without a batch all buffers still go out in one submission, which is waited on before returning
+	std::unique_ptr<CurenUploadBatch> localBatch{};
+	if (uploadBatch == nullptr) {
+		localBatch = std::make_unique<CurenUploadBatch>(m_curenDevice);
+		uploadBatch = localBatch.get();
+	}
+
+	// The destructor does not run when the constructor throws, so the arena ranges taken so far are given back here.
+	// Ranges that were never allocated are empty and ignored.
+	try {
+		createVertexBuffer(vertices, vertexCount, uploadBatch);
+		createMeshletBuffer(meshlets, meshletCount, uploadBatch);
+		createIndexBuffer(indices, indexCount, uploadBatch);
+		computeBoundingSphere(vertices, vertexCount);
+
+		if (localBatch != nullptr) {
+			localBatch->submit();
+			localBatch->wait();
 		}
-	};
+	}
+	catch (...) {
+		m_geometryArena.freeVertices(m_vertexRange);
+		m_geometryArena.freeIndices(m_indexRange);
+		throw;
+	}
+
+	if (lodCount > 0) {
+		m_lods.assign(lods, lods + lodCount);
+	}
+	else {
+		m_lods.push_back({ 0, indexCount, 0.f });
+	}
 }
 
-Curen::CurenModel::CurenModel(CurenDevice& curenDevice, const CurenModel::Builder& builder) :
-	m_curenDevice {curenDevice}
+Curen::CurenModel::~CurenModel()
 {
-	createVertexBuffer(builder.vertices);
-	createIndexBuffer(builder.indices);
+	m_geometryArena.freeVertices(m_vertexRange);
+	m_geometryArena.freeIndices(m_indexRange);
 }
 
-Curen::CurenModel::~CurenModel()
+void Curen::CurenModel::Builder::loadModel(const std::string& filePath)
 {
+	// Polygons with more than four corners are only triangulated the reference way by tinyobjloader
+	if (CurenObjParser::parse(filePath, vertices, indices) == 0) {
+		loadModelTinyObj(filePath);
+	}
 }
 
-void Curen::CurenModel::Builder::loadModel(const std::string& filePath) 
+// Reference single threaded import, the fallback for polygons and what CurenObjParser is compared against
+void Curen::CurenModel::Builder::loadModelTinyObj(const std::string& filePath)
 {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
@@ -78,76 +125,260 @@ void Curen::CurenModel::Builder::loadModel(const std::string& filePath)
 				};
 			}
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+			// One lookup: a second one never finds a vertex with a NaN, which is not equal to itself
+			auto inserted = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(vertices.size()));
+			if (inserted.second) {
 				vertices.push_back(vertex);
 			}
-			indices.push_back(uniqueVertices[vertex]);
+			indices.push_back(inserted.first->second);
 		}
 	}
 }
 
-std::unique_ptr<Curen::CurenModel> Curen::CurenModel::createModelFromFile(CurenDevice& curenDevice, const std::string& filePath)
+void Curen::CurenModel::Builder::optimize()
 {
-	Builder builder{};
-	builder.loadModel(filePath);
+	auto startTime = std::chrono::high_resolution_clock::now();
+	// Only level 0, generateLods already ordered the coarser levels for the cache
+	uint32_t levelIndexCount = lods.empty() ? static_cast<uint32_t>(indices.size()) : lods[0].indexCount;
+	std::vector<uint32_t> levelIndices(indices.begin(), indices.begin() + levelIndexCount);
+	auto before = CurenMeshOptimizer::analyzeVertexCache(levelIndices, vertices.size());
+
+	if (meshlets.empty()) {
+		std::vector<uint32_t> clusters = CurenMeshOptimizer::optimizeVertexCache(levelIndices, vertices.size());
+		CurenMeshOptimizer::optimizeOverdraw(levelIndices, vertices, clusters);
+	}
+	else {
+		// Every meshlet is drawn as its own index range, so its triangles are ordered within it. Renumbered to the
+		// meshlet's own few vertices first, the cache simulation would otherwise cost the whole mesh per meshlet.
+		std::unordered_map<uint32_t, uint32_t> localIndices{};
+		std::vector<uint32_t> globalIndices{};
+		std::vector<uint32_t> meshletIndices{};
+		for (const auto& meshlet : meshlets) {
+			localIndices.clear();
+			globalIndices.clear();
+			meshletIndices.clear();
+			for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++) {
+				auto inserted = localIndices.try_emplace(levelIndices[i], static_cast<uint32_t>(globalIndices.size()));
+				if (inserted.second) {
+					globalIndices.push_back(levelIndices[i]);
+				}
+				meshletIndices.push_back(inserted.first->second);
+			}
+			CurenMeshOptimizer::optimizeVertexCache(meshletIndices, globalIndices.size());
+			for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+				levelIndices[meshlet.firstIndex + i] = globalIndices[meshletIndices[i]];
+			}
+		}
+	}
+	std::copy(levelIndices.begin(), levelIndices.end(), indices.begin());
+	CurenMeshOptimizer::optimizeVertexFetch(vertices, indices);
+
+	// Measured on the final order, after meshlets and vertex fetch
+	levelIndices.assign(indices.begin(), indices.begin() + levelIndexCount);
+	auto after = CurenMeshOptimizer::analyzeVertexCache(levelIndices, vertices.size());
+	float optimizeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "mesh optimized in " << optimizeTime << " ms: ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+void Curen::CurenModel::Builder::generateLods(uint32_t lodCount)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	lods.clear();
+	lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.f });
+	if (lodCount <= 1 || indices.empty()) {
+		return;
+	}
+
+	// Every level is simplified from level 0 so the reported error is measured against the full mesh
+	std::vector<uint32_t> baseIndices = indices;
+	float extent = CurenMeshSimplifier::getMeshExtent(vertices);
+	std::size_t targetIndexCount = baseIndices.size();
 
-	return std::make_unique<Curen::CurenModel>(curenDevice, builder);
+	for (uint32_t level = 1; level < lodCount; level++) {
+		targetIndexCount = targetIndexCount / 2 / 3 * 3;
+		float error = 0.f;
+		std::vector<uint32_t> lodIndices = CurenMeshSimplifier::simplify(vertices, baseIndices, targetIndexCount, LOD_MAX_ERROR, &error);
+
+		// Stop once the simplifier is stuck on locked borders or the error limit
+		if (lodIndices.empty() || lodIndices.size() * 10 > lods.back().indexCount * 9) {
+			break;
+		}
+		CurenMeshOptimizer::optimizeVertexCache(lodIndices, vertices.size());
+
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), error * extent });
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
+	float lodTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "generated " << lods.size() << " levels of detail in " << lodTime << " ms:";
+	for (const auto& lod : lods) {
+		std::cout << " " << lod.indexCount / 3;
+	}
+	std::cout << " triangles" << std::endl;
 }
 
-void Curen::CurenModel::bind(VkCommandBuffer commandBuffer)
+void Curen::CurenModel::Builder::buildMeshlets()
+{
+	meshlets.clear();
+	uint32_t levelIndexCount = lods.empty() ? static_cast<uint32_t>(indices.size()) : lods[0].indexCount;
+	// A single meshlet would only repeat the per object draw
+	if (levelIndexCount <= CurenMeshletBuilder::MAX_TRIANGLES * 3) {
+		return;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	meshlets = CurenMeshletBuilder::build(vertices, indices, levelIndexCount);
+
+	uint64_t meshletVertices = 0;
+	for (const auto& meshlet : meshlets) {
+		meshletVertices += meshlet.vertexCount;
+	}
+	float buildTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "built " << meshlets.size() << " meshlets in " << buildTime << " ms: " << levelIndexCount / 3.f / meshlets.size()
+		<< " triangles, " << static_cast<float>(meshletVertices) / meshlets.size() << " vertices on average" << std::endl;
+}
+
+void Curen::CurenModel::Builder::import(const std::string& filePath, const ImportSettings& importSettings)
 {
-	VkBuffer buffers[] = { m_vertexBuffer->getBuffer()};
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-	
-	if (m_hasIndexBuffer)
 	{
-		vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		CurenMeshCache meshCache{ filePath, importSettings.getCacheKey() };
+		if (meshCache.isValid()) {
+			vertices.assign(meshCache.vertices(), meshCache.vertices() + meshCache.vertexCount());
+			indices.assign(meshCache.indices(), meshCache.indices() + meshCache.indexCount());
+			lods.assign(meshCache.lods(), meshCache.lods() + meshCache.lodCount());
+			meshlets.assign(meshCache.meshlets(), meshCache.meshlets() + meshCache.meshletCount());
+			return;
+		}
 	}
+	importSource(filePath, importSettings);
+}
+
+void Curen::CurenModel::Builder::importSource(const std::string& filePath, const ImportSettings& importSettings)
+{
+	loadModel(filePath);
+	generateLods(importSettings.lodCount);
+	if (importSettings.buildMeshlets) {
+		buildMeshlets();
+	}
+	// Last, every earlier step reorders the level 0 triangles
+	if (importSettings.optimizeMesh) {
+		optimize();
+	}
+
+	if (!CurenMeshCache::write(filePath, importSettings.getCacheKey(), *this)) {
+		std::cout << "model " << filePath << ": could not write mesh cache" << std::endl;
+	}
+}
+
+std::unique_ptr<Curen::CurenModel> Curen::CurenModel::createModelFromFile(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const std::string& filePath)
+{
+	return createModelFromFile(curenDevice, geometryArena, filePath, ImportSettings{});
+}
+
+std::unique_ptr<Curen::CurenModel> Curen::CurenModel::createModelFromFile(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const std::string& filePath,
+	const ImportSettings& importSettings)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	// Warm start: the mapped cache is copied straight into the staging buffers
+	{
+		CurenMeshCache meshCache{ filePath, importSettings.getCacheKey() };
+		if (meshCache.isValid()) {
+			auto model = std::make_unique<Curen::CurenModel>(curenDevice, geometryArena, meshCache.vertices(), meshCache.vertexCount(),
+				meshCache.indices(), meshCache.indexCount(), importSettings.vertexLayout, meshCache.lods(), meshCache.lodCount(),
+				meshCache.meshlets(), meshCache.meshletCount());
+
+			float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+			std::cout << "model " << filePath << ": " << meshCache.vertexCount() << " vertices, loaded from mesh cache in " << loadTime << " ms" << std::endl;
+			return model;
+		}
+	}
+
+	Builder builder{};
+	builder.importSource(filePath, importSettings);
+
+	auto model = std::make_unique<Curen::CurenModel>(curenDevice, geometryArena, builder, importSettings.vertexLayout);
+
+	float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "model " << filePath << ": " << builder.vertices.size() << " vertices, imported from source in " << loadTime << " ms" << std::endl;
+	return model;
+}
+
+void Curen::CurenModel::bind(VkCommandBuffer commandBuffer)
+{
+	m_geometryArena.bind(commandBuffer);
 }
 
 void Curen::CurenModel::draw(VkCommandBuffer commandBuffer)
 {
-	if (m_hasIndexBuffer)
+	draw(commandBuffer, 0);
+}
+
+void Curen::CurenModel::draw(VkCommandBuffer commandBuffer, uint32_t lod)
+{
+	if (!m_hasIndexBuffer)
 	{
-		vkCmdDrawIndexed(commandBuffer, m_indexCount, 1, 0, 0, 0);
+		vkCmdDraw(commandBuffer, m_vertexCount, 1, m_vertexOffset, 0);
+		return;
+	}
 
+	const Lod& range = m_lods[lod];
+	vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, m_firstIndex + range.firstIndex, m_vertexOffset, 0);
+}
+
+void Curen::CurenModel::computeBoundingSphere(const Vertex* vertices, uint32_t vertexCount)
+{
+	if (vertexCount == 0) {
+		return;
 	}
-	else {
-		vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+
+	glm::vec3 boundsMin = vertices[0].position;
+	glm::vec3 boundsMax = vertices[0].position;
+	for (uint32_t i = 1; i < vertexCount; i++) {
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = 0.f;
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		radius = std::max(radius, glm::length(vertices[i].position - center));
 	}
+	m_boundingSphere = glm::vec4{ center, radius };
 }
 
-void Curen::CurenModel::createVertexBuffer(const std::vector<Vertex>& vertices)
+void Curen::CurenModel::createVertexBuffer(const Vertex* vertices, uint32_t vertexCount, CurenUploadBatch* uploadBatch)
 {
-	m_vertexCount = static_cast<uint32_t>(vertices.size());
-	assert(m_vertexCount >= 3 && "Vertex count must be at least three.");
-	VkDeviceSize bufferSize = sizeof(vertices.at(0)) * m_vertexCount;
-
-	uint32_t vertexSize = sizeof(vertices.at(0));
+	if (m_vertexLayout == VertexLayout::Full) {
+		uploadVertexBuffer(vertices, sizeof(Vertex), vertexCount, uploadBatch);
+		return;
+	}
 
-	CurenBuffer stagingBuffer{
-		m_curenDevice,
-		vertexSize,
-		m_vertexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	};
+	std::vector<CompactVertex> compactVertices{};
+	m_dequantizationMatrix = CurenVertexQuantizer::quantize(vertices, vertexCount, compactVertices);
+	uploadVertexBuffer(compactVertices.data(), sizeof(CompactVertex), vertexCount, uploadBatch);
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)vertices.data());
+	auto error = CurenVertexQuantizer::measureError(vertices, compactVertices, m_dequantizationMatrix);
+	std::cout << "compact vertices: " << sizeof(Vertex) * vertexCount << " -> " << sizeof(CompactVertex) * vertexCount << " bytes, max error position "
+		<< error.position << ", normal " << error.normalDegrees << " deg, uv " << error.uv << ", color " << error.color << std::endl;
+}
 
-	m_vertexBuffer = std::make_unique<CurenBuffer>(m_curenDevice, vertexSize, m_vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+void Curen::CurenModel::uploadVertexBuffer(const void* vertexData, uint32_t vertexSize, uint32_t vertexCount, CurenUploadBatch* uploadBatch)
+{
+	m_vertexCount = vertexCount;
+	assert(m_vertexCount >= 3 && "Vertex count must be at least three.");
 
-	m_curenDevice.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+	m_vertexRange = m_geometryArena.allocateVertices(vertexSize, m_vertexCount);
+	m_vertexOffset = static_cast<int32_t>(m_vertexRange.offset / vertexSize);
+	m_geometryArena.uploadVertices(m_vertexRange, vertexData, uploadBatch);
 }
 
 
-void Curen::CurenModel::createIndexBuffer(const std::vector<uint32_t>& indices)
+void Curen::CurenModel::createIndexBuffer(const uint32_t* indices, uint32_t indexCount, CurenUploadBatch* uploadBatch)
 {
-	m_indexCount = static_cast<uint32_t>(indices.size());
+	m_indexCount = indexCount;
 	m_hasIndexBuffer = m_indexCount > 0;
 
 	if (!m_hasIndexBuffer)
@@ -155,24 +386,25 @@ void Curen::CurenModel::createIndexBuffer(const std::vector<uint32_t>& indices)
 		return;
 	}
 
-	VkDeviceSize bufferSize = sizeof(indices.at(0)) * m_indexCount;
-	uint32_t indexSize = sizeof(indices.at(0));
+	m_indexRange = m_geometryArena.allocateIndices(m_indexCount);
+	m_firstIndex = static_cast<uint32_t>(m_indexRange.offset / sizeof(uint32_t));
+	m_geometryArena.uploadIndices(m_indexRange, indices, uploadBatch);
+}
 
-	CurenBuffer stagingBuffer{
-		m_curenDevice,
-		indexSize,
-		m_indexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	};
+void Curen::CurenModel::createMeshletBuffer(const Meshlet* meshlets, uint32_t meshletCount, CurenUploadBatch* uploadBatch)
+{
+	m_meshletCount = meshletCount;
+	if (m_meshletCount == 0)
+	{
+		return;
+	}
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)indices.data());
+	uint32_t meshletSize = sizeof(Meshlet);
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(meshletSize) * m_meshletCount;
 
-	m_indexBuffer = std::make_unique<CurenBuffer>(m_curenDevice, indexSize, m_indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	m_meshletBuffer = std::make_unique<CurenBuffer>(m_curenDevice, meshletSize, m_meshletCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	
-	m_curenDevice.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+	uploadBatch->copyToBuffer(m_meshletBuffer->getBuffer(), 0, meshlets, bufferSize);
 }
 
 std::vector<VkVertexInputBindingDescription> Curen::CurenModel::Vertex::getBindingDescriptions()
@@ -195,3 +427,23 @@ std::vector<VkVertexInputAttributeDescription> Curen::CurenModel::Vertex::getAtt
 
 	return attributeDescriptions;
 }
+
+std::vector<VkVertexInputBindingDescription> Curen::CurenModel::CompactVertex::getBindingDescriptions()
+{
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+	bindingDescriptions[0].binding = 0;
+	bindingDescriptions[0].stride = sizeof(CompactVertex);
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> Curen::CurenModel::CompactVertex::getAttributeDescriptions()
+{
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+	attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactVertex, position) });
+	attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color) });
+	attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal) });
+	attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv) });
+
+	return attributeDescriptions;
+}
@@ -3,10 +3,13 @@
 #include "curen_device.hpp"
 #include "curen_utils.hpp"
 #include "curen_buffer.hpp"
+#include "curen_geometry_arena.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
 
 #include <vector>
 #include <cassert>
@@ -32,36 +35,165 @@ namespace Curen {
 			}
 		};
 
+		// 20 byte vertex for bandwidth bound scenes, see CurenVertexQuantizer
+		struct CompactVertex {
+			uint16_t position[4];	// R16G16B16A16_UNORM within the mesh bounds
+			uint32_t normal;		// octahedral R16G16_SNORM
+			uint32_t uv;			// R16G16_SFLOAT
+			uint32_t color;			// R8G8B8A8_UNORM
+
+			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+		};
+
+		enum class VertexLayout {
+			Full,
+			Compact
+		};
+
+		// Simplification stops before a level deviates more than this fraction of the mesh extent
+		static constexpr float LOD_MAX_ERROR = 0.05f;
+
+		// One level of detail, a range of the shared index buffer
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			// Largest surface deviation from level 0, in model space units
+			float error;
+		};
+
+		// A cluster of level 0 triangles that is culled as a whole, laid out for a std430 storage buffer
+		struct Meshlet {
+			// Model space, xyz is the center and w the radius
+			glm::vec4 boundingSphere;
+			glm::vec4 coneApex;
+			// Every triangle faces away from cameras with dot(normalize(coneApex - camera), axis) >= w, w of 1 disables the test
+			glm::vec4 coneAxisCutoff;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t vertexCount;
+			uint32_t padding;
+		};
+
+		struct ImportSettings;
+
 		struct Builder {
 			std::vector<Vertex> vertices{};
+			// All levels back to back, level 0 first
 			std::vector<uint32_t> indices{};
+			// Empty for a single level covering all indices
+			std::vector<Lod> lods{};
+			// Cover level 0 in index order, empty when the mesh is too small to be worth splitting
+			std::vector<Meshlet> meshlets{};
 
 			void loadModel(const std::string& filePath);
+			void loadModelTinyObj(const std::string& filePath);
+
+			// Reorders the level 0 triangles for the post-transform cache and overdraw, or only for the cache within each
+			// meshlet once there are meshlets, then the vertices for fetch locality. Runs after generateLods and buildMeshlets.
+			void optimize();
+			// Appends up to lodCount - 1 simplified levels, each with about half the triangles of the previous one
+			void generateLods(uint32_t lodCount);
+			// Reorders the level 0 triangles into meshlets, see CurenMeshletBuilder
+			void buildMeshlets();
+
+			// Copies everything out of a matching mesh cache, or imports the source file and writes the cache.
+			// Does not touch the device, so it is safe on worker threads.
+			void import(const std::string& filePath, const ImportSettings& importSettings);
+			// The cold path of import: parse, optimize, simplify, split into meshlets and write the cache
+			void importSource(const std::string& filePath, const ImportSettings& importSettings);
+		};
+
+		struct ImportSettings {
+			bool optimizeMesh = true;
+			// Only changes the GPU side buffers, the mesh cache always keeps full vertices
+			VertexLayout vertexLayout = VertexLayout::Full;
+			// Including level 0, 1 disables simplification
+			uint32_t lodCount = 4;
+			bool buildMeshlets = true;
+
+			// Everything that changes the imported buffers, a mesh cache is only reused when it matches
+			uint32_t getCacheKey() const { return (optimizeMesh ? 1u : 0u) | (buildMeshlets ? 2u : 0u) | (lodCount << 2); }
 		};
 
-		CurenModel(CurenDevice& curenDevice, const CurenModel::Builder& builder);
+		// Vertices and indices live in ranges of geometryArena, which has to outlive the model
+		// With an uploadBatch the copies are only recorded, the model may be drawn once the batch has completed
+		CurenModel(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const CurenModel::Builder& builder, VertexLayout vertexLayout = VertexLayout::Full,
+			CurenUploadBatch* uploadBatch = nullptr);
+		CurenModel(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+			VertexLayout vertexLayout = VertexLayout::Full, const Lod* lods = nullptr, uint32_t lodCount = 0,
+			const Meshlet* meshlets = nullptr, uint32_t meshletCount = 0, CurenUploadBatch* uploadBatch = nullptr);
 		~CurenModel();
 
 		CurenModel(const CurenModel&) = delete;
 		CurenModel& operator = (const CurenModel&) = delete;
 
-		static std::unique_ptr<CurenModel> createModelFromFile(CurenDevice& curenDevice, const std::string& filePath);
+		static std::unique_ptr<CurenModel> createModelFromFile(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const std::string& filePath);
+		static std::unique_ptr<CurenModel> createModelFromFile(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, const std::string& filePath,
+			const ImportSettings& importSettings);
 
+		// Binds the whole geometry arena, models sharing it only need one bind
 		void bind(VkCommandBuffer commandBuffer);
+		CurenGeometryArena& getGeometryArena() const { return m_geometryArena; }
+		int32_t getVertexOffset() const { return m_vertexOffset; }
 		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t lod);
+
+		uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+		const Lod& getLod(uint32_t lod) const { return m_lods[lod]; }
+		uint32_t getTriangleCount(uint32_t lod) const { return m_hasIndexBuffer ? m_lods[lod].indexCount / 3 : m_vertexCount / 3; }
+		// Model space bounding sphere, xyz is the center and w the radius
+		const glm::vec4& getBoundingSphere() const { return m_boundingSphere; }
+
+		uint32_t getMeshletCount() const { return m_meshletCount; }
+		// Storage buffer views for the meshlet culling pass, only valid when there are meshlets
+		VkDescriptorBufferInfo getMeshletBufferInfo() const { return m_meshletBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo getIndexBufferInfo() const { return m_geometryArena.getIndexBufferInfo(m_indexRange); }
+
+		// Device memory the model occupies in the arena and its meshlet buffer
+		VkDeviceSize getMemorySize() const { return m_vertexRange.size + m_indexRange.size + static_cast<VkDeviceSize>(m_meshletCount) * sizeof(Meshlet); }
+
+		VertexLayout getVertexLayout() const { return m_vertexLayout; }
+		// Maps the stored positions to model space, identity unless the layout is Compact
+		const glm::mat4& getDequantizationMatrix() const { return m_dequantizationMatrix; }
 
 	private:
 
-		void createVertexBuffer(const std::vector<Vertex>& vertices);
-		void createIndexBuffer(const std::vector<uint32_t>& indices);
+		void createVertexBuffer(const Vertex* vertices, uint32_t vertexCount, CurenUploadBatch* uploadBatch);
+		void uploadVertexBuffer(const void* vertexData, uint32_t vertexSize, uint32_t vertexCount, CurenUploadBatch* uploadBatch);
+		void createIndexBuffer(const uint32_t* indices, uint32_t indexCount, CurenUploadBatch* uploadBatch);
+		void createMeshletBuffer(const Meshlet* meshlets, uint32_t meshletCount, CurenUploadBatch* uploadBatch);
+		void computeBoundingSphere(const Vertex* vertices, uint32_t vertexCount);
 
 		CurenDevice& m_curenDevice;
+		CurenGeometryArena& m_geometryArena;
 
-		std::unique_ptr<CurenBuffer> m_vertexBuffer;
+		VertexLayout m_vertexLayout;
+		glm::mat4 m_dequantizationMatrix{ 1.0f };
+		CurenGeometryArena::Range m_vertexRange{};
+		int32_t m_vertexOffset = 0;
 		uint32_t m_vertexCount;
 
 		bool m_hasIndexBuffer = false;
-		std::unique_ptr<CurenBuffer> m_indexBuffer;
+		CurenGeometryArena::Range m_indexRange{};
+		uint32_t m_firstIndex = 0;
 		uint32_t m_indexCount;
+
+		std::unique_ptr<CurenBuffer> m_meshletBuffer;
+		uint32_t m_meshletCount = 0;
+
+		std::vector<Lod> m_lods;
+		glm::vec4 m_boundingSphere{ 0.f };
+	};
+}
+
+namespace std {
+	template <>
+	struct hash<Curen::CurenModel::Vertex> {
+		size_t operator()(Curen::CurenModel::Vertex const& vertex) const {
+			size_t seed = 0;
+			Utils::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+			return seed;
+		}
 	};
 }
\ No newline at end of file
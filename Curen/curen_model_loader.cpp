@@ -0,0 +1,189 @@
+#include "curen_model_loader.hpp"
+#include "curen_thread_pool.hpp"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+using namespace Curen;
+
+CurenModelLoader::CurenModelLoader(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, CurenModelRegistry& modelRegistry) :
+	m_curenDevice{ curenDevice }, m_geometryArena{ geometryArena }, m_modelRegistry{ modelRegistry }
+{
+}
+
+CurenModelLoader::~CurenModelLoader()
+{
+	for (auto& pendingImport : m_pendingImports) {
+		if (pendingImport.builder.valid()) {
+			pendingImport.builder.wait();
+		}
+	}
+	// The copies may still be writing into the arena ranges the models give back when they are destroyed
+	for (auto& pendingUpload : m_pendingUploads) {
+		if (pendingUpload.uploadBatch->isSubmitted()) {
+			pendingUpload.uploadBatch->wait();
+		}
+	}
+	m_pendingUploads.clear();
+}
+
+uint32_t CurenModelLoader::getDeferredCount() const
+{
+	uint32_t deferredCount = 0;
+	for (auto& pendingImport : m_pendingImports) {
+		deferredCount += pendingImport.isDeferred ? 1 : 0;
+	}
+	return deferredCount;
+}
+
+void CurenModelLoader::loadModel(CurenObject::id_t objectId, const std::string& filePath)
+{
+	loadModel(objectId, filePath, CurenModel::ImportSettings{});
+}
+
+void CurenModelLoader::loadModel(CurenObject::id_t objectId, const std::string& filePath, const CurenModel::ImportSettings& importSettings)
+{
+	if (auto model = m_modelRegistry.findModel(filePath, importSettings)) {
+		m_residentModels.push_back(ResidentModel{ std::move(model), objectId });
+		return;
+	}
+
+	for (auto& pendingImport : m_pendingImports) {
+		if (pendingImport.filePath == filePath &&
+			pendingImport.importSettings.getCacheKey() == importSettings.getCacheKey() &&
+			pendingImport.importSettings.vertexLayout == importSettings.vertexLayout) {
+			pendingImport.objectIds.push_back(objectId);
+			return;
+		}
+	}
+
+	PendingImport pendingImport{};
+	pendingImport.filePath = filePath;
+	pendingImport.importSettings = importSettings;
+	pendingImport.objectIds.push_back(objectId);
+	pendingImport.builder = CurenThreadPool::shared().submit([filePath, importSettings]() {
+		CurenModel::Builder builder{};
+		builder.import(filePath, importSettings);
+		return builder;
+	});
+	m_pendingImports.push_back(std::move(pendingImport));
+}
+
+void CurenModelLoader::update(CurenObject::Map& objects)
+{
+	publishUploads(objects);
+	uploadImports();
+}
+
+void CurenModelLoader::publishUploads(CurenObject::Map& objects)
+{
+	for (auto& residentModel : m_residentModels) {
+		auto object = objects.find(residentModel.objectId);
+		if (object != objects.end()) {
+			object->second.model = std::move(residentModel.model);
+		}
+	}
+	m_residentModels.clear();
+
+	for (auto pendingUpload = m_pendingUploads.begin(); pendingUpload != m_pendingUploads.end();) {
+		if (!pendingUpload->uploadBatch->isComplete()) {
+			++pendingUpload;
+			continue;
+		}
+
+		for (auto& uploadedModel : pendingUpload->models) {
+			std::shared_ptr<CurenModel> model = m_modelRegistry.addModel(uploadedModel.filePath, uploadedModel.importSettings, std::move(uploadedModel.model));
+			// Objects removed while their model was loading are simply left out. Every object after the first
+			// goes through the registry again so it is counted as a shared request.
+			bool isFirstObject = true;
+			for (CurenObject::id_t objectId : uploadedModel.objectIds) {
+				auto object = objects.find(objectId);
+				if (object == objects.end()) {
+					continue;
+				}
+				object->second.model = isFirstObject ? model : m_modelRegistry.findModel(uploadedModel.filePath, uploadedModel.importSettings);
+				isFirstObject = false;
+			}
+		}
+		pendingUpload = m_pendingUploads.erase(pendingUpload);
+	}
+}
+
+void CurenModelLoader::uploadImports()
+{
+	// Every import that finished since the last frame goes into one batch and one submission
+	PendingUpload pendingUpload{};
+	const MemoryBudget& memoryBudget = m_curenDevice.memoryBudget();
+	VkDeviceSize admittedSize = 0;
+	for (auto pendingImport = m_pendingImports.begin(); pendingImport != m_pendingImports.end();) {
+		if (pendingImport->importedBuilder == nullptr) {
+			if (pendingImport->builder.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++pendingImport;
+				continue;
+			}
+			try {
+				pendingImport->importedBuilder = std::make_unique<CurenModel::Builder>(pendingImport->builder.get());
+			}
+			catch (const std::exception& exception) {
+				std::cout << "model " << pendingImport->filePath << ": " << exception.what() << std::endl;
+				pendingImport = m_pendingImports.erase(pendingImport);
+				continue;
+			}
+		}
+
+		const CurenModel::Builder& builder = *pendingImport->importedBuilder;
+		uint32_t vertexSize = pendingImport->importSettings.vertexLayout == CurenModel::VertexLayout::Compact ?
+			sizeof(CurenModel::CompactVertex) : sizeof(CurenModel::Vertex);
+		uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		uint32_t indexCount = static_cast<uint32_t>(builder.indices.size());
+		VkDeviceSize vertexBytes = static_cast<VkDeviceSize>(vertexSize) * vertexCount;
+		VkDeviceSize indexBytes = static_cast<VkDeviceSize>(sizeof(uint32_t)) * indexCount;
+
+		// Waiting would never help a model larger than a whole pool
+		if (vertexBytes > m_geometryArena.getVertexStatistics().capacity || indexBytes > m_geometryArena.getIndexStatistics().capacity) {
+			std::cout << "model " << pendingImport->filePath << ": " << vertexBytes / 1024 << " KB of vertices and " << indexBytes / 1024
+				<< " KB of indices do not fit into the geometry arena" << std::endl;
+			pendingImport = m_pendingImports.erase(pendingImport);
+			continue;
+		}
+
+		// Vertices and indices go into the arena, whose ranges are taken right away, so the imports admitted earlier
+		// this frame are already accounted for. Only the meshlet buffer is a device allocation of its own, and the
+		// budget snapshot is from the start of the frame, so the meshlets admitted since count against it too.
+		VkDeviceSize meshletBytes = builder.meshlets.size() * sizeof(CurenModel::Meshlet);
+		bool hasArenaRoom = m_geometryArena.hasRoomFor(vertexSize, vertexCount, indexCount);
+		if (!hasArenaRoom || !memoryBudget.hasRoomFor(admittedSize + meshletBytes)) {
+			if (!pendingImport->isDeferred) {
+				std::cout << "model " << pendingImport->filePath << ": deferred, " << (hasArenaRoom ?
+					std::to_string(meshletBytes / 1024) + " KB of meshlets would exceed the memory budget" :
+					std::to_string((vertexBytes + indexBytes) / 1024) + " KB do not fit into the free geometry arena blocks") << std::endl;
+				pendingImport->isDeferred = true;
+			}
+			++pendingImport;
+			continue;
+		}
+		admittedSize += meshletBytes;
+
+		try {
+			if (pendingUpload.uploadBatch == nullptr) {
+				pendingUpload.uploadBatch = std::make_unique<CurenUploadBatch>(m_curenDevice);
+			}
+			auto model = std::make_unique<CurenModel>(m_curenDevice, m_geometryArena, builder, pendingImport->importSettings.vertexLayout,
+				pendingUpload.uploadBatch.get());
+			pendingUpload.models.push_back(UploadedModel{ pendingImport->filePath, pendingImport->importSettings, std::move(model),
+				std::move(pendingImport->objectIds) });
+		}
+		catch (const std::exception& exception) {
+			std::cout << "model " << pendingImport->filePath << ": " << exception.what() << std::endl;
+		}
+		pendingImport = m_pendingImports.erase(pendingImport);
+	}
+
+	if (pendingUpload.uploadBatch == nullptr) {
+		return;
+	}
+	pendingUpload.uploadBatch->submit();
+	m_pendingUploads.push_back(std::move(pendingUpload));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_model.hpp"
+#include "curen_model_registry.hpp"
+#include "curen_object.hpp"
+#include "curen_upload_batch.hpp"
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Curen {
+
+	// Streams models in without stalling the render loop. Files are imported on the shared thread pool, the
+	// results are uploaded in fenced batches and a model is only published into its objects once its batch has
+	// completed. Until then the objects keep a null model and are skipped by the render systems.
+	// Published models are shared through the registry, so a file already resident is never loaded again.
+	// Imports that do not fit into the free blocks of the geometry arena, or whose meshlets would push the device
+	// past its memory budget, wait until there is room again instead of failing their allocations.
+	class CurenModelLoader {
+	public:
+		CurenModelLoader(CurenDevice& curenDevice, CurenGeometryArena& geometryArena, CurenModelRegistry& modelRegistry);
+		// Waits for outstanding imports and uploads
+		~CurenModelLoader();
+
+		CurenModelLoader(const CurenModelLoader&) = delete;
+		CurenModelLoader& operator = (const CurenModelLoader&) = delete;
+
+		// Objects asking for the same file with the same settings while it is still loading share one import,
+		// a resident model is handed out on the next update
+		void loadModel(CurenObject::id_t objectId, const std::string& filePath);
+		void loadModel(CurenObject::id_t objectId, const std::string& filePath, const CurenModel::ImportSettings& importSettings);
+
+		// Called once per frame on the render thread, never waits on a worker or a fence
+		void update(CurenObject::Map& objects);
+
+		// Imports, uploads and resident models not handed out yet
+		uint32_t getPendingCount() const { return static_cast<uint32_t>(m_pendingImports.size() + m_pendingUploads.size() + m_residentModels.size()); }
+		// Imported, but waiting for memory budget
+		uint32_t getDeferredCount() const;
+
+	private:
+		struct PendingImport {
+			std::string filePath;
+			CurenModel::ImportSettings importSettings;
+			std::vector<CurenObject::id_t> objectIds;
+			std::future<CurenModel::Builder> builder;
+			// Taken out of the future once it is ready, kept while the import waits for memory budget
+			std::unique_ptr<CurenModel::Builder> importedBuilder;
+			bool isDeferred = false;
+		};
+
+		struct UploadedModel {
+			std::string filePath;
+			CurenModel::ImportSettings importSettings;
+			std::unique_ptr<CurenModel> model;
+			std::vector<CurenObject::id_t> objectIds;
+		};
+
+		struct ResidentModel {
+			std::shared_ptr<CurenModel> model;
+			CurenObject::id_t objectId;
+		};
+
+		struct PendingUpload {
+			std::vector<UploadedModel> models;
+			// Waited on by ~CurenModelLoader before the models release their arena ranges
+			std::unique_ptr<CurenUploadBatch> uploadBatch;
+		};
+
+		void publishUploads(CurenObject::Map& objects);
+		void uploadImports();
+
+		CurenDevice& m_curenDevice;
+		CurenGeometryArena& m_geometryArena;
+		CurenModelRegistry& m_modelRegistry;
+
+		std::vector<ResidentModel> m_residentModels;
+		std::vector<PendingImport> m_pendingImports;
+		std::vector<PendingUpload> m_pendingUploads;
+	};
+}
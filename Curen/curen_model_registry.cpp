@@ -0,0 +1,128 @@
+#include "curen_model_registry.hpp"
+#include "curen_swap_chain.hpp"
+
+#include <utility>
+
+using namespace Curen;
+
+CurenModelRegistry::CurenModelRegistry(CurenDevice& curenDevice, CurenGeometryArena& geometryArena) :
+	m_curenDevice{ curenDevice }, m_geometryArena{ geometryArena }
+{
+}
+
+CurenModelRegistry::~CurenModelRegistry()
+{
+	for (auto& retiredModel : m_retiredModels) {
+		delete retiredModel.model;
+	}
+}
+
+std::shared_ptr<CurenModel> CurenModelRegistry::loadModel(const std::string& filePath)
+{
+	return loadModel(filePath, CurenModel::ImportSettings{});
+}
+
+std::shared_ptr<CurenModel> CurenModelRegistry::loadModel(const std::string& filePath, const CurenModel::ImportSettings& importSettings)
+{
+	if (auto model = findModel(filePath, importSettings)) {
+		return model;
+	}
+	return addModel(filePath, importSettings, CurenModel::createModelFromFile(m_curenDevice, m_geometryArena, filePath, importSettings));
+}
+
+std::shared_ptr<CurenModel> CurenModelRegistry::findModel(const std::string& filePath, const CurenModel::ImportSettings& importSettings)
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return findResident(makeKey(filePath, importSettings));
+}
+
+std::shared_ptr<CurenModel> CurenModelRegistry::addModel(const std::string& filePath, const CurenModel::ImportSettings& importSettings,
+	std::unique_ptr<CurenModel> model)
+{
+	std::string key = makeKey(filePath, importSettings);
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	// Someone else finished the same load first, theirs wins and this copy was never drawn
+	if (auto resident = findResident(key)) {
+		return resident;
+	}
+
+	m_requestCount++;
+	m_loadCount++;
+	std::shared_ptr<CurenModel> handle{ model.release(), [this, key](CurenModel* retiredModel) { retire(key, retiredModel); } };
+	m_models[key] = handle;
+	return handle;
+}
+
+void CurenModelRegistry::collectGarbage()
+{
+	std::vector<CurenModel*> destroyedModels{};
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_frameCount++;
+		for (auto retiredModel = m_retiredModels.begin(); retiredModel != m_retiredModels.end();) {
+			if (retiredModel->retireFrame + CurenSwapChain::MAX_FRAMES_IN_FLIGHT <= m_frameCount) {
+				destroyedModels.push_back(retiredModel->model);
+				retiredModel = m_retiredModels.erase(retiredModel);
+			}
+			else {
+				++retiredModel;
+			}
+		}
+	}
+	for (CurenModel* model : destroyedModels) {
+		delete model;
+	}
+}
+
+CurenModelRegistry::Statistics CurenModelRegistry::getStatistics() const
+{
+	// Declared before the lock and released after it: if one of these becomes the last handle, its deleter retires the
+	// model, which takes m_mutex again
+	std::vector<std::shared_ptr<CurenModel>> residentModels{};
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	Statistics statistics{};
+	residentModels.reserve(m_models.size());
+	for (auto& kv : m_models) {
+		if (auto model = kv.second.lock()) {
+			statistics.residentModelCount++;
+			statistics.residentSize += model->getMemorySize();
+			residentModels.push_back(std::move(model));
+		}
+	}
+	statistics.retiredModelCount = static_cast<uint32_t>(m_retiredModels.size());
+	statistics.requestCount = m_requestCount;
+	statistics.loadCount = m_loadCount;
+	statistics.savedSize = m_savedSize;
+	return statistics;
+}
+
+std::string CurenModelRegistry::makeKey(const std::string& filePath, const CurenModel::ImportSettings& importSettings)
+{
+	// The vertex layout is not part of the cache key but changes the uploaded buffers
+	return filePath + "|" + std::to_string(importSettings.getCacheKey()) + "|" + std::to_string(static_cast<int>(importSettings.vertexLayout));
+}
+
+std::shared_ptr<CurenModel> CurenModelRegistry::findResident(const std::string& key)
+{
+	auto entry = m_models.find(key);
+	if (entry == m_models.end()) {
+		return nullptr;
+	}
+	std::shared_ptr<CurenModel> model = entry->second.lock();
+	if (model) {
+		m_requestCount++;
+		m_savedSize += model->getMemorySize();
+	}
+	return model;
+}
+
+void CurenModelRegistry::retire(const std::string& key, CurenModel* model)
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	// A newer model may already sit under the key if the old one expired before this ran
+	auto entry = m_models.find(key);
+	if (entry != m_models.end() && entry->second.expired()) {
+		m_models.erase(entry);
+	}
+	m_retiredModels.push_back(RetiredModel{ model, m_frameCount });
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_model.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Curen {
+
+	// Hands out one shared CurenModel per file and import settings. The registry only keeps weak references, a model
+	// lives as long as some object holds it. When the last handle drops the model is retired and destroyed
+	// MAX_FRAMES_IN_FLIGHT frames later, once no command buffer in flight can still read its geometry.
+	// Every handle has to be released before the registry is destroyed.
+	class CurenModelRegistry {
+	public:
+		struct Statistics {
+			uint32_t residentModelCount;
+			uint32_t retiredModelCount;
+			// Requests served, loads are the ones that had to import and upload
+			uint64_t requestCount;
+			uint64_t loadCount;
+			VkDeviceSize residentSize;
+			// Memory the requests served from a resident model would have taken as separate uploads
+			VkDeviceSize savedSize;
+		};
+
+		CurenModelRegistry(CurenDevice& curenDevice, CurenGeometryArena& geometryArena);
+		// Destroys retired models right away, the device has to be idle
+		~CurenModelRegistry();
+
+		CurenModelRegistry(const CurenModelRegistry&) = delete;
+		CurenModelRegistry& operator = (const CurenModelRegistry&) = delete;
+
+		// Resident model or a blocking load through CurenModel::createModelFromFile
+		std::shared_ptr<CurenModel> loadModel(const std::string& filePath);
+		std::shared_ptr<CurenModel> loadModel(const std::string& filePath, const CurenModel::ImportSettings& importSettings);
+		// Null when the model is not resident, counts as a served request otherwise
+		std::shared_ptr<CurenModel> findModel(const std::string& filePath, const CurenModel::ImportSettings& importSettings);
+		// Takes ownership of a model loaded elsewhere, such as by CurenModelLoader
+		std::shared_ptr<CurenModel> addModel(const std::string& filePath, const CurenModel::ImportSettings& importSettings, std::unique_ptr<CurenModel> model);
+
+		// Called once per frame after its fence was waited on, destroys the models that are no longer in flight
+		void collectGarbage();
+
+		Statistics getStatistics() const;
+
+	private:
+		struct RetiredModel {
+			CurenModel* model;
+			uint64_t retireFrame;
+		};
+
+		static std::string makeKey(const std::string& filePath, const CurenModel::ImportSettings& importSettings);
+		std::shared_ptr<CurenModel> findResident(const std::string& key);
+		void retire(const std::string& key, CurenModel* model);
+
+		CurenDevice& m_curenDevice;
+		CurenGeometryArena& m_geometryArena;
+
+		// Guards everything below, handles may be released on any thread
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, std::weak_ptr<CurenModel>> m_models;
+		std::vector<RetiredModel> m_retiredModels;
+		uint64_t m_frameCount = 0;
+		uint64_t m_requestCount = 0;
+		uint64_t m_loadCount = 0;
+		VkDeviceSize m_savedSize = 0;
+	};
+}
@@ -0,0 +1,556 @@
+#include "curen_obj_parser.hpp"
+#include "curen_mapped_file.hpp"
+#include "curen_thread_pool.hpp"
+#include "curen_vertex_welder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace Curen;
+
+namespace {
+	constexpr std::size_t MIN_CHUNK_SIZE = 256 * 1024;
+	constexpr uint32_t RELATIVE_VERTEX = 1 << 0;
+	constexpr uint32_t RELATIVE_TEXCOORD = 1 << 1;
+	constexpr uint32_t RELATIVE_NORMAL = 1 << 2;
+
+	bool isSpace(char c) { return c == ' ' || c == '\t'; }
+	bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	const char* skipSpaces(const char* token, const char* lineEnd) {
+		while (token < lineEnd && isSpace(*token)) {
+			token++;
+		}
+		return token;
+	}
+
+	const char* findTokenEnd(const char* token, const char* lineEnd, bool stopAtSlash) {
+		while (token < lineEnd && !isSpace(*token) && *token != '\r' && !(stopAtSlash && *token == '/')) {
+			token++;
+		}
+		return token;
+	}
+
+	// Port of tinyobjloader's tryParseDouble, the numbers have to round the same way for the output to match
+	bool tryParseDouble(const char* s, const char* sEnd, double* result) {
+		if (s >= sEnd) {
+			return false;
+		}
+
+		double mantissa = 0.0;
+		int exponent = 0;
+		char sign = '+';
+		char exponentSign = '+';
+		const char* current = s;
+		int read = 0;
+		bool endNotReached = false;
+		bool leadingDecimalDots = false;
+
+		if (*current == '+' || *current == '-') {
+			sign = *current;
+			current++;
+			if (current != sEnd && *current == '.') {
+				leadingDecimalDots = true;
+			}
+		}
+		else if (*current == '.') {
+			leadingDecimalDots = true;
+		}
+		else if (!isDigit(*current)) {
+			return false;
+		}
+
+		endNotReached = (current != sEnd);
+		if (!leadingDecimalDots) {
+			while (endNotReached && isDigit(*current)) {
+				mantissa *= 10;
+				mantissa += static_cast<int>(*current - '0');
+				current++;
+				read++;
+				endNotReached = (current != sEnd);
+			}
+			if (read == 0) {
+				return false;
+			}
+		}
+
+		if (endNotReached) {
+			if (*current == '.') {
+				static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+				const int lutEntries = sizeof(powLut) / sizeof(powLut[0]);
+
+				current++;
+				read = 1;
+				endNotReached = (current != sEnd);
+				while (endNotReached && isDigit(*current)) {
+					mantissa += static_cast<int>(*current - '0') * (read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+					read++;
+					current++;
+					endNotReached = (current != sEnd);
+				}
+			}
+			else if (*current != 'e' && *current != 'E') {
+				endNotReached = false;
+			}
+		}
+
+		if (endNotReached && (*current == 'e' || *current == 'E')) {
+			current++;
+			endNotReached = (current != sEnd);
+			if (endNotReached && (*current == '+' || *current == '-')) {
+				exponentSign = *current;
+				current++;
+			}
+			else if (!endNotReached || !isDigit(*current)) {
+				return false;
+			}
+
+			read = 0;
+			endNotReached = (current != sEnd);
+			while (endNotReached && isDigit(*current)) {
+				if (exponent > std::numeric_limits<int>::max() / 10) {
+					return false;
+				}
+				exponent *= 10;
+				exponent += static_cast<int>(*current - '0');
+				current++;
+				read++;
+				endNotReached = (current != sEnd);
+			}
+			exponent *= (exponentSign == '+' ? 1 : -1);
+			if (read == 0) {
+				return false;
+			}
+		}
+
+		*result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+		return true;
+	}
+
+	bool parseReal(const char*& token, const char* lineEnd, float* value) {
+		token = skipSpaces(token, lineEnd);
+		const char* end = findTokenEnd(token, lineEnd, false);
+		double parsed = 0.0;
+		bool hasValue = tryParseDouble(token, end, &parsed);
+		if (hasValue) {
+			*value = static_cast<float>(parsed);
+		}
+		token = end;
+		return hasValue;
+	}
+
+	float parseReal(const char*& token, const char* lineEnd, double defaultValue = 0.0) {
+		token = skipSpaces(token, lineEnd);
+		const char* end = findTokenEnd(token, lineEnd, false);
+		double parsed = defaultValue;
+		tryParseDouble(token, end, &parsed);
+		token = end;
+		return static_cast<float>(parsed);
+	}
+
+	// atoi on a token that is not NUL terminated
+	int parseInt(const char* token, const char* lineEnd) {
+		bool isNegative = false;
+		if (token < lineEnd && (*token == '-' || *token == '+')) {
+			isNegative = *token == '-';
+			token++;
+		}
+		int value = 0;
+		while (token < lineEnd && isDigit(*token)) {
+			value = value * 10 + (*token - '0');
+			token++;
+		}
+		return isNegative ? -value : value;
+	}
+
+	// Counts the corners of every face line the way parseChunk does. Stops early once another chunk found a polygon.
+	bool hasPolygons(const char* lineBegin, const char* chunkEnd, const std::atomic<bool>& isPolygonFound) {
+		while (lineBegin < chunkEnd && !isPolygonFound.load(std::memory_order_relaxed)) {
+			const char* lineEnd = static_cast<const char*>(std::memchr(lineBegin, '\n', chunkEnd - lineBegin));
+			if (lineEnd == nullptr) {
+				lineEnd = chunkEnd;
+			}
+			const char* token = skipSpaces(lineBegin, lineEnd);
+			lineBegin = lineEnd + 1;
+			if (lineEnd - token < 2 || token[0] != 'f' || !isSpace(token[1])) {
+				continue;
+			}
+
+			uint32_t cornerCount = 0;
+			token = skipSpaces(token + 2, lineEnd);
+			while (token < lineEnd && *token != '\r') {
+				cornerCount++;
+				token = findTokenEnd(token, lineEnd, false);
+				while (token < lineEnd && (isSpace(*token) || *token == '\r')) {
+					token++;
+				}
+			}
+			if (cornerCount > 4) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Same rules as tinyobjloader's fixIndex, negative indices are kept chunk relative and resolved later
+	bool fixIndex(int index, std::size_t localCount, bool allowZero, int32_t& result, bool& isRelative) {
+		isRelative = false;
+		if (index > 0) {
+			result = index - 1;
+			return true;
+		}
+		if (index == 0) {
+			result = -1;
+			return allowZero;
+		}
+		result = static_cast<int32_t>(localCount) + index;
+		isRelative = true;
+		return true;
+	}
+}
+
+std::size_t CurenObjParser::parse(const std::string& filePath, std::vector<CurenModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	CurenMappedFile file{ filePath };
+	if (!file.isOpen()) {
+		throw std::runtime_error("Failed to open the file : " + filePath);
+	}
+
+	CurenThreadPool& threadPool = CurenThreadPool::shared();
+
+	// Split into line aligned chunks
+	const char* fileBegin = file.data();
+	const char* fileEnd = file.data() + file.size();
+	std::size_t chunkCount = std::max<std::size_t>(1, std::min<std::size_t>(threadPool.getThreadCount() * 4, file.size() / MIN_CHUNK_SIZE));
+
+	std::vector<Chunk> chunks(chunkCount);
+	const char* chunkBegin = fileBegin;
+	for (std::size_t i = 0; i < chunkCount; i++) {
+		const char* chunkEnd = (i + 1 == chunkCount) ? fileEnd : std::max(chunkBegin, fileBegin + file.size() * (i + 1) / chunkCount);
+		while (chunkEnd < fileEnd && chunkEnd[-1] != '\n') {
+			chunkEnd++;
+		}
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	// Polygons are left to tinyobjloader. Found by a scan of the face lines before anything is parsed, so such a file
+	// is only parsed once, by tinyobjloader.
+	std::atomic<bool> isPolygonFound{ false };
+	threadPool.parallelFor(chunkCount, [&chunks, &isPolygonFound](std::size_t i) {
+		if (hasPolygons(chunks[i].begin, chunks[i].end, isPolygonFound)) {
+			isPolygonFound.store(true, std::memory_order_relaxed);
+		}
+	});
+	if (isPolygonFound.load()) {
+		return 0;
+	}
+
+	threadPool.parallelFor(chunkCount, [&chunks](std::size_t i) { parseChunk(chunks[i]); });
+	// The scan and parseChunk count corners the same way, this only guards against them drifting apart
+	for (const auto& chunk : chunks) {
+		if (chunk.hasPolygons) {
+			return 0;
+		}
+	}
+
+	std::size_t vertexTotal = 0, normalTotal = 0, texcoordTotal = 0, cornerTotal = 0;
+	for (auto& chunk : chunks) {
+		chunk.vertexBase = vertexTotal;
+		chunk.normalBase = normalTotal;
+		chunk.texcoordBase = texcoordTotal;
+		chunk.cornerBase = cornerTotal;
+		vertexTotal += chunk.positions.size() / 3;
+		normalTotal += chunk.normals.size() / 3;
+		texcoordTotal += chunk.texcoords.size() / 2;
+		cornerTotal += chunk.cornerCount;
+	}
+	if (cornerTotal > std::numeric_limits<uint32_t>::max()) {
+		throw std::runtime_error("model has too many corners for 32 bit indices: " + filePath);
+	}
+
+	std::vector<float> positions(vertexTotal * 3), colors(vertexTotal * 3), normals(normalTotal * 3), texcoords(texcoordTotal * 2);
+	threadPool.parallelFor(chunkCount, [&](std::size_t i) {
+		const Chunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.vertexBase * 3);
+		std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + chunk.vertexBase * 3);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase * 3);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordBase * 2);
+	});
+
+	// Resolve indices, triangulate and build one vertex per corner, bucketed by hash for the weld
+	std::size_t partitionCount = threadPool.getThreadCount();
+	std::vector<CurenModel::Vertex> corners(cornerTotal);
+	// Kept for the weld, so every corner is hashed once
+	std::vector<uint64_t> cornerHashes(cornerTotal);
+
+	threadPool.parallelFor(chunkCount, [&](std::size_t chunkIndex) {
+		Chunk& chunk = chunks[chunkIndex];
+		chunk.partitionCorners.resize(partitionCount);
+		for (auto& partition : chunk.partitionCorners) {
+			partition.reserve(chunk.cornerCount / partitionCount + 16);
+		}
+
+		auto resolve = [&](ObjIndex index) {
+			if (index.relativeMask & RELATIVE_VERTEX) index.vertex += static_cast<int32_t>(chunk.vertexBase);
+			if (index.relativeMask & RELATIVE_TEXCOORD) index.texcoord += static_cast<int32_t>(chunk.texcoordBase);
+			if (index.relativeMask & RELATIVE_NORMAL) index.normal += static_cast<int32_t>(chunk.normalBase);
+
+			if ((index.relativeMask & RELATIVE_VERTEX && index.vertex < 0) || index.vertex >= static_cast<int64_t>(vertexTotal) ||
+				(index.relativeMask & RELATIVE_TEXCOORD && index.texcoord < 0) || index.texcoord >= static_cast<int64_t>(texcoordTotal) ||
+				(index.relativeMask & RELATIVE_NORMAL && index.normal < 0) || index.normal >= static_cast<int64_t>(normalTotal)) {
+				throw std::runtime_error("face index out of range in " + filePath);
+			}
+			return index;
+		};
+
+		std::size_t cornerIndex = chunk.cornerBase;
+		auto emitCorner = [&](const ObjIndex& index) {
+			CurenModel::Vertex& vertex = corners[cornerIndex];
+			if (index.vertex >= 0) {
+				vertex.position = { positions[3 * index.vertex + 0], positions[3 * index.vertex + 1], positions[3 * index.vertex + 2] };
+				vertex.color = { colors[3 * index.vertex + 0], colors[3 * index.vertex + 1], colors[3 * index.vertex + 2] };
+			}
+			if (index.normal >= 0) {
+				vertex.normal = { normals[3 * index.normal + 0], normals[3 * index.normal + 1], normals[3 * index.normal + 2] };
+			}
+			if (index.texcoord >= 0) {
+				vertex.uv = { texcoords[2 * index.texcoord + 0], texcoords[2 * index.texcoord + 1] };
+			}
+
+			uint64_t hash = CurenVertexWelder<CurenModel::Vertex>::hash(vertex);
+			cornerHashes[cornerIndex] = hash;
+			chunk.partitionCorners[(hash >> 32) % partitionCount].push_back(static_cast<uint32_t>(cornerIndex));
+			cornerIndex++;
+		};
+
+		std::size_t faceStart = 0;
+		for (uint32_t faceSize : chunk.faceSizes) {
+			const ObjIndex* face = &chunk.faceIndices[faceStart];
+			faceStart += faceSize;
+			if (faceSize < 3) {
+				continue;
+			}
+
+			ObjIndex i0 = resolve(face[0]);
+			if (faceSize == 3) {
+				emitCorner(i0);
+				emitCorner(resolve(face[1]));
+				emitCorner(resolve(face[2]));
+			}
+			else {
+				// Split along the shorter diagonal, like tinyobjloader
+				ObjIndex i1 = resolve(face[1]), i2 = resolve(face[2]), i3 = resolve(face[3]);
+				if (i0.vertex < 0 || i1.vertex < 0 || i2.vertex < 0 || i3.vertex < 0) {
+					throw std::runtime_error("face without vertex index in " + filePath);
+				}
+				const float* v0 = &positions[3 * i0.vertex];
+				const float* v1 = &positions[3 * i1.vertex];
+				const float* v2 = &positions[3 * i2.vertex];
+				const float* v3 = &positions[3 * i3.vertex];
+				float e02x = v2[0] - v0[0], e02y = v2[1] - v0[1], e02z = v2[2] - v0[2];
+				float e13x = v3[0] - v1[0], e13y = v3[1] - v1[1], e13z = v3[2] - v1[2];
+				float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+				float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+				if (sqr02 < sqr13) {
+					emitCorner(i0); emitCorner(i1); emitCorner(i2);
+					emitCorner(i0); emitCorner(i2); emitCorner(i3);
+				}
+				else {
+					emitCorner(i0); emitCorner(i1); emitCorner(i3);
+					emitCorner(i1); emitCorner(i2); emitCorner(i3);
+				}
+			}
+		}
+
+		chunk.faceIndices = {};
+		chunk.faceSizes = {};
+	});
+
+	// Each partition owns a disjoint set of vertex values, walking the chunks in order keeps first occurrences stable
+	std::vector<uint32_t> firstCorner(cornerTotal);
+	threadPool.parallelFor(partitionCount, [&](std::size_t partition) {
+		std::size_t partitionSize = 0;
+		for (const auto& chunk : chunks) {
+			partitionSize += chunk.partitionCorners[partition].size();
+		}
+
+		CurenVertexWelder<CurenModel::Vertex> welder{ partitionSize };
+		std::vector<uint32_t> welderFirstCorner{};
+		for (const auto& chunk : chunks) {
+			for (uint32_t corner : chunk.partitionCorners[partition]) {
+				uint32_t id = welder.weld(corners[corner], cornerHashes[corner]);
+				if (id == welderFirstCorner.size()) {
+					welderFirstCorner.push_back(corner);
+				}
+				firstCorner[corner] = welderFirstCorner[id];
+			}
+		}
+	});
+
+	// Number the unique vertices in order of first appearance, exactly like the serial loop
+	threadPool.parallelFor(chunkCount, [&](std::size_t i) {
+		Chunk& chunk = chunks[i];
+		chunk.partitionCorners = {};
+		for (std::size_t corner = chunk.cornerBase; corner < chunk.cornerBase + chunk.cornerCount; corner++) {
+			chunk.weldedCount += firstCorner[corner] == corner;
+		}
+	});
+
+	std::vector<std::size_t> weldedBase(chunkCount);
+	std::size_t weldedTotal = 0;
+	for (std::size_t i = 0; i < chunkCount; i++) {
+		weldedBase[i] = weldedTotal;
+		weldedTotal += chunks[i].weldedCount;
+	}
+
+	vertices.clear();
+	vertices.resize(weldedTotal);
+	indices.clear();
+	indices.resize(cornerTotal);
+
+	threadPool.parallelFor(chunkCount, [&](std::size_t i) {
+		const Chunk& chunk = chunks[i];
+		uint32_t nextVertex = static_cast<uint32_t>(weldedBase[i]);
+		for (std::size_t corner = chunk.cornerBase; corner < chunk.cornerBase + chunk.cornerCount; corner++) {
+			if (firstCorner[corner] == corner) {
+				vertices[nextVertex] = corners[corner];
+				indices[corner] = nextVertex++;
+			}
+		}
+	});
+
+	threadPool.parallelFor(chunkCount, [&](std::size_t i) {
+		const Chunk& chunk = chunks[i];
+		for (std::size_t corner = chunk.cornerBase; corner < chunk.cornerBase + chunk.cornerCount; corner++) {
+			if (firstCorner[corner] != corner) {
+				indices[corner] = indices[firstCorner[corner]];
+			}
+		}
+	});
+
+	return file.size();
+}
+
+void CurenObjParser::parseChunk(Chunk& chunk)
+{
+	const char* lineBegin = chunk.begin;
+	while (lineBegin < chunk.end) {
+		const char* lineEnd = lineBegin;
+		while (lineEnd < chunk.end && *lineEnd != '\n') {
+			lineEnd++;
+		}
+		const char* nextLine = lineEnd < chunk.end ? lineEnd + 1 : lineEnd;
+		if (lineEnd > lineBegin && lineEnd[-1] == '\r') {
+			lineEnd--;
+		}
+
+		const char* token = skipSpaces(lineBegin, lineEnd);
+		std::size_t length = lineEnd - token;
+		lineBegin = nextLine;
+
+		if (length < 2 || token[0] == '#') {
+			continue;
+		}
+
+		if (token[0] == 'v' && isSpace(token[1])) {
+			token += 2;
+			float x = parseReal(token, lineEnd);
+			float y = parseReal(token, lineEnd);
+			float z = parseReal(token, lineEnd);
+			float r = 1.0f, g = 1.0f, b = 1.0f;
+			if (!(parseReal(token, lineEnd, &r) && parseReal(token, lineEnd, &g) && parseReal(token, lineEnd, &b))) {
+				r = g = b = 1.0f;
+			}
+			chunk.positions.insert(chunk.positions.end(), { x, y, z });
+			chunk.colors.insert(chunk.colors.end(), { r, g, b });
+		}
+		else if (length >= 3 && token[0] == 'v' && token[1] == 'n' && isSpace(token[2])) {
+			token += 3;
+			float x = parseReal(token, lineEnd);
+			float y = parseReal(token, lineEnd);
+			float z = parseReal(token, lineEnd);
+			chunk.normals.insert(chunk.normals.end(), { x, y, z });
+		}
+		else if (length >= 3 && token[0] == 'v' && token[1] == 't' && isSpace(token[2])) {
+			token += 3;
+			float u = parseReal(token, lineEnd);
+			float v = parseReal(token, lineEnd);
+			chunk.texcoords.insert(chunk.texcoords.end(), { u, v });
+		}
+		else if (token[0] == 'f' && isSpace(token[1])) {
+			token = skipSpaces(token + 2, lineEnd);
+			uint32_t faceSize = 0;
+			while (token < lineEnd && *token != '\r') {
+				ObjIndex index{};
+				if (!parseFaceIndex(token, lineEnd, chunk, index)) {
+					throw std::runtime_error("Failed parse `f' line (e.g. zero value for face index)");
+				}
+				chunk.faceIndices.push_back(index);
+				faceSize++;
+				while (token < lineEnd && (isSpace(*token) || *token == '\r')) {
+					token++;
+				}
+			}
+			chunk.faceSizes.push_back(faceSize);
+			if (faceSize > 4) {
+				chunk.hasPolygons = true;
+			}
+			else if (faceSize >= 3) {
+				chunk.cornerCount += faceSize == 4 ? 6 : 3;
+			}
+		}
+	}
+}
+
+bool CurenObjParser::parseFaceIndex(const char*& token, const char* lineEnd, const Chunk& chunk, ObjIndex& index)
+{
+	bool isRelative = false;
+	index.texcoord = -1;
+	index.normal = -1;
+	index.relativeMask = 0;
+
+	if (!fixIndex(parseInt(token, lineEnd), chunk.positions.size() / 3, false, index.vertex, isRelative)) {
+		return false;
+	}
+	index.relativeMask |= isRelative ? RELATIVE_VERTEX : 0;
+	token = findTokenEnd(token, lineEnd, true);
+	if (token >= lineEnd || *token != '/') {
+		return true;
+	}
+	token++;
+
+	// i//k
+	if (token < lineEnd && *token == '/') {
+		token++;
+		if (!fixIndex(parseInt(token, lineEnd), chunk.normals.size() / 3, true, index.normal, isRelative)) {
+			return false;
+		}
+		index.relativeMask |= isRelative ? RELATIVE_NORMAL : 0;
+		token = findTokenEnd(token, lineEnd, true);
+		return true;
+	}
+
+	// i/j/k or i/j
+	if (!fixIndex(parseInt(token, lineEnd), chunk.texcoords.size() / 2, true, index.texcoord, isRelative)) {
+		return false;
+	}
+	index.relativeMask |= isRelative ? RELATIVE_TEXCOORD : 0;
+	token = findTokenEnd(token, lineEnd, true);
+	if (token >= lineEnd || *token != '/') {
+		return true;
+	}
+	token++;
+
+	if (!fixIndex(parseInt(token, lineEnd), chunk.normals.size() / 3, true, index.normal, isRelative)) {
+		return false;
+	}
+	index.relativeMask |= isRelative ? RELATIVE_NORMAL : 0;
+	token = findTokenEnd(token, lineEnd, true);
+	return true;
+}
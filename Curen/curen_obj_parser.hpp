@@ -0,0 +1,55 @@
+#pragma once
+
+#include "curen_model.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Curen {
+
+	// Multi threaded Wavefront OBJ importer. The file is memory-mapped, split into line aligned chunks and
+	// the v/vn/vt/f records of every chunk are parsed on the shared thread pool. Vertices are then welded
+	// in parallel, partitioned by hash. Numbers are parsed with the same rules as tinyobjloader and triangles and
+	// quads are triangulated the same way, and vertices weld with operator== like its std::unordered_map (-0 welds
+	// with +0, NaN never welds), so the output matches Builder::loadModelTinyObj exactly. Larger polygons, which
+	// tinyobjloader ear clips, are left to it.
+	class CurenObjParser {
+	public:
+		// Fills vertices and indices, returns the size of the parsed file in bytes. Returns 0 and leaves both
+		// untouched when a face has more than four corners, found by a quick scan before the file is parsed.
+		static std::size_t parse(const std::string& filePath, std::vector<CurenModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	private:
+		struct ObjIndex {
+			int32_t vertex;
+			int32_t texcoord;
+			int32_t normal;
+			uint32_t relativeMask;
+		};
+
+		struct Chunk {
+			const char* begin;
+			const char* end;
+
+			std::vector<float> positions{};
+			std::vector<float> colors{};
+			std::vector<float> normals{};
+			std::vector<float> texcoords{};
+			std::vector<ObjIndex> faceIndices{};
+			std::vector<uint32_t> faceSizes{};
+
+			std::size_t cornerCount = 0;
+			bool hasPolygons = false;
+			std::size_t vertexBase = 0;
+			std::size_t normalBase = 0;
+			std::size_t texcoordBase = 0;
+			std::size_t cornerBase = 0;
+			std::size_t weldedCount = 0;
+			std::vector<std::vector<uint32_t>> partitionCorners{};
+		};
+
+		static void parseChunk(Chunk& chunk);
+		static bool parseFaceIndex(const char*& token, const char* lineEnd, const Chunk& chunk, ObjIndex& index);
+	};
+}
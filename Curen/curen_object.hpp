@@ -37,6 +37,8 @@ namespace Curen {
 		std::shared_ptr<CurenModel> model{};
 		glm::vec3 color{};
 		TransformComponent transformComponent{};
+		// Level of detail drawn last frame, kept for the hysteresis of the next selection
+		uint32_t lodLevel = 0;
 
 	private:
 		CurenObject(id_t objectId) : m_id{ objectId } {};
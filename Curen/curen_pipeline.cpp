@@ -1,69 +1,103 @@
 #include "curen_pipeline.hpp"
+#include "curen_descriptor.hpp"
 
-#include <fstream>
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
+#include <unordered_map>
 
 using namespace Curen;
 
 CurenPipeline::CurenPipeline(CurenDevice& device,const std::string& vertFilePath, 
-	const std::string& fragFilePath, const PipelineConfigInfo& configInfo): m_curenDevice{ device }
+	const std::string& fragFilePath, const PipelineConfigInfo& configInfo):
+	CurenPipeline{ device, CurenShaderLibrary::get(vertFilePath), CurenShaderLibrary::get(fragFilePath), configInfo }
+{
+}
+
+CurenPipeline::CurenPipeline(CurenDevice& device, ShaderCode vertCode, ShaderCode fragCode, const PipelineConfigInfo& configInfo) :
+	m_curenDevice{ device }
+{
+	createGraphicsPipeline(vertCode, fragCode, configInfo);
+}
+
+CurenPipeline::CurenPipeline(CurenDevice& device, const std::string& compFilePath, VkPipelineLayout pipelineLayout) :
+	CurenPipeline{ device, CurenShaderLibrary::get(compFilePath), pipelineLayout }
+{
+}
+
+CurenPipeline::CurenPipeline(CurenDevice& device, ShaderCode compCode, VkPipelineLayout pipelineLayout) :
+	m_curenDevice{ device }, m_bindPoint{ VK_PIPELINE_BIND_POINT_COMPUTE }
+{
+	createComputePipeline(compCode, pipelineLayout);
+}
+
+CurenPipeline::CurenPipeline(CurenDevice& device, VkPipeline pipeline, VkPipelineBindPoint bindPoint) :
+	m_curenDevice{ device }, m_graphicsPipeline{ pipeline }, m_bindPoint{ bindPoint }
 {
-	createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
 }
 
 CurenPipeline::~CurenPipeline() {
 	vkDestroyShaderModule(m_curenDevice.device(), m_vertShader, nullptr);
 	vkDestroyShaderModule(m_curenDevice.device(), m_fragShader, nullptr);
+	vkDestroyShaderModule(m_curenDevice.device(), m_compShader, nullptr);
 	vkDestroyPipeline(m_curenDevice.device(), m_graphicsPipeline, nullptr);
 }
 
-std::vector<char> CurenPipeline::readFile(const std::string& filepath) {
-	std::ifstream file(filepath, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open())
-	{
-		throw std::runtime_error("Failed to open the file : " + filepath);
-	}
-
-	std::size_t fileSize = static_cast<std::size_t>(file.tellg());
-	std::vector<char> buffer(fileSize);
+void CurenPipeline::createGraphicsPipeline(ShaderCode vertCode, ShaderCode fragCode, const PipelineConfigInfo& configInfo) {
+	createShaderModule(m_curenDevice, vertCode, &m_vertShader);
+	createShaderModule(m_curenDevice, fragCode, &m_fragShader);
 
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
+	GraphicsPipelineStages stages;
+	VkGraphicsPipelineCreateInfo pipelineInfo = graphicsPipelineCreateInfo(configInfo, m_vertShader, m_fragShader, stages);
 
-	return buffer;
+	if (vkCreateGraphicsPipelines(
+		m_curenDevice.device(),
+		m_curenDevice.pipelineCache(),
+		1,
+		&pipelineInfo,
+		nullptr,
+		&m_graphicsPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline");
+	}
 }
 
-void CurenPipeline::createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo) {
-	std::vector<char> vertCode = readFile(vertFilePath);
-	std::vector<char> fragCode = readFile(fragFilePath);
-
-	createShaderModule(vertCode, &m_vertShader);
-	createShaderModule(fragCode, &m_fragShader);
-
-	VkPipelineShaderStageCreateInfo shaderStages[2];
+VkGraphicsPipelineCreateInfo CurenPipeline::graphicsPipelineCreateInfo(const PipelineConfigInfo& configInfo,
+	VkShaderModule vertShader, VkShaderModule fragShader, GraphicsPipelineStages& stages) {
+	VkPipelineShaderStageCreateInfo* shaderStages = stages.shaderStages;
 	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	shaderStages[0].module = m_vertShader;
+	shaderStages[0].module = vertShader;
 	shaderStages[0].pName = "main";
 	shaderStages[0].flags = 0;
 	shaderStages[0].pNext = nullptr;
 	shaderStages[0].pSpecializationInfo = nullptr;
 	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shaderStages[1].module = m_fragShader;
+	shaderStages[1].module = fragShader;
 	shaderStages[1].pName = "main";
 	shaderStages[1].flags = 0;
 	shaderStages[1].pNext = nullptr;
 	shaderStages[1].pSpecializationInfo = nullptr;
 
-	auto bindingDescriptionsInfo = CurenModel::Vertex::getBindingDescriptions();
-	auto attributeDescriptionsInfo = CurenModel::Vertex::getAttributeDescriptions();
+	const ShaderSpecialization* specializations[2] = { &configInfo.vertSpecialization, &configInfo.fragSpecialization };
+	for (int i = 0; i < 2; i++) {
+		if (specializations[i]->empty()) {
+			continue;
+		}
+		VkSpecializationInfo& specializationInfo = stages.specializationInfos[i];
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializations[i]->mapEntries.size());
+		specializationInfo.pMapEntries = specializations[i]->mapEntries.data();
+		specializationInfo.dataSize = specializations[i]->data.size();
+		specializationInfo.pData = specializations[i]->data.data();
+		shaderStages[i].pSpecializationInfo = &specializationInfo;
+	}
+
+	auto& bindingDescriptionsInfo = configInfo.bindingDescriptions;
+	auto& attributeDescriptionsInfo = configInfo.attributeDescriptions;
 
 
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	VkPipelineVertexInputStateCreateInfo& vertexInputInfo = stages.vertexInputInfo;
+	vertexInputInfo = {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptionsInfo.size());
 	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptionsInfo.size());
@@ -106,24 +140,46 @@ void CurenPipeline::createGraphicsPipeline(const std::string& vertFilePath, cons
 	pipelineInfo.basePipelineIndex = -1;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(
+	return pipelineInfo;
+}
+
+void CurenPipeline::createComputePipeline(ShaderCode compCode, VkPipelineLayout pipelineLayout) {
+	createShaderModule(m_curenDevice, compCode, &m_compShader);
+
+	VkPipelineShaderStageCreateInfo shaderStage{};
+	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderStage.module = m_compShader;
+	shaderStage.pName = "main";
+	shaderStage.flags = 0;
+	shaderStage.pNext = nullptr;
+	shaderStage.pSpecializationInfo = nullptr;
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = shaderStage;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+	if (vkCreateComputePipelines(
 		m_curenDevice.device(),
-		VK_NULL_HANDLE,
+		m_curenDevice.pipelineCache(),
 		1,
 		&pipelineInfo,
 		nullptr,
 		&m_graphicsPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create graphics pipeline");
+		throw std::runtime_error("failed to create compute pipeline");
 	}
 }
 
-void CurenPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+void CurenPipeline::createShaderModule(CurenDevice& device, ShaderCode code, VkShaderModule* shaderModule) {
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	createInfo.codeSize = code.size;
+	createInfo.pCode = code.code;
 
-	if (vkCreateShaderModule(m_curenDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
+	if (vkCreateShaderModule(device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create shader module.");
 	}
@@ -211,11 +267,140 @@ PipelineConfigInfo CurenPipeline::defPipelineConfigInfo(PipelineConfigInfo& pipe
 	pipelineConfigInfo.dynamicStateInfo.pDynamicStates = pipelineConfigInfo.dynamicStateEnables.data();
 	pipelineConfigInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(pipelineConfigInfo.dynamicStateEnables.size());
 	pipelineConfigInfo.dynamicStateInfo.flags = 0;
+
+	pipelineConfigInfo.bindingDescriptions = CurenModel::Vertex::getBindingDescriptions();
+	pipelineConfigInfo.attributeDescriptions = CurenModel::Vertex::getAttributeDescriptions();
 	
 	return pipelineConfigInfo;
 }
 
 void Curen::CurenPipeline::bind(VkCommandBuffer commandBuffer)
 {
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+	vkCmdBindPipeline(commandBuffer, m_bindPoint, m_graphicsPipeline);
+}
+
+VkShaderStageFlags PipelineLayoutInfo::pushConstantStages(uint32_t offset, uint32_t size) const
+{
+	VkShaderStageFlags stages = 0;
+	for (auto& range : pushConstantRanges) {
+		if (range.offset < offset + size && offset < range.offset + range.size) {
+			stages |= range.stageFlags;
+		}
+	}
+	return stages;
+}
+
+CurenShaderReflection CurenPipeline::reflectShader(const std::string& filePath)
+{
+	ShaderCode code = CurenShaderLibrary::get(filePath);
+	return CurenShaderReflection{ code.code, code.size };
+}
+
+PipelineLayoutInfo CurenPipeline::reflectLayout(const std::vector<std::string>& shaderFilePaths)
+{
+	PipelineLayoutInfo layoutInfo{};
+	for (auto& filePath : shaderFilePaths) {
+		CurenShaderReflection reflection = reflectShader(filePath);
+		VkShaderStageFlagBits stage = reflection.getStage();
+
+		for (auto& binding : reflection.getBindings()) {
+			if (layoutInfo.setBindings.size() <= binding.set) {
+				layoutInfo.setBindings.resize(binding.set + 1);
+			}
+			auto& setBindings = layoutInfo.setBindings[binding.set];
+			auto merged = std::find_if(setBindings.begin(), setBindings.end(),
+				[&binding](const VkDescriptorSetLayoutBinding& other) { return other.binding == binding.binding; });
+			if (merged == setBindings.end()) {
+				VkDescriptorSetLayoutBinding layoutBinding{};
+				layoutBinding.binding = binding.binding;
+				layoutBinding.descriptorType = binding.descriptorType;
+				layoutBinding.descriptorCount = binding.descriptorCount;
+				setBindings.push_back(layoutBinding);
+				merged = setBindings.end() - 1;
+			}
+			else if (merged->descriptorType != binding.descriptorType) {
+				throw std::runtime_error(filePath + ": set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) +
+					" has a different descriptor type than in the other stages");
+			}
+			else if (merged->descriptorCount != 0) {
+				merged->descriptorCount = binding.descriptorCount == 0 ? 0 : std::max(merged->descriptorCount, binding.descriptorCount);
+			}
+			if (binding.isUsed) {
+				merged->stageFlags |= stage;
+			}
+		}
+
+		const VkPushConstantRange& pushConstantRange = reflection.getPushConstantRange();
+		if (pushConstantRange.stageFlags == 0) {
+			continue;
+		}
+		auto merged = std::find_if(layoutInfo.pushConstantRanges.begin(), layoutInfo.pushConstantRanges.end(), [&pushConstantRange](const VkPushConstantRange& other) {
+			return other.offset == pushConstantRange.offset && other.size == pushConstantRange.size;
+		});
+		if (merged != layoutInfo.pushConstantRanges.end()) {
+			merged->stageFlags |= pushConstantRange.stageFlags;
+		}
+		else {
+			layoutInfo.pushConstantRanges.push_back(pushConstantRange);
+		}
+	}
+	for (auto& setBindings : layoutInfo.setBindings) {
+		std::sort(setBindings.begin(), setBindings.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	}
+	return layoutInfo;
+}
+
+VkPipelineLayout CurenPipeline::createPipelineLayout(CurenDevice& device, const PipelineLayoutInfo& layoutInfo,
+	const std::vector<VkDescriptorSetLayout>& sharedSetLayouts)
+{
+	std::vector<VkDescriptorSetLayout> setLayouts(std::max(layoutInfo.setBindings.size(), sharedSetLayouts.size()), VK_NULL_HANDLE);
+	for (std::size_t set = 0; set < setLayouts.size(); set++) {
+		if (set < sharedSetLayouts.size() && sharedSetLayouts[set] != VK_NULL_HANDLE) {
+			setLayouts[set] = sharedSetLayouts[set];
+			continue;
+		}
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+		if (set < layoutInfo.setBindings.size()) {
+			for (auto& binding : layoutInfo.setBindings[set]) {
+				if (binding.descriptorCount == 0) {
+					throw std::runtime_error("set " + std::to_string(set) + " binding " + std::to_string(binding.binding) +
+						" is runtime sized, pass a shared set layout for it");
+				}
+				bindings[binding.binding] = binding;
+			}
+		}
+		setLayouts[set] = device.descriptorCache().getLayout(bindings).getDescriptorSetLayout();
+	}
+	return device.descriptorCache().getPipelineLayout(setLayouts, layoutInfo.pushConstantRanges);
+}
+
+void CurenPipeline::validateStruct(const std::string& shaderFilePath, const std::string& structName, std::size_t size,
+	const std::vector<std::pair<std::string, std::size_t>>& memberOffsets)
+{
+	CurenShaderReflection reflection = reflectShader(shaderFilePath);
+	const CurenShaderReflection::Struct* reflected = reflection.findStruct(structName);
+	if (reflected == nullptr) {
+		throw std::runtime_error(shaderFilePath + " has no struct " + structName + ", or was compiled without names");
+	}
+	std::string error;
+	if (reflected->size != size) {
+		error = "is " + std::to_string(reflected->size) + " bytes in the shader and " + std::to_string(size) + " in C++";
+	}
+	else if (reflected->members.size() != memberOffsets.size()) {
+		error = "has " + std::to_string(reflected->members.size()) + " members in the shader and " + std::to_string(memberOffsets.size()) + " in C++";
+	}
+	else {
+		for (std::size_t i = 0; i < memberOffsets.size(); i++) {
+			const CurenShaderReflection::Member& member = reflected->members[i];
+			if (member.name != memberOffsets[i].first || member.offset != memberOffsets[i].second) {
+				error = "member " + std::to_string(i) + " is " + member.name + " at " + std::to_string(member.offset) + " in the shader and " +
+					memberOffsets[i].first + " at " + std::to_string(memberOffsets[i].second) + " in C++";
+				break;
+			}
+		}
+	}
+	if (!error.empty()) {
+		throw std::runtime_error(shaderFilePath + ": struct " + structName + " " + error);
+	}
 }
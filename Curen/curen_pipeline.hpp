@@ -2,13 +2,40 @@
 
 #include "curen_device.hpp"
 #include "curen_model.hpp"
+#include "curen_shader_reflection.hpp"
+#include "curen_shader_library.hpp"
 
+#include <cstring>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace Curen {
 
+	// Values for the specialization constants of one stage. Owns its map entries and data, so a copied
+	// PipelineConfigInfo stays valid on its own, as CurenPipelineCompiler needs
+	struct ShaderSpecialization {
+		std::vector<VkSpecializationMapEntry> mapEntries;
+		std::vector<uint8_t> data;
+
+		// value has to match the constant's GLSL type: uint32_t for uint, VkBool32 for bool, int32_t, float
+		template <typename T>
+		void set(uint32_t constantId, const T& value) {
+			static_assert(sizeof(T) == 4 || sizeof(T) == 8, "specialization constants are 32 or 64 bit scalars");
+			VkSpecializationMapEntry mapEntry{};
+			mapEntry.constantID = constantId;
+			mapEntry.offset = static_cast<uint32_t>(data.size());
+			mapEntry.size = sizeof(T);
+			mapEntries.push_back(mapEntry);
+			data.resize(data.size() + sizeof(T));
+			std::memcpy(data.data() + mapEntry.offset, &value, sizeof(T));
+		}
+		bool empty() const { return mapEntries.empty(); }
+	};
+
 	struct PipelineConfigInfo {
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 		VkPipelineViewportStateCreateInfo viewportInfo;
 		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
@@ -21,12 +48,41 @@ namespace Curen {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// Constants left out keep the default the shader declares
+		ShaderSpecialization vertSpecialization;
+		ShaderSpecialization fragSpecialization;
+	};
+
+	// Descriptor bindings and push constant ranges the stages of a pipeline declare, stage flags only name the stages
+	// that use them
+	struct PipelineLayoutInfo {
+		// By set number, a set no stage declares stays empty
+		std::vector<std::vector<VkDescriptorSetLayoutBinding>> setBindings;
+		// One per distinct block, stages using the same block share its range
+		std::vector<VkPushConstantRange> pushConstantRanges;
+
+		// The stageFlags vkCmdPushConstants needs for the bytes [offset, offset + size)
+		VkShaderStageFlags pushConstantStages(uint32_t offset, uint32_t size) const;
+	};
+
+	// Create info parts that are not in PipelineConfigInfo, they have to outlive the VkGraphicsPipelineCreateInfo pointing at them
+	struct GraphicsPipelineStages {
+		VkPipelineShaderStageCreateInfo shaderStages[2];
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+		VkSpecializationInfo specializationInfos[2];
 	};
 
+	// Shader file names go through CurenShaderLibrary, the embedded SPIR-V unless a development override is set
 	class CurenPipeline {
 	public:
 		CurenPipeline(CurenDevice &device,
 			const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
+		CurenPipeline(CurenDevice& device, ShaderCode vertCode, ShaderCode fragCode, const PipelineConfigInfo& configInfo);
+		// Compute pipeline
+		CurenPipeline(CurenDevice& device, const std::string& compFilePath, VkPipelineLayout pipelineLayout);
+		CurenPipeline(CurenDevice& device, ShaderCode compCode, VkPipelineLayout pipelineLayout);
+		// Takes ownership of a pipeline created elsewhere, see CurenPipelineCompiler
+		CurenPipeline(CurenDevice& device, VkPipeline pipeline, VkPipelineBindPoint bindPoint);
 		~CurenPipeline();
 
 		CurenPipeline(const CurenPipeline&) = delete;
@@ -35,15 +91,32 @@ namespace Curen {
 		void bind(VkCommandBuffer commandBuffer);
 		static PipelineConfigInfo defPipelineConfigInfo(PipelineConfigInfo& pipelineConfigInfo);
 
+		static void createShaderModule(CurenDevice& device, ShaderCode code, VkShaderModule* shaderModule);
+		static VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo(const PipelineConfigInfo& configInfo,
+			VkShaderModule vertShader, VkShaderModule fragShader, GraphicsPipelineStages& stages);
+
+		static CurenShaderReflection reflectShader(const std::string& filePath);
+		// Merges the interfaces of every stage, throws when two stages disagree on a binding
+		static PipelineLayoutInfo reflectLayout(const std::vector<std::string>& shaderFilePaths);
+		// Sets with a layout in sharedSetLayouts, like the global or the bindless set, use that layout as it is. The
+		// other set layouts and the pipeline layout come from the device's descriptor cache, which owns them
+		static VkPipelineLayout createPipelineLayout(CurenDevice& device, const PipelineLayoutInfo& layoutInfo,
+			const std::vector<VkDescriptorSetLayout>& sharedSetLayouts = {});
+		// Throws unless the shader's struct named structName is size bytes and has exactly these members at these
+		// offsets, so a C++ mirror of a GLSL block cannot drift from it
+		static void validateStruct(const std::string& shaderFilePath, const std::string& structName, std::size_t size,
+			const std::vector<std::pair<std::string, std::size_t>>& memberOffsets);
+
 	private:
-		static std::vector<char> readFile(const std::string& filepath);
-		void createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		void createGraphicsPipeline(ShaderCode vertCode, ShaderCode fragCode, const PipelineConfigInfo& configInfo);
+		void createComputePipeline(ShaderCode compCode, VkPipelineLayout pipelineLayout);
 
 
 		CurenDevice& m_curenDevice;
 		VkPipeline m_graphicsPipeline;
-		VkShaderModule m_vertShader;
-		VkShaderModule m_fragShader;
+		VkPipelineBindPoint m_bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkShaderModule m_vertShader = VK_NULL_HANDLE;
+		VkShaderModule m_fragShader = VK_NULL_HANDLE;
+		VkShaderModule m_compShader = VK_NULL_HANDLE;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "curen_pipeline_compiler.hpp"
+#include "curen_thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace Curen;
+
+static bool isFutureReady(const std::future<void>& future)
+{
+	return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool CurenPipelineHandle::isReady() const
+{
+	return m_pipeline != nullptr || (m_batch.valid() && m_batch.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+}
+
+CurenPipeline* CurenPipelineHandle::get(CurenPipeline* fallback) const
+{
+	if (m_pipeline == nullptr) {
+		if (!isReady()) {
+			return fallback;
+		}
+		m_pipeline = (*m_batch.get())[m_index].get();
+	}
+	return m_pipeline;
+}
+
+CurenPipeline& CurenPipelineHandle::wait() const
+{
+	if (m_pipeline == nullptr) {
+		m_pipeline = (*m_batch.get())[m_index].get();
+	}
+	return *m_pipeline;
+}
+
+CurenPipelineCompiler::CurenPipelineCompiler(CurenDevice& curenDevice) :
+	m_curenDevice{ curenDevice }
+{
+}
+
+CurenPipelineCompiler::~CurenPipelineCompiler()
+{
+	waitIdle();
+}
+
+CurenPipelineHandle CurenPipelineCompiler::compileGraphics(GraphicsPipelineDesc desc)
+{
+	std::vector<GraphicsPipelineDesc> descs;
+	descs.push_back(std::move(desc));
+	return compileGraphicsBatch(std::move(descs)).front();
+}
+
+std::vector<CurenPipelineHandle> CurenPipelineCompiler::compileGraphicsBatch(std::vector<GraphicsPipelineDesc> descs)
+{
+	uint32_t pipelineCount = static_cast<uint32_t>(descs.size());
+	auto promise = std::make_shared<std::promise<std::shared_ptr<CurenPipelineHandle::Batch>>>();
+	std::shared_future<std::shared_ptr<CurenPipelineHandle::Batch>> batch = promise->get_future().share();
+
+	CurenDevice& curenDevice = m_curenDevice;
+	std::future<void> job = CurenThreadPool::shared().submit([&curenDevice, promise, descs = std::move(descs)]() mutable {
+		try {
+			promise->set_value(createBatch(curenDevice, descs));
+		}
+		catch (...) {
+			promise->set_exception(std::current_exception());
+		}
+	});
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), isFutureReady), m_jobs.end());
+		m_jobs.push_back(std::move(job));
+	}
+
+	std::vector<CurenPipelineHandle> handles;
+	handles.reserve(pipelineCount);
+	for (uint32_t i = 0; i < pipelineCount; i++) {
+		handles.push_back(CurenPipelineHandle{ batch, i });
+	}
+	return handles;
+}
+
+uint32_t CurenPipelineCompiler::getPendingCount()
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return static_cast<uint32_t>(std::count_if(m_jobs.begin(), m_jobs.end(), [](const std::future<void>& job) { return !isFutureReady(job); }));
+}
+
+void CurenPipelineCompiler::waitIdle()
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	for (auto& job : m_jobs) {
+		job.wait();
+	}
+	m_jobs.clear();
+}
+
+std::shared_ptr<CurenPipelineHandle::Batch> CurenPipelineCompiler::createBatch(CurenDevice& curenDevice, std::vector<GraphicsPipelineDesc>& descs)
+{
+	std::unordered_map<std::string, VkShaderModule> shaderModules;
+	auto destroyShaderModules = [&curenDevice, &shaderModules]() {
+		for (auto& kv : shaderModules) {
+			vkDestroyShaderModule(curenDevice.device(), kv.second, nullptr);
+		}
+	};
+	auto getShaderModule = [&curenDevice, &shaderModules](const std::string& filePath) {
+		auto shaderModule = shaderModules.find(filePath);
+		if (shaderModule == shaderModules.end()) {
+			VkShaderModule created = VK_NULL_HANDLE;
+			CurenPipeline::createShaderModule(curenDevice, CurenShaderLibrary::get(filePath), &created);
+			shaderModule = shaderModules.emplace(filePath, created).first;
+		}
+		return shaderModule->second;
+	};
+
+	std::vector<GraphicsPipelineStages> stages(descs.size());
+	std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos;
+	pipelineInfos.reserve(descs.size());
+	std::vector<VkPipeline> pipelines(descs.size(), VK_NULL_HANDLE);
+	VkResult result;
+	try {
+		for (std::size_t i = 0; i < descs.size(); i++) {
+			PipelineConfigInfo& configInfo = descs[i].configInfo;
+			configInfo.colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
+			configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
+			configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
+			pipelineInfos.push_back(CurenPipeline::graphicsPipelineCreateInfo(configInfo,
+				getShaderModule(descs[i].vertFilePath), getShaderModule(descs[i].fragFilePath), stages[i]));
+		}
+		result = vkCreateGraphicsPipelines(curenDevice.device(), curenDevice.pipelineCache(),
+			static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(), nullptr, pipelines.data());
+	}
+	catch (...) {
+		destroyShaderModules();
+		throw;
+	}
+	// A pipeline keeps what it needs from its modules
+	destroyShaderModules();
+
+	if (result != VK_SUCCESS) {
+		// Some of the batch may still have been created
+		for (VkPipeline pipeline : pipelines) {
+			vkDestroyPipeline(curenDevice.device(), pipeline, nullptr);
+		}
+		throw std::runtime_error("failed to create graphics pipeline batch of " + std::to_string(descs.size()) + " starting with " +
+			descs.front().vertFilePath);
+	}
+
+	auto batch = std::make_shared<CurenPipelineHandle::Batch>();
+	for (VkPipeline pipeline : pipelines) {
+		batch->push_back(std::make_unique<CurenPipeline>(curenDevice, pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS));
+	}
+	return batch;
+}
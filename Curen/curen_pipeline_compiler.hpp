@@ -0,0 +1,75 @@
+#pragma once
+
+#include "curen_pipeline.hpp"
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Curen {
+
+	// A pipeline being compiled by CurenPipelineCompiler. Cheap to copy, the pipeline lives until the last copy is gone
+	class CurenPipelineHandle {
+	public:
+		CurenPipelineHandle() = default;
+
+		bool isValid() const { return m_batch.valid(); }
+		bool isReady() const;
+		// Never blocks, returns fallback while the pipeline is still compiling. Rethrows when compiling failed
+		CurenPipeline* get(CurenPipeline* fallback = nullptr) const;
+		CurenPipeline& wait() const;
+
+	private:
+		friend class CurenPipelineCompiler;
+		using Batch = std::vector<std::unique_ptr<CurenPipeline>>;
+
+		CurenPipelineHandle(std::shared_future<std::shared_ptr<Batch>> batch, uint32_t index) :
+			m_batch{ std::move(batch) }, m_index{ index } {}
+
+		std::shared_future<std::shared_ptr<Batch>> m_batch;
+		uint32_t m_index = 0;
+		// Set on the first ready get, later calls skip the future's lock
+		mutable CurenPipeline* m_pipeline = nullptr;
+	};
+
+	// Creates graphics pipelines on the shared thread pool through the device's pipeline cache, so constructing a system
+	// only queues its pipelines and startup no longer waits on one compile after the other. Owned by CurenDevice.
+	class CurenPipelineCompiler {
+	public:
+		struct GraphicsPipelineDesc {
+			std::string vertFilePath;
+			std::string fragFilePath;
+			// Copied, the blend attachment and dynamic state pointers are pointed at the copy
+			PipelineConfigInfo configInfo;
+		};
+
+		CurenPipelineCompiler(CurenDevice& curenDevice);
+		// Waits for the compiles still running
+		~CurenPipelineCompiler();
+
+		CurenPipelineCompiler(const CurenPipelineCompiler&) = delete;
+		CurenPipelineCompiler& operator = (const CurenPipelineCompiler&) = delete;
+
+		CurenPipelineHandle compileGraphics(GraphicsPipelineDesc desc);
+		// One job and a single vkCreateGraphicsPipelines call for all of them, shader modules shared between them are
+		// created once. Fewer calls and a driver that parallelizes inside the call, against less spread over the pool,
+		// so batch pipelines that are needed together, like the vertex layout variants of one pass
+		std::vector<CurenPipelineHandle> compileGraphicsBatch(std::vector<GraphicsPipelineDesc> descs);
+
+		uint32_t getPendingCount();
+		bool isIdle() { return getPendingCount() == 0; }
+		void waitIdle();
+
+	private:
+		static std::shared_ptr<CurenPipelineHandle::Batch> createBatch(CurenDevice& curenDevice, std::vector<GraphicsPipelineDesc>& descs);
+
+		CurenDevice& m_curenDevice;
+
+		std::mutex m_mutex;
+		// One per submitted batch, finished ones are dropped on the next call
+		std::vector<std::future<void>> m_jobs;
+	};
+}
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "curen_camera.hpp"
-#include "curen_pipeline.hpp"
+#include "curen_pipeline_compiler.hpp"
 #include "curen_device.hpp"
 #include "curen_object.hpp"
 #include "curen_frame_info.hpp"
@@ -39,7 +39,9 @@ namespace Curen {
 
 		CurenDevice& m_curenDevice;
 
-		std::unique_ptr<CurenPipeline> m_curenPipeline;
+		// Compiled in the background, the first frame waits on it
+		CurenPipelineHandle m_curenPipeline;
+		// Reflected from the shaders and owned by the descriptor cache
 		VkPipelineLayout m_pipelineLayout;
 	};
 }
@@ -1,14 +1,36 @@
 #include "curen_render_system.hpp"
 
+#include <cstddef>
+
 using namespace Curen;
 
+// The mat3 columns of the shaders are padded to vec4
 struct SimplePushConstant {
 	glm::mat4 modelMatrix{1.0f};
-	glm::mat4 normalMatrix{1.0f};
+	glm::mat3x4 normalMatrix{1.0f};
 };
 
-CurenRenderSystem::CurenRenderSystem(CurenDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) :
-	m_curenDevice {device}
+// ObjectData of first_shader_bindless.vert
+struct BindlessObjectData {
+	glm::mat4 modelMatrix{1.0f};
+	glm::mat3x4 normalMatrix{1.0f};
+};
+
+struct BindlessPushConstant {
+	uint32_t objectBufferIndex;
+	uint32_t objectIndex;
+};
+
+// By bindless, then standard and compact vertex layout
+static const char* const VERTEX_SHADER_FILES[2][2] = {
+	{ "first_shader.vert.spv", "first_shader_compact.vert.spv" },
+	{ "first_shader_bindless.vert.spv", "first_shader_bindless_compact.vert.spv" },
+};
+static const char* const FRAGMENT_SHADER_FILE = "first_shader.frag.spv";
+
+CurenRenderSystem::CurenRenderSystem(CurenDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
+	CurenBindlessTable* bindlessTable) :
+	m_curenDevice {device}, m_bindlessTable{ bindlessTable }
 {
 	createPipelineLayout(globalSetLayout);
 	createPipeline(renderPass);
@@ -16,64 +38,200 @@ CurenRenderSystem::CurenRenderSystem(CurenDevice& device, VkRenderPass renderPas
 
 CurenRenderSystem::~CurenRenderSystem()
 {
-	vkDestroyPipelineLayout(m_curenDevice.device(), m_pipelineLayout, nullptr);
+	if (m_objectBufferIndex != CurenBindlessTable::INVALID_INDEX) {
+		m_bindlessTable->releaseStorageBuffer(m_objectBufferIndex);
+	}
 }
 
 void CurenRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
+	bool isBindless = m_bindlessTable != nullptr;
+	const char* const* vertexShaderFiles = VERTEX_SHADER_FILES[isBindless ? 1 : 0];
+	for (int i = 0; i < 2; i++) {
+		if (isBindless) {
+			CurenPipeline::validateStruct(vertexShaderFiles[i], "Push", sizeof(BindlessPushConstant), {
+				{ "objectBufferIndex", offsetof(BindlessPushConstant, objectBufferIndex) },
+				{ "objectIndex", offsetof(BindlessPushConstant, objectIndex) } });
+			CurenPipeline::validateStruct(vertexShaderFiles[i], "ObjectData", sizeof(BindlessObjectData), {
+				{ "modelMatrix", offsetof(BindlessObjectData, modelMatrix) },
+				{ "normalMatrix", offsetof(BindlessObjectData, normalMatrix) } });
+		}
+		else {
+			CurenPipeline::validateStruct(vertexShaderFiles[i], "Push", sizeof(SimplePushConstant), {
+				{ "modelMatrix", offsetof(SimplePushConstant, modelMatrix) },
+				{ "normalMatrix", offsetof(SimplePushConstant, normalMatrix) } });
+		}
+	}
 
-	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(SimplePushConstant);
-
-	std::vector<VkDescriptorSetLayout> descriptorSetLayout {globalSetLayout};
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayout.size());
-	pipelineLayoutInfo.pSetLayouts = descriptorSetLayout.data();
-	pipelineLayoutInfo.pushConstantRangeCount = 1;
-	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-	if (vkCreatePipelineLayout(m_curenDevice.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) !=
-		VK_SUCCESS) {
-		throw std::runtime_error("failed to create pipeline layout!");
+	// Both vertex layouts share the layout, the bindless table brings its own set layout for its runtime sized arrays
+	PipelineLayoutInfo layoutInfo = CurenPipeline::reflectLayout({ vertexShaderFiles[0], vertexShaderFiles[1], FRAGMENT_SHADER_FILE });
+	std::vector<VkDescriptorSetLayout> sharedSetLayouts{ globalSetLayout };
+	if (isBindless) {
+		sharedSetLayouts.push_back(m_bindlessTable->getDescriptorSetLayout());
 	}
+	m_pipelineLayout = CurenPipeline::createPipelineLayout(m_curenDevice, layoutInfo, sharedSetLayouts);
+	m_pushConstantStages = layoutInfo.pushConstantStages(0, isBindless ? sizeof(BindlessPushConstant) : sizeof(SimplePushConstant));
 }
 
 void CurenRenderSystem::createPipeline(VkRenderPass renderPass)
 {
 	PipelineConfigInfo pipelineConfigInfo{};
-	auto pipelineConfig =
-		CurenPipeline::defPipelineConfigInfo(pipelineConfigInfo);
-	pipelineConfig.renderPass = renderPass;
-	pipelineConfig.pipelineLayout = m_pipelineLayout;
-	m_curenPipeline = std::make_unique<CurenPipeline>(
-		m_curenDevice,
-		"first_shader.vert.spv",
-		"first_shader.frag.spv",
-		pipelineConfig);
+	m_pipelineConfig = CurenPipeline::defPipelineConfigInfo(pipelineConfigInfo);
+	m_pipelineConfig.renderPass = renderPass;
+	m_pipelineConfig.pipelineLayout = m_pipelineLayout;
+
+	// The runtime branching pipelines are the fallback of every variant, the startup features follow right behind
+	getVariant(FEATURE_RUNTIME);
+	getVariant(m_fragmentFeatures);
 }
 
+CurenRenderSystem::VariantPipelines& CurenRenderSystem::getVariant(uint32_t fragmentFeatures)
+{
+	auto it = m_variants.find(fragmentFeatures);
+	if (it != m_variants.end()) {
+		return it->second;
+	}
+
+	PipelineConfigInfo pipelineConfig = m_pipelineConfig;
+	// Left unset the shader's default, FEATURE_RUNTIME, stays
+	if (fragmentFeatures != FEATURE_RUNTIME) {
+		pipelineConfig.fragSpecialization.set(0, fragmentFeatures);
+	}
+	const char* const* vertexShaderFiles = VERTEX_SHADER_FILES[m_bindlessTable != nullptr ? 1 : 0];
+	std::vector<CurenPipelineCompiler::GraphicsPipelineDesc> pipelineDescs;
+	pipelineDescs.push_back({ vertexShaderFiles[0], FRAGMENT_SHADER_FILE, pipelineConfig });
+
+	pipelineConfig.bindingDescriptions = CurenModel::CompactVertex::getBindingDescriptions();
+	pipelineConfig.attributeDescriptions = CurenModel::CompactVertex::getAttributeDescriptions();
+	pipelineDescs.push_back({ vertexShaderFiles[1], FRAGMENT_SHADER_FILE, pipelineConfig });
+
+	// Both layouts are needed as soon as models stream in, one batch shares the fragment module
+	std::vector<CurenPipelineHandle> pipelines = m_curenDevice.pipelineCompiler().compileGraphicsBatch(std::move(pipelineDescs));
+	return m_variants[fragmentFeatures] = VariantPipelines{ pipelines[0], pipelines[1] };
+}
 
 
+
+uint32_t CurenRenderSystem::selectLod(CurenObject& obj, const FrameInfo& frameInfo, const glm::mat4& modelMatrix) const
+{
+	const CurenModel& model = *obj.model;
+	uint32_t lodCount = model.getLodCount();
+	if (!m_isLodEnabled || lodCount <= 1) {
+		return 0;
+	}
+
+	// Projected size of one model space unit at the closest point of the bounding sphere
+	const glm::vec3& scale = obj.transformComponent.scale;
+	float maxScale = glm::max(glm::abs(scale.x), glm::max(glm::abs(scale.y), glm::abs(scale.z)));
+	const glm::vec4& sphere = model.getBoundingSphere();
+	glm::vec4 centerView = frameInfo.camera.getView() * modelMatrix * glm::vec4{ sphere.x, sphere.y, sphere.z, 1.f };
+	float depth = glm::max(centerView.z - sphere.w * maxScale, 1e-3f);
+	float pixelsPerUnit = maxScale * frameInfo.camera.getProjection()[1][1] * 0.5f * frameInfo.viewportHeight / depth;
+
+	uint32_t lod = glm::min(obj.lodLevel, lodCount - 1);
+	if (model.getLod(lod).error * pixelsPerUnit > LOD_PIXEL_ERROR) {
+		while (lod > 0 && model.getLod(lod).error * pixelsPerUnit > LOD_PIXEL_ERROR) {
+			lod--;
+		}
+	}
+	else {
+		while (lod + 1 < lodCount && model.getLod(lod + 1).error * pixelsPerUnit <= LOD_PIXEL_ERROR * (1.f - LOD_HYSTERESIS)) {
+			lod++;
+		}
+	}
+	return lod;
+}
+
 void CurenRenderSystem::renderObjects(FrameInfo& frameInfo)
 {
-	m_curenPipeline->bind(frameInfo.commandBuffer);
+	m_drawnTriangleCount = 0;
 
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-		m_pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+	// Bindless: the sets are bound once and every draw only pushes the index of its transforms
+	BindlessObjectData* objectData = nullptr;
+	uint32_t objectIndex = 0;
+	if (m_bindlessTable != nullptr) {
+		if (m_objectBufferIndex == CurenBindlessTable::INVALID_INDEX) {
+			m_objectBufferIndex = m_bindlessTable->addStorageBuffer(frameInfo.frameAllocator.descriptorInfo(VK_WHOLE_SIZE));
+		}
+		uint32_t objectCount = 0;
+		for (auto& kv : frameInfo.objects) {
+			if (kv.second.model != nullptr) {
+				objectCount++;
+			}
+		}
+		// One element of padding, so the first object starts at a whole index
+		CurenFrameAllocator::Allocation allocation = frameInfo.frameAllocator.allocate((objectCount + 1) * sizeof(BindlessObjectData));
+		uint32_t padding = (sizeof(BindlessObjectData) - allocation.offset % sizeof(BindlessObjectData)) % sizeof(BindlessObjectData);
+		objectData = reinterpret_cast<BindlessObjectData*>(static_cast<char*>(allocation.data) + padding);
+		objectIndex = (allocation.offset + padding) / sizeof(BindlessObjectData);
 
+		VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, m_bindlessTable->getDescriptorSet() };
+		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			m_pipelineLayout, 0, 2, descriptorSets, 1, &frameInfo.globalUboOffset);
+	}
+	else {
+		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			m_pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
+	}
+
+	// Queued first in createPipeline, so only the first frames can block here
+	VariantPipelines& runtimePipelines = getVariant(FEATURE_RUNTIME);
+	CurenPipeline* standardPipeline = &runtimePipelines.standard.wait();
+	CurenPipeline* compactPipeline = &runtimePipelines.compact.wait();
+	m_isDrawingVariant = false;
+	if (m_isVariantsEnabled) {
+		VariantPipelines& variant = getVariant(m_fragmentFeatures);
+		m_isDrawingVariant = variant.standard.isReady() && variant.compact.isReady();
+		standardPipeline = variant.standard.get(standardPipeline);
+		compactPipeline = variant.compact.get(compactPipeline);
+	}
+	CurenPipeline* boundPipeline = nullptr;
+	CurenGeometryArena* boundGeometry = nullptr;
 	for (auto& kv : frameInfo.objects)
 	{	
 		CurenObject& obj = kv.second;
-		SimplePushConstant push{};
-		push.modelMatrix = obj.transformComponent.mat4();
-		push.normalMatrix = obj.transformComponent.normalMatrix();
-		
-		vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstant), &push);
-		obj.model->bind(frameInfo.commandBuffer);
-		obj.model->draw(frameInfo.commandBuffer);
+		// Still streaming in
+		if (obj.model == nullptr) {
+			continue;
+		}
+		CurenPipeline* pipeline = obj.model->getVertexLayout() == CurenModel::VertexLayout::Compact ? compactPipeline : standardPipeline;
+		if (pipeline != boundPipeline) {
+			pipeline->bind(frameInfo.commandBuffer);
+			boundPipeline = pipeline;
+		}
+
+		glm::mat4 modelMatrix = obj.transformComponent.mat4();
+		obj.lodLevel = selectLod(obj, frameInfo, modelMatrix);
+
+		if (objectData != nullptr) {
+			objectData->modelMatrix = modelMatrix * obj.model->getDequantizationMatrix();
+			objectData->normalMatrix = glm::mat3x4{ obj.transformComponent.normalMatrix() };
+			objectData++;
+
+			BindlessPushConstant push{ m_objectBufferIndex, objectIndex++ };
+			vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout, m_pushConstantStages, 0, sizeof(BindlessPushConstant), &push);
+		}
+		else {
+			SimplePushConstant push{};
+			push.modelMatrix = modelMatrix * obj.model->getDequantizationMatrix();
+			push.normalMatrix = glm::mat3x4{ obj.transformComponent.normalMatrix() };
+
+			vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout, m_pushConstantStages, 0, sizeof(SimplePushConstant), &push);
+		}
+		if (&obj.model->getGeometryArena() != boundGeometry) {
+			obj.model->bind(frameInfo.commandBuffer);
+			boundGeometry = &obj.model->getGeometryArena();
+		}
+		bool isMeshletCulled = obj.lodLevel == 0 && m_meshletCullSystem != nullptr && m_meshletCullSystem->draw(frameInfo, kv.first);
+		if (isMeshletCulled) {
+			// The culled index buffer replaced the arena one
+			boundGeometry = nullptr;
+		}
+		else {
+			obj.model->draw(frameInfo.commandBuffer, obj.lodLevel);
+		}
+		// Submitted triangles, meshlet culling only lowers the count on the GPU
+		m_drawnTriangleCount += obj.model->getTriangleCount(obj.lodLevel);
 	}
 }
 
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "curen_camera.hpp"
-#include "curen_pipeline.hpp"
+#include "curen_pipeline_compiler.hpp"
 #include "curen_device.hpp"
 #include "curen_object.hpp"
 #include "curen_frame_info.hpp"
+#include "curen_meshlet_cull_system.hpp"
+#include "curen_bindless_table.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -12,6 +14,7 @@
 #include <glm/gtc/constants.hpp>
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include <stdexcept>
 #include <array>
@@ -23,8 +26,19 @@ namespace Curen {
 
 	class CurenRenderSystem {
 	public:
+		// Lighting paths of first_shader.frag, its FEATURES specialization constant and GlobalUbo::featureMask
+		enum FragmentFeature : uint32_t {
+			FEATURE_DIFFUSE = 1u << 0,
+			FEATURE_SPECULAR = 1u << 1,
+			FEATURE_FOG = 1u << 2,
+			// Not a feature: the pipeline branches on GlobalUbo::featureMask instead of being specialized
+			FEATURE_RUNTIME = 1u << 31,
+		};
 
-		CurenRenderSystem(CurenDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalDescriptorSet);
+		// With a bindless table the transforms of every object go into one storage buffer per frame and each draw
+		// only pushes its index, the pipeline layout gets the table's set as set 1
+		CurenRenderSystem(CurenDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalDescriptorSet,
+			CurenBindlessTable* bindlessTable = nullptr);
 		~CurenRenderSystem();
 
 		CurenRenderSystem(const CurenRenderSystem&) = delete;
@@ -32,14 +46,60 @@ namespace Curen {
 		
 		void renderObjects(FrameInfo& frameInfo);
 
+		void setLodEnabled(bool isLodEnabled) { m_isLodEnabled = isLodEnabled; }
+		// The first frame with a new mask queues its variant, the runtime branching pipelines draw until it is ready.
+		// The global UBO has to carry the same mask in featureMask for them
+		void setFragmentFeatures(uint32_t fragmentFeatures) { m_fragmentFeatures = fragmentFeatures; }
+		uint32_t getFragmentFeatures() const { return m_fragmentFeatures; }
+		// Disabled, every frame draws with the runtime branching pipelines, for comparing against the variants
+		void setVariantsEnabled(bool isVariantsEnabled) { m_isVariantsEnabled = isVariantsEnabled; }
+		bool isVariantsEnabled() const { return m_isVariantsEnabled; }
+		// The last frame drew with the variant of its features
+		bool isDrawingVariant() const { return m_isDrawingVariant; }
+		uint32_t getVariantCount() const { return static_cast<uint32_t>(m_variants.size()); }
+		uint64_t getDrawnTriangleCount() const { return m_drawnTriangleCount; }
+		// Objects culled by meshletCullSystem this frame are drawn from its compacted index buffer
+		void setMeshletCullSystem(CurenMeshletCullSystem* meshletCullSystem) { m_meshletCullSystem = meshletCullSystem; }
+
 	private:
+		// A level is good enough while its error projects to at most this many pixels
+		static constexpr float LOD_PIXEL_ERROR = 1.0f;
+		// A coarser level is only taken once its error is this fraction below the limit, so objects near a switch distance don't flicker
+		static constexpr float LOD_HYSTERESIS = 0.25f;
+
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+		struct VariantPipelines {
+			CurenPipelineHandle standard;
+			CurenPipelineHandle compact;
+		};
+
 		void createPipeline(VkRenderPass renderPass);
+		// Compiled on the first call for fragmentFeatures, FEATURE_RUNTIME gives the unspecialized pipelines
+		VariantPipelines& getVariant(uint32_t fragmentFeatures);
+		uint32_t selectLod(CurenObject& obj, const FrameInfo& frameInfo, const glm::mat4& modelMatrix) const;
 		
 
 		CurenDevice& m_curenDevice;
 
-		std::unique_ptr<CurenPipeline> m_curenPipeline;
+		// Filled by createPipeline, the variants only change the fragment specialization
+		PipelineConfigInfo m_pipelineConfig{};
+		// By fragment features. Compiled in the background, the runtime branching pipelines draw until a variant is
+		// ready. The first frames wait on the runtime pipelines rather than drawing nothing.
+		std::unordered_map<uint32_t, VariantPipelines> m_variants;
+		uint32_t m_fragmentFeatures = FEATURE_DIFFUSE;
+		bool m_isVariantsEnabled = true;
+		bool m_isDrawingVariant = false;
+		// Reflected from the shaders and owned by the descriptor cache
 		VkPipelineLayout m_pipelineLayout;
+		VkShaderStageFlags m_pushConstantStages = 0;
+
+		CurenMeshletCullSystem* m_meshletCullSystem = nullptr;
+
+		CurenBindlessTable* m_bindlessTable;
+		// The frame allocator's buffer in the bindless table, registered on the first frame
+		uint32_t m_objectBufferIndex = CurenBindlessTable::INVALID_INDEX;
+
+		bool m_isLodEnabled = true;
+		uint64_t m_drawnTriangleCount = 0;
 	};
 }
\ No newline at end of file
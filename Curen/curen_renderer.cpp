@@ -7,6 +7,13 @@ CurenRenderer::CurenRenderer(CurenWindow& curenWindow, CurenDevice& curenDevice)
 {
 	recreateSwapChain();
 	createCommandBuffers();
+	m_frameAllocator = std::make_unique<CurenFrameAllocator>(m_curenDevice);
+	for (auto& frameDescriptorAllocator : m_frameDescriptorAllocators) {
+		frameDescriptorAllocator = std::make_unique<CurenDescriptorAllocator>(m_curenDevice);
+	}
+	if (m_curenDevice.isBindlessSupported()) {
+		m_bindlessTable = std::make_unique<CurenBindlessTable>(m_curenDevice);
+	}
 }
 
 CurenRenderer::~CurenRenderer()
@@ -30,6 +37,12 @@ VkCommandBuffer CurenRenderer::beginFrame()
 		throw std::runtime_error("failed to acquire swap chain image");
 	}
 	m_isFrameStarted = true;
+	// acquireNextImage waited on this frame's fence, nothing in flight reads its region anymore
+	m_frameAllocator->beginFrame(m_currentFrameIndex);
+	m_frameDescriptorAllocators[m_currentFrameIndex]->resetPools();
+	if (m_bindlessTable) {
+		m_bindlessTable->beginFrame();
+	}
 
 	VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
 
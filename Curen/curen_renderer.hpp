@@ -4,6 +4,9 @@
 #include "curen_device.hpp"
 #include "curen_swap_chain.hpp"
 #include "curen_model.hpp"
+#include "curen_frame_allocator.hpp"
+#include "curen_descriptor.hpp"
+#include "curen_bindless_table.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -31,8 +34,19 @@ namespace Curen {
 
 		VkRenderPass getSwapChainRenderPass() const { return m_curenSwapChain->getRenderPass(); }
 		float getAspectRatio() const { return m_curenSwapChain->extentAspectRatio(); }
+		VkExtent2D getSwapChainExtent() const { return m_curenSwapChain->getSwapChainExtent(); }
 
 		bool isFrameInProgress() const { return m_isFrameStarted; }
+		// Transient per frame data, reset by beginFrame
+		CurenFrameAllocator& getFrameAllocator() { return *m_frameAllocator; }
+		// Descriptor sets of the current frame, reset by beginFrame
+		CurenDescriptorAllocator& getFrameDescriptorAllocator() {
+			assert(m_isFrameStarted && "Can't get frame descriptor allocator when frame is not in progress");
+			return *m_frameDescriptorAllocators[m_currentFrameIndex];
+		}
+
+		// Null when the device has no descriptor indexing, recycled indices advance in beginFrame
+		CurenBindlessTable* getBindlessTable() { return m_bindlessTable.get(); }
 
 		VkCommandBuffer getCurrentCommandBuffer() const { 
 			assert(m_isFrameStarted && "Can't get command buffer when frame is in progress");
@@ -59,9 +73,12 @@ namespace Curen {
 		CurenDevice& m_curenDevice;
 		std::unique_ptr<CurenSwapChain> m_curenSwapChain;
 		std::vector<VkCommandBuffer> m_commandBuffers;
+		std::unique_ptr<CurenFrameAllocator> m_frameAllocator;
+		std::array<std::unique_ptr<CurenDescriptorAllocator>, CurenSwapChain::MAX_FRAMES_IN_FLIGHT> m_frameDescriptorAllocators;
+		std::unique_ptr<CurenBindlessTable> m_bindlessTable;
 
 		uint32_t m_currentImageIndex;
-		int m_currentFrameIndex;
-		bool m_isFrameStarted;
+		int m_currentFrameIndex = 0;
+		bool m_isFrameStarted = false;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "curen_shader_library.hpp"
+
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+using namespace Curen;
+
+// Generated by compile.bat, each file is the brace enclosed initializer glslc -mfmt=c writes
+static constexpr uint32_t FIRST_SHADER_VERT[] =
+#include "generated/first_shader.vert.spv.inc"
+;
+static constexpr uint32_t FIRST_SHADER_COMPACT_VERT[] =
+#include "generated/first_shader_compact.vert.spv.inc"
+;
+static constexpr uint32_t FIRST_SHADER_BINDLESS_VERT[] =
+#include "generated/first_shader_bindless.vert.spv.inc"
+;
+static constexpr uint32_t FIRST_SHADER_BINDLESS_COMPACT_VERT[] =
+#include "generated/first_shader_bindless_compact.vert.spv.inc"
+;
+static constexpr uint32_t FIRST_SHADER_FRAG[] =
+#include "generated/first_shader.frag.spv.inc"
+;
+static constexpr uint32_t POINT_LIGHT_VERT[] =
+#include "generated/point_light.vert.spv.inc"
+;
+static constexpr uint32_t POINT_LIGHT_FRAG[] =
+#include "generated/point_light.frag.spv.inc"
+;
+static constexpr uint32_t MESHLET_CULL_COMP[] =
+#include "generated/meshlet_cull.comp.spv.inc"
+;
+
+struct EmbeddedShader {
+	const char* fileName;
+	ShaderCode code;
+};
+
+static constexpr EmbeddedShader EMBEDDED_SHADERS[] = {
+	{ "first_shader.vert.spv", { FIRST_SHADER_VERT, sizeof(FIRST_SHADER_VERT) } },
+	{ "first_shader_compact.vert.spv", { FIRST_SHADER_COMPACT_VERT, sizeof(FIRST_SHADER_COMPACT_VERT) } },
+	{ "first_shader_bindless.vert.spv", { FIRST_SHADER_BINDLESS_VERT, sizeof(FIRST_SHADER_BINDLESS_VERT) } },
+	{ "first_shader_bindless_compact.vert.spv", { FIRST_SHADER_BINDLESS_COMPACT_VERT, sizeof(FIRST_SHADER_BINDLESS_COMPACT_VERT) } },
+	{ "first_shader.frag.spv", { FIRST_SHADER_FRAG, sizeof(FIRST_SHADER_FRAG) } },
+	{ "point_light.vert.spv", { POINT_LIGHT_VERT, sizeof(POINT_LIGHT_VERT) } },
+	{ "point_light.frag.spv", { POINT_LIGHT_FRAG, sizeof(POINT_LIGHT_FRAG) } },
+	{ "meshlet_cull.comp.spv", { MESHLET_CULL_COMP, sizeof(MESHLET_CULL_COMP) } },
+};
+
+// Pipelines are compiled on the thread pool, so the loaded files are shared under a lock. They stay loaded for the
+// whole process, the ShaderCode handed out points into them
+static std::mutex s_overrideMutex;
+static std::string s_overrideDirectory;
+static std::unordered_map<std::string, std::vector<uint32_t>> s_loadedShaders;
+
+static std::vector<uint32_t> readFile(const std::string& filePath)
+{
+	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open the file : " + filePath);
+	}
+
+	std::size_t fileSize = static_cast<std::size_t>(file.tellg());
+	if (fileSize % sizeof(uint32_t) != 0) {
+		throw std::runtime_error("not a SPIR-V file, its size is no multiple of 4: " + filePath);
+	}
+	std::vector<uint32_t> words(fileSize / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(words.data()), fileSize);
+	return words;
+}
+
+ShaderCode CurenShaderLibrary::get(const std::string& fileName)
+{
+	{
+		std::lock_guard<std::mutex> lock{ s_overrideMutex };
+		if (!s_overrideDirectory.empty()) {
+			std::string filePath = s_overrideDirectory + "/" + fileName;
+			auto loaded = s_loadedShaders.find(filePath);
+			if (loaded == s_loadedShaders.end()) {
+				loaded = s_loadedShaders.emplace(filePath, readFile(filePath)).first;
+			}
+			return ShaderCode{ loaded->second.data(), loaded->second.size() * sizeof(uint32_t) };
+		}
+	}
+
+	for (const EmbeddedShader& shader : EMBEDDED_SHADERS) {
+		if (fileName == shader.fileName) {
+			return shader.code;
+		}
+	}
+	throw std::runtime_error("no embedded shader named " + fileName + ", add it to compile.bat and EMBEDDED_SHADERS");
+}
+
+void CurenShaderLibrary::setOverrideDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock{ s_overrideMutex };
+	s_overrideDirectory = directory;
+}
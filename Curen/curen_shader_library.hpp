@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Curen {
+
+	// SPIR-V of one stage, does not own its words
+	struct ShaderCode {
+		const uint32_t* code = nullptr;
+		// In bytes, as in VkShaderModuleCreateInfo
+		std::size_t size = 0;
+	};
+
+	// The shaders compile.bat builds, embedded in the binary by their .spv file name so pipeline creation reads no
+	// files. With an override directory, for iterating on shaders without rebuilding, they are loaded from there
+	// instead, once per process.
+	class CurenShaderLibrary {
+	public:
+		// Throws for a shader that is neither embedded nor, with an override directory, readable
+		static ShaderCode get(const std::string& fileName);
+		// Before any pipeline is created, an empty directory goes back to the embedded shaders
+		static void setOverrideDirectory(const std::string& directory);
+	};
+}
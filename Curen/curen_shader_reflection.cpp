@@ -0,0 +1,405 @@
+#include "curen_shader_reflection.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace Curen;
+
+namespace {
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+	constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+
+	// The few opcodes, decorations and enums of the SPIR-V specification needed for resource interfaces
+	enum Opcode : uint32_t {
+		OP_NAME = 5,
+		OP_MEMBER_NAME = 6,
+		OP_ENTRY_POINT = 15,
+		OP_TYPE_BOOL = 20,
+		OP_TYPE_INT = 21,
+		OP_TYPE_FLOAT = 22,
+		OP_TYPE_VECTOR = 23,
+		OP_TYPE_MATRIX = 24,
+		OP_TYPE_IMAGE = 25,
+		OP_TYPE_SAMPLER = 26,
+		OP_TYPE_SAMPLED_IMAGE = 27,
+		OP_TYPE_ARRAY = 28,
+		OP_TYPE_RUNTIME_ARRAY = 29,
+		OP_TYPE_STRUCT = 30,
+		OP_TYPE_POINTER = 32,
+		OP_CONSTANT = 43,
+		OP_FUNCTION = 54,
+		OP_FUNCTION_CALL = 57,
+		OP_VARIABLE = 59,
+		OP_IMAGE_TEXEL_POINTER = 60,
+		OP_LOAD = 61,
+		OP_STORE = 62,
+		OP_COPY_MEMORY = 63,
+		OP_ACCESS_CHAIN = 65,
+		OP_IN_BOUNDS_ACCESS_CHAIN = 66,
+		OP_PTR_ACCESS_CHAIN = 67,
+		OP_ARRAY_LENGTH = 68,
+		OP_DECORATE = 71,
+		OP_MEMBER_DECORATE = 72,
+		OP_ATOMIC_LOAD = 227,
+		OP_ATOMIC_STORE = 228,
+		OP_ATOMIC_XOR = 242,
+	};
+
+	enum Decoration : uint32_t {
+		DECORATION_BLOCK = 2,
+		DECORATION_BUFFER_BLOCK = 3,
+		DECORATION_ROW_MAJOR = 4,
+		DECORATION_ARRAY_STRIDE = 6,
+		DECORATION_MATRIX_STRIDE = 7,
+		DECORATION_BINDING = 33,
+		DECORATION_DESCRIPTOR_SET = 34,
+		DECORATION_OFFSET = 35,
+	};
+
+	enum StorageClass : uint32_t {
+		STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+		STORAGE_CLASS_UNIFORM = 2,
+		STORAGE_CLASS_PUSH_CONSTANT = 9,
+		STORAGE_CLASS_STORAGE_BUFFER = 12,
+	};
+
+	constexpr uint32_t DIM_BUFFER = 5;
+	constexpr uint32_t DIM_SUBPASS_DATA = 6;
+	// Sampled operand of OpTypeImage, 2 means read and written without a sampler
+	constexpr uint32_t IMAGE_STORAGE = 2;
+
+	// By execution model
+	const VkShaderStageFlagBits EXECUTION_MODEL_STAGES[] = {
+		VK_SHADER_STAGE_VERTEX_BIT,
+		VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+		VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+		VK_SHADER_STAGE_GEOMETRY_BIT,
+		VK_SHADER_STAGE_FRAGMENT_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+	};
+
+	std::string readString(const uint32_t* words, uint32_t wordCount)
+	{
+		const char* text = reinterpret_cast<const char*>(words);
+		return std::string(text, strnlen(text, wordCount * sizeof(uint32_t)));
+	}
+
+	struct Variable {
+		uint32_t id;
+		uint32_t pointerType;
+		uint32_t storageClass;
+	};
+}
+
+CurenShaderReflection::CurenShaderReflection(const uint32_t* code, std::size_t codeSize)
+{
+	if (codeSize % sizeof(uint32_t) != 0 || codeSize / sizeof(uint32_t) < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+		throw std::runtime_error("shader reflection: not a SPIR-V module");
+	}
+	parse(code, codeSize / sizeof(uint32_t));
+}
+
+const CurenShaderReflection::Struct* CurenShaderReflection::findStruct(const std::string& name) const
+{
+	auto found = std::find_if(m_structs.begin(), m_structs.end(), [&name](const Struct& reflected) { return reflected.name == name; });
+	return found != m_structs.end() ? &*found : nullptr;
+}
+
+void CurenShaderReflection::parse(const uint32_t* code, std::size_t wordCount)
+{
+	std::vector<Variable> variables;
+	std::unordered_set<uint32_t> usedIds;
+	bool isInFunction = false;
+	bool hasEntryPoint = false;
+
+	for (std::size_t position = SPIRV_HEADER_WORDS; position < wordCount;) {
+		uint32_t instructionWords = code[position] >> 16;
+		uint32_t opcode = code[position] & 0xffff;
+		if (instructionWords == 0 || position + instructionWords > wordCount) {
+			throw std::runtime_error("shader reflection: truncated SPIR-V instruction");
+		}
+		const uint32_t* operands = code + position + 1;
+		uint32_t operandCount = instructionWords - 1;
+		position += instructionWords;
+
+		// The pointer operands of instructions that touch a resource
+		if (isInFunction) {
+			switch (opcode) {
+			case OP_LOAD:
+			case OP_ACCESS_CHAIN:
+			case OP_IN_BOUNDS_ACCESS_CHAIN:
+			case OP_PTR_ACCESS_CHAIN:
+			case OP_ARRAY_LENGTH:
+			case OP_IMAGE_TEXEL_POINTER:
+				usedIds.insert(operands[2]);
+				break;
+			case OP_STORE:
+			case OP_ATOMIC_STORE:
+				usedIds.insert(operands[0]);
+				break;
+			case OP_COPY_MEMORY:
+				usedIds.insert(operands[0]);
+				usedIds.insert(operands[1]);
+				break;
+			case OP_FUNCTION_CALL:
+				usedIds.insert(operands + 3, operands + operandCount);
+				break;
+			default:
+				if (opcode >= OP_ATOMIC_LOAD && opcode <= OP_ATOMIC_XOR) {
+					usedIds.insert(operands[2]);
+				}
+				break;
+			}
+			continue;
+		}
+
+		switch (opcode) {
+		case OP_ENTRY_POINT:
+			if (hasEntryPoint) {
+				throw std::runtime_error("shader reflection: only modules with a single entry point are supported");
+			}
+			if (operands[0] >= std::size(EXECUTION_MODEL_STAGES)) {
+				throw std::runtime_error("shader reflection: unsupported execution model " + std::to_string(operands[0]));
+			}
+			m_stage = EXECUTION_MODEL_STAGES[operands[0]];
+			hasEntryPoint = true;
+			break;
+		case OP_NAME:
+			m_names[operands[0]] = readString(operands + 1, operandCount - 1);
+			break;
+		case OP_MEMBER_NAME: {
+			auto& names = m_memberNames[operands[0]];
+			names.resize(std::max<std::size_t>(names.size(), operands[1] + 1));
+			names[operands[1]] = readString(operands + 2, operandCount - 2);
+			break;
+		}
+		case OP_DECORATE:
+		case OP_MEMBER_DECORATE: {
+			Decorations* decorations;
+			if (opcode == OP_DECORATE) {
+				decorations = &m_decorations[operands[0]];
+				operands += 1;
+				operandCount -= 1;
+			}
+			else {
+				auto& members = m_memberDecorations[operands[0]];
+				members.resize(std::max<std::size_t>(members.size(), operands[1] + 1));
+				decorations = &members[operands[1]];
+				operands += 2;
+				operandCount -= 2;
+			}
+			uint32_t literal = operandCount > 1 ? operands[1] : 0;
+			switch (operands[0]) {
+			case DECORATION_BLOCK: decorations->isBlock = true; break;
+			case DECORATION_BUFFER_BLOCK: decorations->isBufferBlock = true; break;
+			case DECORATION_ROW_MAJOR: decorations->isRowMajor = true; break;
+			case DECORATION_ARRAY_STRIDE: decorations->arrayStride = literal; break;
+			case DECORATION_MATRIX_STRIDE: decorations->matrixStride = literal; break;
+			case DECORATION_BINDING: decorations->binding = literal; break;
+			case DECORATION_DESCRIPTOR_SET: decorations->set = literal; break;
+			case DECORATION_OFFSET: decorations->offset = literal; break;
+			default: break;
+			}
+			break;
+		}
+		case OP_TYPE_BOOL:
+		case OP_TYPE_SAMPLER:
+			m_types[operands[0]].opcode = opcode;
+			break;
+		case OP_TYPE_INT:
+		case OP_TYPE_FLOAT: {
+			Type& type = m_types[operands[0]];
+			type.opcode = opcode;
+			type.width = operands[1];
+			break;
+		}
+		case OP_TYPE_VECTOR:
+		case OP_TYPE_MATRIX:
+		case OP_TYPE_ARRAY: {
+			Type& type = m_types[operands[0]];
+			type.opcode = opcode;
+			type.elementType = operands[1];
+			type.count = operands[2];
+			break;
+		}
+		case OP_TYPE_RUNTIME_ARRAY:
+		case OP_TYPE_SAMPLED_IMAGE: {
+			Type& type = m_types[operands[0]];
+			type.opcode = opcode;
+			type.elementType = operands[1];
+			break;
+		}
+		case OP_TYPE_IMAGE: {
+			Type& type = m_types[operands[0]];
+			type.opcode = opcode;
+			type.dim = operands[2];
+			type.sampled = operands[6];
+			break;
+		}
+		case OP_TYPE_STRUCT: {
+			Type& type = m_types[operands[0]];
+			type.opcode = opcode;
+			type.members.assign(operands + 1, operands + operandCount);
+			break;
+		}
+		case OP_TYPE_POINTER: {
+			Type& type = m_types[operands[0]];
+			type.opcode = opcode;
+			type.storageClass = operands[1];
+			type.elementType = operands[2];
+			break;
+		}
+		case OP_CONSTANT:
+			m_constants[operands[1]] = operands[2];
+			break;
+		case OP_VARIABLE:
+			variables.push_back({ operands[1], operands[0], operands[2] });
+			break;
+		case OP_FUNCTION:
+			isInFunction = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	for (auto& variable : variables) {
+		uint32_t typeId = m_types[variable.pointerType].elementType;
+		if (variable.storageClass == STORAGE_CLASS_PUSH_CONSTANT) {
+			Struct block = reflectStruct(typeId);
+			uint32_t offset = block.size;
+			for (auto& member : block.members) {
+				offset = std::min(offset, member.offset);
+			}
+			m_pushConstantRange.stageFlags = usedIds.count(variable.id) != 0 ? m_stage : 0;
+			m_pushConstantRange.offset = offset;
+			m_pushConstantRange.size = block.size - offset;
+			continue;
+		}
+		if (variable.storageClass != STORAGE_CLASS_UNIFORM_CONSTANT && variable.storageClass != STORAGE_CLASS_UNIFORM &&
+			variable.storageClass != STORAGE_CLASS_STORAGE_BUFFER) {
+			continue;
+		}
+
+		Binding binding{};
+		binding.set = m_decorations[variable.id].set;
+		binding.binding = m_decorations[variable.id].binding;
+		binding.descriptorCount = 1;
+		binding.isUsed = usedIds.count(variable.id) != 0;
+		const Type* type = &m_types[typeId];
+		if (type->opcode == OP_TYPE_ARRAY) {
+			binding.descriptorCount = m_constants[type->count];
+			typeId = type->elementType;
+		}
+		else if (type->opcode == OP_TYPE_RUNTIME_ARRAY) {
+			binding.descriptorCount = 0;
+			typeId = type->elementType;
+		}
+		type = &m_types[typeId];
+
+		if (type->opcode == OP_TYPE_STRUCT) {
+			bool isStorage = variable.storageClass == STORAGE_CLASS_STORAGE_BUFFER || m_decorations[typeId].isBufferBlock;
+			binding.descriptorType = isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		}
+		else if (type->opcode == OP_TYPE_SAMPLER) {
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		}
+		else if (type->opcode == OP_TYPE_SAMPLED_IMAGE) {
+			bool isTexelBuffer = m_types[type->elementType].dim == DIM_BUFFER;
+			binding.descriptorType = isTexelBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		}
+		else if (type->opcode == OP_TYPE_IMAGE) {
+			bool isStorage = type->sampled == IMAGE_STORAGE;
+			if (type->dim == DIM_SUBPASS_DATA) {
+				binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+			else if (type->dim == DIM_BUFFER) {
+				binding.descriptorType = isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			else {
+				binding.descriptorType = isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+		}
+		else {
+			throw std::runtime_error("shader reflection: unsupported resource type at set " + std::to_string(binding.set) +
+				" binding " + std::to_string(binding.binding));
+		}
+		m_bindings.push_back(binding);
+	}
+	std::sort(m_bindings.begin(), m_bindings.end(), [](const Binding& a, const Binding& b) {
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+
+	for (auto& kv : m_types) {
+		auto name = m_names.find(kv.first);
+		if (kv.second.opcode == OP_TYPE_STRUCT && name != m_names.end() && !name->second.empty()) {
+			m_structs.push_back(reflectStruct(kv.first));
+		}
+	}
+}
+
+uint32_t CurenShaderReflection::typeSize(uint32_t typeId, const Decorations& decorations) const
+{
+	auto found = m_types.find(typeId);
+	if (found == m_types.end()) {
+		throw std::runtime_error("shader reflection: unknown type id " + std::to_string(typeId));
+	}
+	const Type& type = found->second;
+	switch (type.opcode) {
+	case OP_TYPE_BOOL:
+		return 4;
+	case OP_TYPE_INT:
+	case OP_TYPE_FLOAT:
+		return type.width / 8;
+	case OP_TYPE_VECTOR:
+		return type.count * typeSize(type.elementType, decorations);
+	case OP_TYPE_MATRIX: {
+		// Column major stores count columns, row major one stride per row
+		uint32_t rowCount = m_types.at(type.elementType).count;
+		uint32_t stride = decorations.matrixStride != 0 ? decorations.matrixStride : typeSize(type.elementType, decorations);
+		return (decorations.isRowMajor ? rowCount : type.count) * stride;
+	}
+	case OP_TYPE_ARRAY: {
+		auto arrayDecorations = m_decorations.find(typeId);
+		uint32_t stride = arrayDecorations != m_decorations.end() ? arrayDecorations->second.arrayStride : 0;
+		if (stride == 0) {
+			stride = typeSize(type.elementType, decorations);
+		}
+		return m_constants.at(type.count) * stride;
+	}
+	case OP_TYPE_RUNTIME_ARRAY:
+		return 0;
+	case OP_TYPE_STRUCT:
+		return reflectStruct(typeId).size;
+	default:
+		throw std::runtime_error("shader reflection: type id " + std::to_string(typeId) + " has no size");
+	}
+}
+
+CurenShaderReflection::Struct CurenShaderReflection::reflectStruct(uint32_t typeId) const
+{
+	const Type& type = m_types.at(typeId);
+	auto name = m_names.find(typeId);
+	auto memberNames = m_memberNames.find(typeId);
+	auto memberDecorations = m_memberDecorations.find(typeId);
+
+	Struct reflected{};
+	reflected.name = name != m_names.end() ? name->second : std::string{};
+	for (std::size_t i = 0; i < type.members.size(); i++) {
+		Decorations decorations{};
+		if (memberDecorations != m_memberDecorations.end() && i < memberDecorations->second.size()) {
+			decorations = memberDecorations->second[i];
+		}
+		Member member{};
+		if (memberNames != m_memberNames.end() && i < memberNames->second.size()) {
+			member.name = memberNames->second[i];
+		}
+		member.offset = decorations.offset;
+		member.size = typeSize(type.members[i], decorations);
+		reflected.size = std::max(reflected.size, member.offset + member.size);
+		reflected.members.push_back(std::move(member));
+	}
+	return reflected;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Curen {
+
+	// Reads the resource interface of one SPIR-V module: its descriptor bindings, its push constant block and the
+	// explicit layout of its structs. Only what pipeline layouts and the C++ side need, no full type system.
+	// A resource counts as used when a function of the module loads, stores, indexes or passes it.
+	class CurenShaderReflection {
+	public:
+		struct Binding {
+			uint32_t set;
+			uint32_t binding;
+			VkDescriptorType descriptorType;
+			// 0 for runtime sized arrays
+			uint32_t descriptorCount;
+			bool isUsed;
+		};
+
+		struct Member {
+			std::string name;
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		struct Struct {
+			std::string name;
+			// End of the last member, without the trailing padding of an array element
+			uint32_t size;
+			std::vector<Member> members;
+		};
+
+		// codeSize in bytes, as in VkShaderModuleCreateInfo
+		CurenShaderReflection(const uint32_t* code, std::size_t codeSize);
+
+		VkShaderStageFlagBits getStage() const { return m_stage; }
+		const std::vector<Binding>& getBindings() const { return m_bindings; }
+		// Zero size without a push constant block, zero stageFlags when the block is declared but never used
+		const VkPushConstantRange& getPushConstantRange() const { return m_pushConstantRange; }
+		// By the struct's type name, the block name for uniform, storage and push constant blocks. Null when the
+		// module has no such struct or was compiled without names
+		const Struct* findStruct(const std::string& name) const;
+
+	private:
+		struct Type {
+			uint32_t opcode = 0;
+			// Component type of vectors, column type of matrices, element type of arrays, pointee of pointers
+			uint32_t elementType = 0;
+			// Vector size, matrix column count, array length id
+			uint32_t count = 0;
+			uint32_t width = 0;
+			// Image dimension and sampled operand
+			uint32_t dim = 0;
+			uint32_t sampled = 0;
+			uint32_t storageClass = 0;
+			std::vector<uint32_t> members;
+		};
+
+		struct Decorations {
+			uint32_t set = 0;
+			uint32_t binding = 0;
+			uint32_t offset = 0;
+			uint32_t arrayStride = 0;
+			uint32_t matrixStride = 0;
+			bool isBlock = false;
+			bool isBufferBlock = false;
+			bool isRowMajor = false;
+		};
+
+		void parse(const uint32_t* code, std::size_t wordCount);
+		uint32_t typeSize(uint32_t typeId, const Decorations& decorations) const;
+		Struct reflectStruct(uint32_t typeId) const;
+
+		VkShaderStageFlagBits m_stage = VK_SHADER_STAGE_VERTEX_BIT;
+		std::vector<Binding> m_bindings;
+		VkPushConstantRange m_pushConstantRange{};
+
+		std::unordered_map<uint32_t, Type> m_types;
+		std::unordered_map<uint32_t, uint32_t> m_constants;
+		std::unordered_map<uint32_t, std::string> m_names;
+		std::unordered_map<uint32_t, Decorations> m_decorations;
+		// Per struct type, per member index
+		std::unordered_map<uint32_t, std::vector<Decorations>> m_memberDecorations;
+		std::unordered_map<uint32_t, std::vector<std::string>> m_memberNames;
+		// Every named struct, filled once parsing is done
+		std::vector<Struct> m_structs;
+	};
+}
@@ -0,0 +1,119 @@
+#include "curen_thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+using namespace Curen;
+
+namespace {
+	struct ParallelForState {
+		std::function<void(std::size_t)> job;
+		std::size_t count = 0;
+		std::atomic<std::size_t> nextIndex{ 0 };
+		std::atomic<std::size_t> finishedCount{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+
+		// Claims indices until none are left, returns when this thread ran out of work
+		void run() {
+			for (std::size_t i = nextIndex++; i < count; i = nextIndex++) {
+				try {
+					job(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock{ mutex };
+					if (!error) {
+						error = std::current_exception();
+					}
+				}
+				if (++finishedCount == count) {
+					std::lock_guard<std::mutex> lock{ mutex };
+					finished.notify_all();
+				}
+			}
+		}
+	};
+}
+
+CurenThreadPool::CurenThreadPool(uint32_t threadCount)
+{
+	threadCount = std::max(threadCount, 1u);
+	m_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		m_workers.emplace_back([this]() { workerLoop(); });
+	}
+}
+
+CurenThreadPool::~CurenThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_isStopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+CurenThreadPool& CurenThreadPool::shared()
+{
+	static CurenThreadPool pool{};
+	return pool;
+}
+
+void CurenThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& job)
+{
+	if (count == 0) {
+		return;
+	}
+	if (count == 1) {
+		job(0);
+		return;
+	}
+
+	auto state = std::make_shared<ParallelForState>();
+	state->job = job;
+	state->count = count;
+
+	// Helpers that start after the work is gone return immediately, the caller never waits on them
+	std::size_t helperCount = std::min<std::size_t>(m_workers.size(), count - 1);
+	for (std::size_t i = 0; i < helperCount; i++) {
+		enqueue([state]() { state->run(); });
+	}
+
+	state->run();
+
+	std::unique_lock<std::mutex> lock{ state->mutex };
+	state->finished.wait(lock, [&state]() { return state->finishedCount == state->count; });
+	if (state->error) {
+		std::rethrow_exception(state->error);
+	}
+}
+
+void CurenThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_tasks.push(std::move(task));
+	}
+	m_condition.notify_one();
+}
+
+void CurenThreadPool::workerLoop()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_condition.wait(lock, [this]() { return m_isStopping || !m_tasks.empty(); });
+			if (m_isStopping && m_tasks.empty()) {
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+	}
+}
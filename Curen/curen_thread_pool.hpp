@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Curen {
+
+	class CurenThreadPool {
+	public:
+		CurenThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+		~CurenThreadPool();
+
+		CurenThreadPool(const CurenThreadPool&) = delete;
+		CurenThreadPool& operator = (const CurenThreadPool&) = delete;
+
+		// Process wide pool for short CPU bound jobs such as mesh import
+		static CurenThreadPool& shared();
+
+		template <typename Task>
+		auto submit(Task&& task) -> std::future<decltype(task())> {
+			using Result = decltype(task());
+			auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+			std::future<Result> result = packagedTask->get_future();
+			enqueue([packagedTask]() { (*packagedTask)(); });
+			return result;
+		}
+
+		// Runs job(i) for every i in [0, count) and returns once all of them finished.
+		// The calling thread takes part in the work, so it is safe to call from inside a pool job.
+		void parallelFor(std::size_t count, const std::function<void(std::size_t)>& job);
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	private:
+		void enqueue(std::function<void()> task);
+		void workerLoop();
+
+		std::vector<std::thread> m_workers;
+		std::queue<std::function<void()>> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_isStopping = false;
+	};
+}
@@ -0,0 +1,37 @@
+#include "curen_upload_batch.hpp"
+
+#include <stdexcept>
+
+using namespace Curen;
+
+CurenUploadBatch::CurenUploadBatch(CurenDevice& curenDevice) : m_curenDevice{ curenDevice }
+{
+}
+
+void CurenUploadBatch::copyToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	if (m_isSubmitted) {
+		throw std::runtime_error("upload batch was already submitted!");
+	}
+	m_curenDevice.uploadManager().copyToBuffer(dstBuffer, dstOffset, data, size);
+	m_uploadedSize += size;
+}
+
+void CurenUploadBatch::submit()
+{
+	if (m_isSubmitted) {
+		throw std::runtime_error("upload batch was already submitted!");
+	}
+	m_submitValue = m_curenDevice.uploadManager().submit();
+	m_isSubmitted = true;
+}
+
+bool CurenUploadBatch::isComplete() const
+{
+	return m_isSubmitted && m_curenDevice.uploadManager().isComplete(m_submitValue);
+}
+
+void CurenUploadBatch::wait() const
+{
+	m_curenDevice.uploadManager().wait(m_submitValue);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_upload_manager.hpp"
+
+#include <cstdint>
+
+namespace Curen {
+
+	// A group of uploads that completes together. The copies go through the device's CurenUploadManager, so they
+	// share its staging ring and command buffer with every other batch recorded before the same submit. Render
+	// thread only.
+	class CurenUploadBatch {
+	public:
+		CurenUploadBatch(CurenDevice& curenDevice);
+
+		CurenUploadBatch(const CurenUploadBatch&) = delete;
+		CurenUploadBatch& operator = (const CurenUploadBatch&) = delete;
+
+		// data is copied into staging memory right away
+		void copyToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+		// Makes the copies visible to vertex input and shader reads of later submissions
+		void submit();
+		bool isSubmitted() const { return m_isSubmitted; }
+		// Never blocks, false until the submission has completed
+		bool isComplete() const;
+		void wait() const;
+
+		VkDeviceSize getUploadedSize() const { return m_uploadedSize; }
+
+	private:
+		CurenDevice& m_curenDevice;
+
+		uint64_t m_submitValue = 0;
+		bool m_isSubmitted = false;
+		VkDeviceSize m_uploadedSize = 0;
+	};
+}
@@ -0,0 +1,391 @@
+#include "curen_upload_manager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+using namespace Curen;
+
+namespace {
+	// Every stage a graphics or compute pass reads uploaded data in
+	constexpr VkPipelineStageFlags CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	constexpr VkAccessFlags CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+}
+
+CurenUploadManager::CurenUploadManager(CurenDevice& curenDevice, VkDeviceSize ringSize) :
+	m_curenDevice{ curenDevice }
+{
+	QueueFamilyIndices queueFamilies = m_curenDevice.findPhysicalQueueFamilies();
+	m_isTransferringOwnership = queueFamilies.hasDedicatedTransferFamily();
+	m_transferFamily = queueFamilies.transferFamily;
+	m_graphicsFamily = queueFamilies.graphicsFamily;
+
+	// Image copies need offsets on a multiple of the texel size, 16 covers every uncompressed format
+	m_alignment = std::max<VkDeviceSize>(m_curenDevice.properties.limits.optimalBufferCopyOffsetAlignment, 16);
+	m_ringSize = (ringSize + m_alignment - 1) / m_alignment * m_alignment;
+
+	m_ringBuffer = std::make_unique<CurenBuffer>(
+		m_curenDevice,
+		m_ringSize,
+		1,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (m_ringBuffer->map() != VK_SUCCESS) {
+		throw std::runtime_error("failed to map staging ring!");
+	}
+	m_ringData = static_cast<char*>(m_ringBuffer->getMappedMemory());
+}
+
+CurenUploadManager::~CurenUploadManager()
+{
+	submit();
+	while (!m_submissions.empty()) {
+		retireOldest();
+	}
+	VkDevice device = m_curenDevice.device();
+	for (auto& commands : m_freeCommands) {
+		vkDestroyFence(device, commands.fence, nullptr);
+		vkFreeCommandBuffers(device, m_curenDevice.getTransferCommandPool(), 1, &commands.transferCommandBuffer);
+		if (m_isTransferringOwnership) {
+			vkDestroySemaphore(device, commands.semaphore, nullptr);
+			vkFreeCommandBuffers(device, m_curenDevice.getCommandPool(), 1, &commands.acquireCommandBuffer);
+		}
+	}
+}
+
+void CurenUploadManager::copyToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const char* source = static_cast<const char*>(data);
+	while (size > 0) {
+		VkDeviceSize chunkSize = std::min(size, m_ringSize);
+		VkDeviceSize ringOffset = reserve(chunkSize);
+		std::memcpy(m_ringData + ringOffset, source, chunkSize);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = ringOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = chunkSize;
+		vkCmdCopyBuffer(getCommandBuffer(), m_ringBuffer->getBuffer(), dstBuffer, 1, &copyRegion);
+		addBufferTransfer(dstBuffer, dstOffset, chunkSize);
+
+		m_statistics.copyCount++;
+		m_statistics.uploadedSize += chunkSize;
+		source += chunkSize;
+		dstOffset += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+void CurenUploadManager::copyToImage(VkImage dstImage, uint32_t width, uint32_t height, uint32_t layerCount, const void* data, VkDeviceSize size)
+{
+	if (size > m_ringSize) {
+		throw std::runtime_error("image upload is larger than the staging ring!");
+	}
+	VkDeviceSize ringOffset = reserve(size);
+	std::memcpy(m_ringData + ringOffset, data, size);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = ringOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = layerCount;
+
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyBufferToImage(getCommandBuffer(), m_ringBuffer->getBuffer(), dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	if (m_isTransferringOwnership) {
+		// The layout stays TRANSFER_DST_OPTIMAL, the caller transitions it on the graphics queue
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = m_transferFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsFamily;
+		barrier.image = dstImage;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount };
+		m_imageTransfers.push_back(barrier);
+	}
+
+	m_statistics.copyCount++;
+	m_statistics.uploadedSize += size;
+}
+
+uint64_t CurenUploadManager::submit()
+{
+	if (m_commands.transferCommandBuffer == VK_NULL_HANDLE) {
+		return m_nextValue - 1;
+	}
+
+	if (m_isTransferringOwnership) {
+		recordOwnershipTransfers();
+	}
+	else {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = CONSUMER_ACCESS;
+		vkCmdPipelineBarrier(
+			m_commands.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			CONSUMER_STAGES,
+			0,
+			1,
+			&barrier,
+			0,
+			nullptr,
+			0,
+			nullptr);
+	}
+	vkEndCommandBuffer(m_commands.transferCommandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_commands.transferCommandBuffer;
+	if (m_isTransferringOwnership) {
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &m_commands.semaphore;
+	}
+	if (vkQueueSubmit(m_curenDevice.transferQueue(), 1, &submitInfo, m_isTransferringOwnership ? VK_NULL_HANDLE : m_commands.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit uploads!");
+	}
+
+	if (m_isTransferringOwnership) {
+		// The acquire only runs once the copies are done, its fence covers both submissions
+		VkPipelineStageFlags waitStage = CONSUMER_STAGES;
+		VkSubmitInfo acquireInfo{};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.waitSemaphoreCount = 1;
+		acquireInfo.pWaitSemaphores = &m_commands.semaphore;
+		acquireInfo.pWaitDstStageMask = &waitStage;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &m_commands.acquireCommandBuffer;
+		if (vkQueueSubmit(m_curenDevice.graphicsQueue(), 1, &acquireInfo, m_commands.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload ownership acquire!");
+		}
+	}
+
+	uint64_t value = m_nextValue++;
+	m_submissions.push_back(Submission{ m_commands, value, m_ringHead });
+	m_commands = Commands{};
+	m_statistics.submitCount++;
+	return value;
+}
+
+bool CurenUploadManager::isComplete(uint64_t value)
+{
+	retireCompleted();
+	return value <= m_completedValue;
+}
+
+void CurenUploadManager::wait(uint64_t value)
+{
+	if (value >= m_nextValue) {
+		submit();
+	}
+	while (m_completedValue < value && !m_submissions.empty()) {
+		retireOldest();
+	}
+}
+
+VkDeviceSize CurenUploadManager::reserve(VkDeviceSize size)
+{
+	uint64_t start = (m_ringHead + m_alignment - 1) / m_alignment * m_alignment;
+	// An allocation never wraps around the end of the ring
+	if (start % m_ringSize + size > m_ringSize) {
+		start = (start / m_ringSize + 1) * m_ringSize;
+	}
+
+	retireCompleted();
+	while (start + size - m_ringTail > m_ringSize) {
+		if (m_submissions.empty() && m_commands.transferCommandBuffer == VK_NULL_HANDLE) {
+			// Nothing recorded or in flight, the whole ring is free
+			m_ringTail = start;
+			break;
+		}
+		// The copies still being recorded hold the space, they have to go out before it can be waited on
+		if (m_submissions.empty()) {
+			submit();
+		}
+		m_statistics.stallCount++;
+		retireOldest();
+	}
+
+	m_ringHead = start + size;
+	return start % m_ringSize;
+}
+
+VkCommandBuffer CurenUploadManager::getCommandBuffer()
+{
+	if (m_commands.transferCommandBuffer != VK_NULL_HANDLE) {
+		return m_commands.transferCommandBuffer;
+	}
+
+	VkDevice device = m_curenDevice.device();
+	if (!m_freeCommands.empty()) {
+		m_commands = m_freeCommands.back();
+		m_freeCommands.pop_back();
+		vkResetFences(device, 1, &m_commands.fence);
+	}
+	else {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = m_curenDevice.getTransferCommandPool();
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &m_commands.transferCommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device, &fenceInfo, nullptr, &m_commands.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		if (m_isTransferringOwnership) {
+			allocInfo.commandPool = m_curenDevice.getCommandPool();
+			if (vkAllocateCommandBuffers(device, &allocInfo, &m_commands.acquireCommandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate upload acquire command buffer!");
+			}
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_commands.semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload semaphore!");
+			}
+		}
+	}
+
+	// Both pools allow resetting single command buffers, beginning implicitly resets a reused one
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(m_commands.transferCommandBuffer, &beginInfo);
+	return m_commands.transferCommandBuffer;
+}
+
+void CurenUploadManager::addBufferTransfer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (!m_isTransferringOwnership) {
+		return;
+	}
+
+	// Models upload back to back into the same arena buffers, so most ranges continue the previous one
+	if (!m_bufferTransfers.empty()) {
+		VkBufferMemoryBarrier& last = m_bufferTransfers.back();
+		if (last.buffer == buffer && last.offset + last.size == offset) {
+			last.size += size;
+			return;
+		}
+	}
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = m_transferFamily;
+	barrier.dstQueueFamilyIndex = m_graphicsFamily;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	m_bufferTransfers.push_back(barrier);
+}
+
+void CurenUploadManager::recordOwnershipTransfers()
+{
+	// Interleaved vertex and index uploads leave runs on several buffers, merge them before recording
+	std::sort(m_bufferTransfers.begin(), m_bufferTransfers.end(), [](const VkBufferMemoryBarrier& a, const VkBufferMemoryBarrier& b) {
+		return a.buffer != b.buffer ? std::less<VkBuffer>{}(a.buffer, b.buffer) : a.offset < b.offset;
+	});
+	size_t mergedCount = 0;
+	for (size_t i = 0; i < m_bufferTransfers.size(); i++) {
+		if (mergedCount > 0) {
+			VkBufferMemoryBarrier& previous = m_bufferTransfers[mergedCount - 1];
+			if (previous.buffer == m_bufferTransfers[i].buffer && previous.offset + previous.size >= m_bufferTransfers[i].offset) {
+				previous.size = std::max(previous.size, m_bufferTransfers[i].offset + m_bufferTransfers[i].size - previous.offset);
+				continue;
+			}
+		}
+		m_bufferTransfers[mergedCount++] = m_bufferTransfers[i];
+	}
+	m_bufferTransfers.resize(mergedCount);
+
+	// Release on the transfer queue. Destination access and stages are ignored by a release.
+	for (auto& barrier : m_bufferTransfers) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+	}
+	for (auto& barrier : m_imageTransfers) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+	}
+	vkCmdPipelineBarrier(
+		m_commands.transferCommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0,
+		nullptr,
+		static_cast<uint32_t>(m_bufferTransfers.size()),
+		m_bufferTransfers.data(),
+		static_cast<uint32_t>(m_imageTransfers.size()),
+		m_imageTransfers.data());
+
+	// The matching acquire on the graphics queue. Its source stages are the ones the semaphore wait blocks, so it
+	// is ordered after the copies, and later graphics submissions are ordered after it.
+	for (auto& barrier : m_bufferTransfers) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = CONSUMER_ACCESS;
+	}
+	for (auto& barrier : m_imageTransfers) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	}
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(m_commands.acquireCommandBuffer, &beginInfo);
+	vkCmdPipelineBarrier(
+		m_commands.acquireCommandBuffer,
+		CONSUMER_STAGES,
+		CONSUMER_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		nullptr,
+		static_cast<uint32_t>(m_bufferTransfers.size()),
+		m_bufferTransfers.data(),
+		static_cast<uint32_t>(m_imageTransfers.size()),
+		m_imageTransfers.data());
+	vkEndCommandBuffer(m_commands.acquireCommandBuffer);
+
+	m_statistics.ownershipTransferCount += m_bufferTransfers.size() + m_imageTransfers.size();
+	m_bufferTransfers.clear();
+	m_imageTransfers.clear();
+}
+
+void CurenUploadManager::retireCompleted()
+{
+	// The fences signal in submission order, with ownership transfers they all come from the graphics queue
+	while (!m_submissions.empty() && vkGetFenceStatus(m_curenDevice.device(), m_submissions.front().commands.fence) == VK_SUCCESS) {
+		Submission& submission = m_submissions.front();
+		m_completedValue = submission.value;
+		m_ringTail = submission.ringHead;
+		m_freeCommands.push_back(submission.commands);
+		m_submissions.pop_front();
+	}
+}
+
+void CurenUploadManager::retireOldest()
+{
+	if (m_submissions.empty()) {
+		return;
+	}
+	vkWaitForFences(m_curenDevice.device(), 1, &m_submissions.front().commands.fence, VK_TRUE, UINT64_MAX);
+	retireCompleted();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "curen_device.hpp"
+#include "curen_buffer.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace Curen {
+
+	// Records uploads from one persistently mapped staging ring into a shared command buffer and submits them
+	// together with a fence. Every submission gets an increasing value, callers poll or wait on the value their
+	// copies went out with, like a timeline semaphore. Ring space is reclaimed once a submission's fence has
+	// signaled, so steady state uploads allocate nothing. Render thread only.
+	//
+	// The copies run on the device's transfer queue. With a dedicated transfer family every destination range is
+	// released to the graphics family after its copy, and a small command buffer on the graphics queue waits on
+	// a semaphore and acquires them, so a completed value means the data is owned by graphics. Without one both
+	// run on the graphics queue and a plain barrier is enough.
+	class CurenUploadManager {
+	public:
+		static constexpr VkDeviceSize DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+
+		struct Statistics {
+			uint64_t submitCount;
+			uint64_t copyCount;
+			VkDeviceSize uploadedSize;
+			// Times a copy had to wait for the GPU to free ring space
+			uint64_t stallCount;
+			// Merged buffer ranges and images handed from the transfer to the graphics family
+			uint64_t ownershipTransferCount;
+		};
+
+		CurenUploadManager(CurenDevice& curenDevice, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+		// Waits for everything in flight
+		~CurenUploadManager();
+
+		CurenUploadManager(const CurenUploadManager&) = delete;
+		CurenUploadManager& operator = (const CurenUploadManager&) = delete;
+
+		// data is copied into the ring right away. Buffer copies larger than the ring are split.
+		void copyToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		// The image has to be in TRANSFER_DST_OPTIMAL when the copy executes
+		void copyToImage(VkImage dstImage, uint32_t width, uint32_t height, uint32_t layerCount, const void* data, VkDeviceSize size);
+
+		// Makes the recorded copies visible to vertex input and shader reads of later graphics submissions and
+		// returns the value to poll. Without recorded copies it returns the value of the last submission.
+		uint64_t submit();
+		bool isComplete(uint64_t value);
+		void wait(uint64_t value);
+
+		Statistics getStatistics() const { return m_statistics; }
+
+	private:
+		struct Commands {
+			VkCommandBuffer transferCommandBuffer;
+			// Ownership acquire on the graphics queue, VK_NULL_HANDLE without a dedicated transfer family
+			VkCommandBuffer acquireCommandBuffer;
+			VkSemaphore semaphore;
+			VkFence fence;
+		};
+
+		struct Submission {
+			Commands commands;
+			uint64_t value;
+			// Ring head when the submission went out, everything before it is free once the fence signals
+			uint64_t ringHead;
+		};
+
+		// Returns the ring offset of size bytes, submitting and waiting when the ring is full
+		VkDeviceSize reserve(VkDeviceSize size);
+		VkCommandBuffer getCommandBuffer();
+		void addBufferTransfer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+		void recordOwnershipTransfers();
+		void retireCompleted();
+		void retireOldest();
+
+		CurenDevice& m_curenDevice;
+		bool m_isTransferringOwnership;
+		uint32_t m_transferFamily;
+		uint32_t m_graphicsFamily;
+
+		std::unique_ptr<CurenBuffer> m_ringBuffer;
+		char* m_ringData;
+		VkDeviceSize m_ringSize;
+		VkDeviceSize m_alignment;
+		// Monotonic positions, the ring offset is position % m_ringSize
+		uint64_t m_ringHead = 0;
+		uint64_t m_ringTail = 0;
+
+		// Recording, the command buffers are VK_NULL_HANDLE until the first copy after a submit
+		Commands m_commands{};
+		std::deque<Submission> m_submissions;
+		std::vector<Commands> m_freeCommands;
+		// Destination ranges of the recorded copies, released and acquired at submit
+		std::vector<VkBufferMemoryBarrier> m_bufferTransfers;
+		std::vector<VkImageMemoryBarrier> m_imageTransfers;
+
+		uint64_t m_nextValue = 1;
+		uint64_t m_completedValue = 0;
+		Statistics m_statistics{};
+	};
+}
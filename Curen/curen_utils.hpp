@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <cstring>
 #include <functional>
 
 namespace Utils {
@@ -7,4 +9,28 @@ namespace Utils {
 		seed ^= std::hash<T>{}(v)+0x9e3779b9 + (seed << 6) + (seed >> 2);
 		(hashCombine(seed, rest), ...);
 	};
-}
\ No newline at end of file
+
+	// 64-bit content hash, eight bytes per step. Not cryptographic, only meant to detect changed files.
+	inline uint64_t hashBytes(const void* data, std::size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed ^ (size * 0x9e3779b97f4a7c15ull);
+
+		std::size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, bytes + i, sizeof(word));
+			word *= 0xff51afd7ed558ccdull;
+			word ^= word >> 32;
+			hash = (hash ^ word) * 0x100000001b3ull;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		}
+
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+}
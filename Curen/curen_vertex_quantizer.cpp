@@ -0,0 +1,108 @@
+#include "curen_vertex_quantizer.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Curen;
+
+namespace {
+	float signNotZero(float value) { return value >= 0.f ? 1.f : -1.f; }
+
+	uint16_t quantizeUnorm16(float value) {
+		return static_cast<uint16_t>(std::lround(std::clamp(value, 0.f, 1.f) * 65535.f));
+	}
+}
+
+glm::mat4 CurenVertexQuantizer::quantize(const CurenModel::Vertex* vertices, uint32_t vertexCount, std::vector<CurenModel::CompactVertex>& compactVertices)
+{
+	glm::vec3 boundsMin{ 0.f };
+	glm::vec3 boundsMax{ 0.f };
+	if (vertexCount > 0) {
+		boundsMin = boundsMax = vertices[0].position;
+	}
+	for (uint32_t i = 1; i < vertexCount; i++) {
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+	glm::vec3 extent = boundsMax - boundsMin;
+
+	compactVertices.resize(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		const CurenModel::Vertex& vertex = vertices[i];
+		CurenModel::CompactVertex& compact = compactVertices[i];
+
+		for (int axis = 0; axis < 3; axis++) {
+			compact.position[axis] = extent[axis] > 0.f ? quantizeUnorm16((vertex.position[axis] - boundsMin[axis]) / extent[axis]) : 0;
+		}
+		compact.position[3] = 65535;
+		compact.normal = encodeOctahedral(vertex.normal);
+		compact.uv = glm::packHalf2x16(vertex.uv);
+		compact.color = glm::packUnorm4x8(glm::vec4{ vertex.color, 1.f });
+	}
+
+	return glm::mat4{
+		{ extent.x, 0.f, 0.f, 0.f },
+		{ 0.f, extent.y, 0.f, 0.f },
+		{ 0.f, 0.f, extent.z, 0.f },
+		{ boundsMin.x, boundsMin.y, boundsMin.z, 1.f } };
+}
+
+CurenVertexQuantizer::QuantizationError CurenVertexQuantizer::measureError(const CurenModel::Vertex* vertices,
+	const std::vector<CurenModel::CompactVertex>& compactVertices, const glm::mat4& dequantization)
+{
+	QuantizationError error{};
+	for (std::size_t i = 0; i < compactVertices.size(); i++) {
+		const CurenModel::Vertex& vertex = vertices[i];
+		const CurenModel::CompactVertex& compact = compactVertices[i];
+
+		glm::vec4 unorm{ compact.position[0] / 65535.f, compact.position[1] / 65535.f, compact.position[2] / 65535.f, 1.f };
+		glm::vec3 position = glm::vec3(dequantization * unorm);
+		error.position = std::max(error.position, glm::length(position - vertex.position));
+
+		float normalLength = glm::length(vertex.normal);
+		if (normalLength > 0.f) {
+			// atan2 rather than acos of the dot product, which cannot resolve angles below about 0.03 degrees in float
+			glm::vec3 normal = vertex.normal / normalLength;
+			glm::vec3 decoded = decodeOctahedral(compact.normal);
+			float angle = std::atan2(glm::length(glm::cross(normal, decoded)), glm::dot(normal, decoded));
+			error.normalDegrees = std::max(error.normalDegrees, glm::degrees(angle));
+		}
+
+		glm::vec2 uv = glm::unpackHalf2x16(compact.uv);
+		error.uv = std::max({ error.uv, std::abs(uv.x - vertex.uv.x), std::abs(uv.y - vertex.uv.y) });
+
+		glm::vec4 color = glm::unpackUnorm4x8(compact.color);
+		for (int channel = 0; channel < 3; channel++) {
+			error.color = std::max(error.color, std::abs(color[channel] - vertex.color[channel]));
+		}
+	}
+	return error;
+}
+
+uint32_t CurenVertexQuantizer::encodeOctahedral(const glm::vec3& normal)
+{
+	float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (sum == 0.f) {
+		return 0;
+	}
+
+	glm::vec2 projected{ normal.x / sum, normal.y / sum };
+	if (normal.z < 0.f) {
+		projected = glm::vec2{
+			(1.f - std::abs(projected.y)) * signNotZero(projected.x),
+			(1.f - std::abs(projected.x)) * signNotZero(projected.y) };
+	}
+	return glm::packSnorm2x16(projected);
+}
+
+glm::vec3 CurenVertexQuantizer::decodeOctahedral(uint32_t encoded)
+{
+	glm::vec2 projected = glm::unpackSnorm2x16(encoded);
+	glm::vec3 normal{ projected.x, projected.y, 1.f - std::abs(projected.x) - std::abs(projected.y) };
+	float fold = std::max(-normal.z, 0.f);
+	normal.x += normal.x >= 0.f ? -fold : fold;
+	normal.y += normal.y >= 0.f ? -fold : fold;
+	return glm::normalize(normal);
+}
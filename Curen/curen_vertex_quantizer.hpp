@@ -0,0 +1,32 @@
+#pragma once
+
+#include "curen_model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Curen {
+
+	// Packs CurenModel::Vertex into CurenModel::CompactVertex. Positions are stored as 16-bit UNORM
+	// relative to the mesh bounds, the returned dequantization matrix maps them back to model space.
+	class CurenVertexQuantizer {
+	public:
+		struct QuantizationError {
+			// Largest position error in model space units
+			float position;
+			// Largest angle between a unit normal and its decoded octahedral normal, in degrees
+			float normalDegrees;
+			float uv;
+			float color;
+		};
+
+		static glm::mat4 quantize(const CurenModel::Vertex* vertices, uint32_t vertexCount, std::vector<CurenModel::CompactVertex>& compactVertices);
+
+		// Decodes compactVertices again and compares them against the source vertices
+		static QuantizationError measureError(const CurenModel::Vertex* vertices, const std::vector<CurenModel::CompactVertex>& compactVertices,
+			const glm::mat4& dequantization);
+
+		static uint32_t encodeOctahedral(const glm::vec3& normal);
+		static glm::vec3 decodeOctahedral(uint32_t encoded);
+	};
+}
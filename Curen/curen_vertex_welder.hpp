@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CUREN_WELDER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Curen {
+
+	// Flat open addressing table that merges identical vertices and hands out dense ids in insertion order.
+	// T is hashed as an array of 32-bit float lanes with -0 folded onto +0, so it has to be trivially
+	// copyable, made of floats only and compared with operator== the same way.
+	template <typename T>
+	class CurenVertexWelder {
+		static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % 4 == 0, "CurenVertexWelder needs a plain vertex of 32-bit lanes");
+
+	public:
+		CurenVertexWelder(std::size_t expectedCount = 0) { reserve(expectedCount); }
+
+		CurenVertexWelder(const CurenVertexWelder&) = delete;
+		CurenVertexWelder& operator = (const CurenVertexWelder&) = delete;
+
+		// Sizes the table for expectedCount unique vertices without rehashing
+		void reserve(std::size_t expectedCount) {
+			std::size_t capacity = 16;
+			while (capacity * 3 < expectedCount * 4) {
+				capacity *= 2;
+			}
+			if (capacity > m_slots.size()) {
+				rehash(capacity);
+			}
+		}
+
+		// Returns the id of vertex, adding it if no equal vertex was welded before
+		uint32_t weld(const T& vertex) { return weld(vertex, hash(vertex)); }
+
+		uint32_t weld(const T& vertex, uint64_t vertexHash) {
+			if ((m_vertices.size() + 1) * 4 > m_slots.size() * 3) {
+				rehash(m_slots.size() * 2);
+			}
+
+			uint32_t tag = static_cast<uint32_t>(vertexHash >> 32);
+			std::size_t mask = m_slots.size() - 1;
+			for (std::size_t i = static_cast<std::size_t>(vertexHash) & mask;; i = (i + 1) & mask) {
+				Slot& slot = m_slots[i];
+				if (slot.id == EMPTY) {
+					slot.tag = tag;
+					slot.id = static_cast<uint32_t>(m_vertices.size());
+					m_vertices.push_back(vertex);
+					return slot.id;
+				}
+				if (slot.tag == tag && isEqual(m_vertices[slot.id], vertex)) {
+					return slot.id;
+				}
+			}
+		}
+
+		const std::vector<T>& vertices() const { return m_vertices; }
+		std::size_t size() const { return m_vertices.size(); }
+
+		static uint64_t hash(const T& vertex) {
+			const auto* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+#ifdef CUREN_WELDER_SSE2
+			const __m128i signMask = _mm_set1_epi32(0x7fffffff);
+			const __m128i multiplier = _mm_set1_epi32(static_cast<int>(0x9e3779b1u));
+			__m128i state = _mm_set_epi32(0x85ebca6b, static_cast<int>(0xc2b2ae35u), 0x27d4eb2f, 0x165667b1);
+
+			auto mixBlock = [&](__m128i block) {
+				__m128i isZero = _mm_cmpeq_epi32(_mm_and_si128(block, signMask), _mm_setzero_si128());
+				block = _mm_andnot_si128(isZero, block);
+				state = _mm_xor_si128(state, block);
+				__m128i even = _mm_mul_epu32(state, multiplier);
+				__m128i odd = _mm_mul_epu32(_mm_srli_epi64(state, 32), multiplier);
+				state = _mm_xor_si128(_mm_xor_si128(even, _mm_slli_epi64(odd, 32)), _mm_srli_epi64(state, 29));
+				state = _mm_shuffle_epi32(state, _MM_SHUFFLE(1, 0, 3, 2));
+			};
+
+			std::size_t offset = 0;
+			for (; offset + 16 <= sizeof(T); offset += 16) {
+				mixBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + offset)));
+			}
+			if (offset < sizeof(T)) {
+				alignas(16) unsigned char tail[16]{};
+				std::memcpy(tail, bytes + offset, sizeof(T) - offset);
+				mixBlock(_mm_load_si128(reinterpret_cast<const __m128i*>(tail)));
+			}
+
+			alignas(16) uint64_t lanes[2];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), state);
+			uint64_t result = lanes[0] ^ (lanes[1] * 0x9e3779b97f4a7c15ull);
+#else
+			uint64_t result = 0x27d4eb2f165667c5ull;
+			for (std::size_t offset = 0; offset < sizeof(T); offset += 4) {
+				uint32_t lane;
+				std::memcpy(&lane, bytes + offset, sizeof(lane));
+				if ((lane & 0x7fffffff) == 0) {
+					lane = 0;
+				}
+				result = (result ^ lane) * 0x100000001b3ull;
+				result ^= result >> 29;
+			}
+#endif
+			result ^= result >> 33;
+			result *= 0xff51afd7ed558ccdull;
+			result ^= result >> 33;
+			return result;
+		}
+
+	private:
+		struct Slot {
+			uint32_t tag;
+			uint32_t id;
+		};
+
+		static constexpr uint32_t EMPTY = ~0u;
+
+		// operator== alone, like the std::unordered_map this replaces: -0 welds with +0 and a NaN never welds, not
+		// even with a NaN of the same bits
+		static bool isEqual(const T& a, const T& b) {
+			return a == b;
+		}
+
+		void rehash(std::size_t capacity) {
+			std::vector<Slot> slots(capacity, Slot{ 0, EMPTY });
+			std::size_t mask = capacity - 1;
+			for (const Slot& slot : m_slots) {
+				if (slot.id == EMPTY) {
+					continue;
+				}
+				uint64_t vertexHash = hash(m_vertices[slot.id]);
+				std::size_t i = static_cast<std::size_t>(vertexHash) & mask;
+				while (slots[i].id != EMPTY) {
+					i = (i + 1) & mask;
+				}
+				slots[i] = slot;
+			}
+			m_slots = std::move(slots);
+		}
+
+		std::vector<Slot> m_slots{};
+		std::vector<T> m_vertices{};
+	};
+}
@@ -11,13 +11,25 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 view;
   vec4 ambientLightColor; // w is intensity
   vec3 lightPosition;
+  uint featureMask;
   vec4 lightColor;
 } ubo;
 
-layout(push_constant) uniform Push {
-  mat4 modelMatrix;
-  mat4 normalMatrix;
-} push;
+// CurenRenderSystem::FragmentFeature bits. Variant pipelines specialize FEATURES so the unused paths are compiled
+// out, the default leaves the choice to ubo.featureMask at runtime
+const uint FEATURE_DIFFUSE = 1u << 0;
+const uint FEATURE_SPECULAR = 1u << 1;
+const uint FEATURE_FOG = 1u << 2;
+const uint FEATURE_RUNTIME = 1u << 31;
+layout (constant_id = 0) const uint FEATURES = FEATURE_RUNTIME;
+
+const float SHININESS = 32.0;
+const float FOG_DENSITY = 0.08;
+
+bool hasFeature(uint feature) {
+  uint features = (FEATURES & FEATURE_RUNTIME) != 0u ? ubo.featureMask : FEATURES;
+  return (features & feature) != 0u;
+}
 
 void main() {
   vec3 directionToLight = ubo.lightPosition - fragPosWorld;
@@ -25,6 +37,25 @@ void main() {
 
   vec3 lightColor = ubo.lightColor.xyz * ubo.lightColor.w * attenuation;
   vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
-  vec3 diffuseLight = lightColor * max(dot(normalize(fragNormalWorld), normalize(directionToLight)), 0);
-  outColor = vec4((diffuseLight + ambientLight) * fragColor, 1.0);
-}
\ No newline at end of file
+  vec3 normal = normalize(fragNormalWorld);
+  directionToLight = normalize(directionToLight);
+
+  vec3 light = ambientLight;
+  if (hasFeature(FEATURE_DIFFUSE)) {
+    light += lightColor * max(dot(normal, directionToLight), 0);
+  }
+  vec3 color = light * fragColor;
+
+  if (hasFeature(FEATURE_SPECULAR)) {
+    // Blinn-Phong, the camera position is the inverse translation of the rigid view matrix
+    vec3 cameraPosWorld = -transpose(mat3(ubo.view)) * ubo.view[3].xyz;
+    vec3 halfAngle = normalize(directionToLight + normalize(cameraPosWorld - fragPosWorld));
+    color += lightColor * pow(max(dot(normal, halfAngle), 0.0), SHININESS);
+  }
+  if (hasFeature(FEATURE_FOG)) {
+    float viewDistance = length((ubo.view * vec4(fragPosWorld, 1.0)).xyz);
+    float fog = exp2(-FOG_DENSITY * FOG_DENSITY * viewDistance * viewDistance);
+    color = mix(ubo.ambientLightColor.xyz, color, fog);
+  }
+  outColor = vec4(color, 1.0);
+}
@@ -14,18 +14,19 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 view;
   vec4 ambientLightColor; // w is intensity
   vec3 lightPosition;
+  uint featureMask;
   vec4 lightColor;
 } ubo;
 
 layout(push_constant) uniform Push {
   mat4 modelMatrix;
-  mat4 normalMatrix;
+  mat3 normalMatrix;
 } push;
 
 void main() {
   vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
   gl_Position = ubo.projection * ubo.view * positionWorld;
-  fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+  fragNormalWorld = normalize(push.normalMatrix * normal);
   fragPosWorld = positionWorld.xyz;
   fragColor = color;
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// first_shader.vert with the transforms read from the bindless table, push constants only carry indices
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+  vec4 ambientLightColor; // w is intensity
+  vec3 lightPosition;
+  uint featureMask;
+  vec4 lightColor;
+} ubo;
+
+struct ObjectData {
+  mat4 modelMatrix;
+  mat3 normalMatrix;
+};
+
+// The transforms of every object this frame, one buffer of the bindless table
+layout(set = 1, binding = 0) readonly buffer ObjectBuffer {
+  ObjectData objects[];
+} objectBuffers[];
+
+layout(push_constant) uniform Push {
+  uint objectBufferIndex;
+  uint objectIndex;
+} push;
+
+void main() {
+  ObjectData object = objectBuffers[push.objectBufferIndex].objects[push.objectIndex];
+  vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+  gl_Position = ubo.projection * ubo.view * positionWorld;
+  fragNormalWorld = normalize(object.normalMatrix * normal);
+  fragPosWorld = positionWorld.xyz;
+  fragColor = color;
+}
\ No newline at end of file
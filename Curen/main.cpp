@@ -1,12 +1,63 @@
 #include "curen_init.hpp"
+#include "curen_bench.hpp"
+#include "curen_shader_library.hpp"
 
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <cstring>
 
+int main(int argc, char** argv) {
+    // Benchmarks and tests have their own entry point, the CPU ones never create a window or device
+    if (Curen::CurenBench::isRequested(argc, argv)) {
+        return Curen::CurenBench::run(argc, argv);
+    }
 
-int main() {
-    Curen::CurenInit curenInitializer;
+    bool isLodBenchmark = false;
+    bool isLodEnabled = true;
+    bool isMemoryReportEnabled = false;
+    bool isBindlessEnabled = true;
+    bool isVariantBenchmark = false;
+    bool isConeCullingEnabled = false;
+    bool isVerbose = false;
+    uint32_t fragmentFeatures = Curen::CurenRenderSystem::FEATURE_DIFFUSE;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--lod-benchmark") == 0) {
+            isLodBenchmark = true;
+        }
+        else if (std::strcmp(argv[i], "--no-lod") == 0) {
+            isLodEnabled = false;
+        }
+        else if (std::strcmp(argv[i], "--memory-report") == 0) {
+            isMemoryReportEnabled = true;
+        }
+        else if (std::strcmp(argv[i], "--verbose") == 0) {
+            isVerbose = true;
+        }
+        else if (std::strcmp(argv[i], "--no-bindless") == 0) {
+            isBindlessEnabled = false;
+        }
+        else if (std::strcmp(argv[i], "--variant-benchmark") == 0) {
+            isVariantBenchmark = true;
+        }
+        // Only for closed meshes, the demo vases lose the inside visible through their rim
+        else if (std::strcmp(argv[i], "--cone-culling") == 0) {
+            isConeCullingEnabled = true;
+        }
+        else if (std::strcmp(argv[i], "--specular") == 0) {
+            fragmentFeatures |= Curen::CurenRenderSystem::FEATURE_SPECULAR;
+        }
+        else if (std::strcmp(argv[i], "--fog") == 0) {
+            fragmentFeatures |= Curen::CurenRenderSystem::FEATURE_FOG;
+        }
+        // Loads the .spv files from a directory instead of the embedded ones, for shader changes without a rebuild
+        else if (std::strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            Curen::CurenShaderLibrary::setOverrideDirectory(argv[++i]);
+        }
+    }
+
+    Curen::CurenInit curenInitializer{ isLodBenchmark, isLodEnabled, isMemoryReportEnabled, isBindlessEnabled, isVariantBenchmark, fragmentFeatures,
+        isConeCullingEnabled, isVerbose };
 
 	try
 	{
@@ -8,6 +8,7 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 view;
   vec4 ambientLightColor; // w is intensity
   vec3 lightPosition;
+  uint featureMask;
   vec4 lightColor;
 } ubo;
 